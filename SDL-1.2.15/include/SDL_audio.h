@@ -257,6 +257,14 @@ extern DECLSPEC int SDLCALL SDL_ConvertAudio(SDL_AudioCVT *cvt);
  */
 extern DECLSPEC void SDLCALL SDL_MixAudio(Uint8 *dst, const Uint8 *src, Uint32 len, int volume);
 
+/**
+ * This mixes num audio buffers of the playing audio format into dst, each
+ * one len bytes long, with its own volume from 0 - 128.  The sum is clipped
+ * once at the end, so mixing several sounds this way is both faster and
+ * cleaner than calling SDL_MixAudio() for each of them.
+ */
+extern DECLSPEC void SDLCALL SDL_MixAudioMulti(Uint8 *dst, const Uint8 **src, const int *volume, int num, Uint32 len);
+
 /**
  * @name Audio Locks
  * The lock manipulated by these functions protects the callback function.
@@ -274,6 +282,64 @@ extern DECLSPEC void SDLCALL SDL_UnlockAudio(void);
  */
 extern DECLSPEC void SDLCALL SDL_CloseAudio(void);
 
+#ifdef __N3DS__
+/** @name 3DS hardware voices
+ *  The DSP mixes, resamples and pans up to 23 voices besides the audio
+ *  stream (which uses its channel 0), at no CPU cost. The voices work
+ *  with or without SDL_OpenAudio. Their sample data must be in linear
+ *  memory (SDL_N3DSAllocVoiceData) and stay there while it is queued.
+ */
+/*@{*/
+typedef enum {
+	SDL_N3DS_VOICE_PCM8,		/**< signed 8 bit */
+	SDL_N3DS_VOICE_PCM16,		/**< signed 16 bit, native byte order */
+	SDL_N3DS_VOICE_ADPCM		/**< DSP-ADPCM, mono only */
+} SDL_N3DSVoiceFormat;
+
+/** DSP-ADPCM decoder state at the start of a buffer */
+typedef struct SDL_N3DSADPCMState {
+	Uint16 index;			/**< predictor and scale */
+	Sint16 history0, history1;	/**< the last two samples */
+} SDL_N3DSADPCMState;
+
+/** Number of buffers that can be queued on a voice at a time */
+#define SDL_N3DS_VOICE_QUEUE	8
+
+/** Memory the DSP can read, for the sample data of the voices */
+extern DECLSPEC void * SDLCALL SDL_N3DSAllocVoiceData(Uint32 size);
+extern DECLSPEC void SDLCALL SDL_N3DSFreeVoiceData(void *data);
+
+/**
+ * Get a free voice, set to play 'channels' (1 or 2) channels of 'format'
+ * samples at 'freq' Hz, at full volume, centered.
+ * @return the voice (1 to 23), or -1 if none is free
+ */
+extern DECLSPEC int SDLCALL SDL_N3DSAllocVoice(int channels, SDL_N3DSVoiceFormat format, int freq);
+/** Stop a voice and give it back */
+extern DECLSPEC void SDLCALL SDL_N3DSFreeVoice(int voice);
+
+/**
+ * Queue 'samples' sample frames on a voice, played after the buffers
+ * already queued. For ADPCM voices, 'adpcm' is the decoder state at the
+ * start of the data, NULL to go on from the previous buffer.
+ * @return 0, or -1 if the queue of the voice is full
+ */
+extern DECLSPEC int SDLCALL SDL_N3DSQueueVoice(int voice, const void *data, Uint32 samples, int looping, const SDL_N3DSADPCMState *adpcm);
+/** Number of queued buffers not played yet, 0 when the voice is idle */
+extern DECLSPEC int SDLCALL SDL_N3DSVoiceQueued(int voice);
+/** Drop the queued buffers */
+extern DECLSPEC void SDLCALL SDL_N3DSStopVoice(int voice);
+extern DECLSPEC void SDLCALL SDL_N3DSPauseVoice(int voice, int pause_on);
+
+/** Playback rate in Hz, for pitch changes */
+extern DECLSPEC void SDLCALL SDL_N3DSSetVoiceRate(int voice, float freq);
+/** Volume from 0 to 1 (and above, to amplify), pan from -1 (left) to 1 (right) */
+extern DECLSPEC void SDLCALL SDL_N3DSSetVoiceVolume(int voice, float volume, float pan);
+/** The 16 coefficients of the DSP-ADPCM data of an ADPCM voice */
+extern DECLSPEC void SDLCALL SDL_N3DSSetVoiceADPCMCoefs(int voice, const Uint16 coefs[16]);
+/*@}*/
+#endif
+
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
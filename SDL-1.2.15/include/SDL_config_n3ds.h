@@ -118,4 +118,7 @@
 #define SDL_VIDEO_DRIVER_N3DS	1
 //#define SDL_VIDEO_DRIVER_DUMMY	1
 
+/* Time the n3ds present path, for SDL_N3DSGetFrameStats() */
+//#define SDL_VIDEO_N3DS_FRAMESTATS	1
+
 #endif /* _SDL_config_nds_h */
@@ -289,12 +289,37 @@ extern DECLSPEC int SDLCALL SDL_PollEvent(SDL_Event *event);
  */
 extern DECLSPEC int SDLCALL SDL_WaitEvent(SDL_Event *event);
 
+/** Waits until the next available event, or for at most 'timeout' ms
+ *  (forever if it is negative).  Returns 1 if there is an event, or 0 if
+ *  it timed out or there was an error.  If 'event' is not NULL, the next
+ *  event is removed from the queue and stored in that area.
+ *  While waiting, the events are pumped every SDL_EVENT_PUMP_INTERVAL ms
+ *  (8 by default), and an event pushed by another thread wakes it up
+ *  right away.
+ */
+extern DECLSPEC int SDLCALL SDL_WaitEventTimeout(SDL_Event *event, int timeout);
+
 /** Add an event to the event queue.
  *  This function returns 0 on success, or -1 if the event queue was full
  *  or there was some other error.
  */
 extern DECLSPEC int SDLCALL SDL_PushEvent(SDL_Event *event);
 
+/** Returns the number of events dropped so far because the event queue
+ *  was full.  SDL_EVENT_QUEUE_SIZE sets how many events the queue holds,
+ *  and SDL_EVENT_QUEUE_MAX lets it grow up to that many.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_GetDroppedEvents(void);
+
+/** Returns the time, in SDL_GetTicks() milliseconds, of the last event
+ *  returned by SDL_PollEvent(), SDL_WaitEvent() or SDL_PeepEvents() (the
+ *  last one stored, when it returns several): when the input was sampled
+ *  for input events, when it was queued for the others.  On 3DS, with
+ *  SDL_N3DS_INPUT_RATE set, the input is sampled by a thread between the
+ *  calls to SDL_PumpEvents(), so this tells when a key was really pressed.
+ */
+extern DECLSPEC Uint32 SDLCALL SDL_GetEventTimestamp(void);
+
 /** @name Event Filtering */
 /*@{*/
 typedef int (SDLCALL *SDL_EventFilter)(const SDL_Event *event);
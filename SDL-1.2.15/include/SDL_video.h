@@ -947,6 +947,40 @@ extern DECLSPEC SDL_GrabMode SDLCALL SDL_WM_GrabInput(SDL_GrabMode mode);
 
 /*@}*/
 
+#ifdef __N3DS__
+/** Stages of the 3DS present path, timed by SDL_N3DSGetFrameStats() */
+typedef enum {
+	SDL_N3DS_STAGE_FLUSH,		/**< data cache flushes */
+	SDL_N3DS_STAGE_TRANSFER,	/**< GX transfers into the screen textures */
+	SDL_N3DS_STAGE_PPF,		/**< waits for the end of the transfers */
+	SDL_N3DS_STAGE_VBLANK,		/**< waits for the VBlank */
+	SDL_N3DS_STAGE_FRAMEBEGIN,	/**< C3D_FrameBegin, waits for the previous GPU frame */
+	SDL_N3DS_STAGE_FRAMEEND,	/**< C3D_FrameEnd, submits the GPU frame */
+	SDL_N3DS_STAGE_PALETTE,		/**< 8 bit pixels prepared by the CPU */
+	SDL_N3DS_STAGE_ROTATE,		/**< copies into the framebuffer (direct present) */
+	SDL_N3DS_STAGE_FRAME,		/**< from one present to the next */
+	SDL_N3DS_STAGE_COUNT
+} SDL_N3DSStage;
+
+/** Per frame timings in microseconds, indexed by SDL_N3DSStage */
+typedef struct SDL_N3DSFrameStats {
+	int frames;			/**< number of frames the figures are over */
+	Uint32 min[SDL_N3DS_STAGE_COUNT];
+	Uint32 avg[SDL_N3DS_STAGE_COUNT];
+	Uint32 max[SDL_N3DS_STAGE_COUNT];
+	Uint32 missedvblanks;		/**< VBlanks passed without a present */
+} SDL_N3DSFrameStats;
+
+/**
+ * Get the timings of the present path over the last frames (about a
+ * second worth), counted from the last video mode change.
+ * Only available when SDL is built with SDL_VIDEO_N3DS_FRAMESTATS.
+ *
+ * @return 0 on success, -1 if the timings are not available
+ */
+extern DECLSPEC int SDLCALL SDL_N3DSGetFrameStats(SDL_N3DSFrameStats *stats);
+#endif
+
 /** @internal Not in public API at the moment - do not use! */
 extern DECLSPEC int SDLCALL SDL_SoftStretch(SDL_Surface *src, SDL_Rect *srcrect,
                                     SDL_Surface *dst, SDL_Rect *dstrect);
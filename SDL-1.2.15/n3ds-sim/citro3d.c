@@ -0,0 +1,627 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+/* citro3d, minus the rasterizer. Textures, render targets and their
+   clears, the frame and its transfer to the screens are real; draw calls
+   and the state they use (shaders, texenv, lighting...) are accepted and
+   dropped. What reaches the framebuffers is what went through the
+   transfers: the clear color, textures used as render targets, and
+   anything drawn directly to the framebuffers. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include <citro3d.h>
+
+/* Stands in for the shader picasso builds from vshader.v.pica */
+const u8 vshader_shbin[4] = { 0 };
+const u8 vshader_shbin_end[1] = { 0 };
+const u32 vshader_shbin_size = sizeof(vshader_shbin);
+
+static C3D_RenderTarget *linked_targets;
+static C3D_RenderTarget *drawn_targets[16];	// drawn on in this frame
+static int drawn_count;
+static C3D_AttrInfo attr_info;
+static C3D_BufInfo buf_info;
+static C3D_TexEnv tex_envs[6];
+static u32 frame_counter;
+static bool in_frame;
+
+bool C3D_Init(size_t cmdBufSize)
+{
+	return true;
+}
+
+void C3D_Fini(void)
+{
+}
+
+float C3D_GetCmdBufUsage(void)
+{
+	return 0.0f;
+}
+
+/* Shaders */
+
+DVLB_s *DVLB_ParseFile(u32 *shbinData, u32 shbinSize)
+{
+	DVLB_s *dvlb = (DVLB_s *)calloc(1, sizeof(*dvlb));
+	if ( dvlb ) {
+		dvlb->numDVLE = 1;
+		dvlb->DVLE = (DVLE_s *)calloc(1, sizeof(*dvlb->DVLE));
+	}
+	return dvlb;
+}
+
+void DVLB_Free(DVLB_s *dvlb)
+{
+	if ( dvlb ) {
+		free(dvlb->DVLE);
+		free(dvlb);
+	}
+}
+
+Result shaderProgramInit(shaderProgram_s *sp)
+{
+	memset(sp, 0, sizeof(*sp));
+	return 0;
+}
+
+Result shaderProgramFree(shaderProgram_s *sp)
+{
+	free(sp->vertexShader);
+	sp->vertexShader = NULL;
+	return 0;
+}
+
+Result shaderProgramSetVsh(shaderProgram_s *sp, DVLE_s *dvle)
+{
+	free(sp->vertexShader);
+	sp->vertexShader = (shaderInstance_s *)calloc(1, sizeof(*sp->vertexShader));
+	if ( ! sp->vertexShader )
+		return -1;
+	sp->vertexShader->dvle = dvle;
+	return 0;
+}
+
+s8 shaderInstanceGetUniformLocation(shaderInstance_s *si, const char *name)
+{
+	return 0;
+}
+
+void C3D_BindProgram(shaderProgram_s *program)
+{
+}
+
+void C3D_FVUnifMtx4x4(GPU_SHADER_TYPE type, int id, const C3D_Mtx *mtx)
+{
+}
+
+void C3D_FVUnifSet(GPU_SHADER_TYPE type, int id, float x, float y, float z, float w)
+{
+}
+
+/* Vertex input */
+
+C3D_AttrInfo *C3D_GetAttrInfo(void)
+{
+	return &attr_info;
+}
+
+void AttrInfo_Init(C3D_AttrInfo *info)
+{
+	memset(info, 0, sizeof(*info));
+}
+
+int AttrInfo_AddLoader(C3D_AttrInfo *info, int regId, GPU_FORMATS format, int count)
+{
+	return info->attrCount++;
+}
+
+C3D_BufInfo *C3D_GetBufInfo(void)
+{
+	return &buf_info;
+}
+
+void BufInfo_Init(C3D_BufInfo *info)
+{
+	memset(info, 0, sizeof(*info));
+}
+
+int BufInfo_Add(C3D_BufInfo *info, const void *data, ptrdiff_t stride, int attribCount, u64 permutation)
+{
+	return info->bufCount++;
+}
+
+/* Matrices, as citro3d computes them */
+
+void Mtx_Identity(C3D_Mtx *out)
+{
+	memset(out, 0, sizeof(*out));
+	out->r[0].x = out->r[1].y = out->r[2].z = out->r[3].w = 1.0f;
+}
+
+void Mtx_Ortho(C3D_Mtx *mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded)
+{
+	memset(mtx, 0, sizeof(*mtx));
+	mtx->r[0].x = 2.0f / (right - left);
+	mtx->r[0].w = (left + right) / (left - right);
+	mtx->r[1].y = 2.0f / (top - bottom);
+	mtx->r[1].w = (bottom + top) / (bottom - top);
+	mtx->r[2].z = (isLeftHanded ? 1.0f : -1.0f) / (far - near);
+	mtx->r[2].w = 0.5f * (near + far) / (near - far) - 0.5f;
+	mtx->r[3].w = 1.0f;
+}
+
+/* The same, rotated for the screens, which are mounted sideways */
+void Mtx_OrthoTilt(C3D_Mtx *mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded)
+{
+	memset(mtx, 0, sizeof(*mtx));
+	mtx->r[0].y = 2.0f / (top - bottom);
+	mtx->r[0].w = (bottom + top) / (bottom - top);
+	mtx->r[1].x = 2.0f / (left - right);
+	mtx->r[1].w = (left + right) / (right - left);
+	mtx->r[2].z = (isLeftHanded ? 1.0f : -1.0f) / (far - near);
+	mtx->r[2].w = 0.5f * (near + far) / (near - far) - 0.5f;
+	mtx->r[3].w = 1.0f;
+}
+
+/* Textures */
+
+static size_t texBits(GPU_TEXCOLOR fmt)
+{
+	switch ( fmt ) {
+		case GPU_RGBA8:
+			return 32;
+		case GPU_RGB8:
+			return 24;
+		case GPU_RGBA5551:
+		case GPU_RGB565:
+		case GPU_RGBA4:
+		case GPU_LA8:
+		case GPU_HILO8:
+			return 16;
+		case GPU_L4:
+		case GPU_A4:
+		case GPU_ETC1:
+			return 4;
+		default:
+			return 8;
+	}
+}
+
+static bool texInit(C3D_Tex *tex, u16 width, u16 height, GPU_TEXCOLOR format, bool vram)
+{
+	size_t size = (size_t)width * height * texBits(format) / 8;
+
+	memset(tex, 0, sizeof(*tex));
+	tex->data = vram ? vramAlloc(size) : linearAlloc(size);
+	if ( ! tex->data )
+		return false;
+	tex->fmt = format;
+	tex->size = size;
+	tex->width = width;
+	tex->height = height;
+	tex->border = vram ? 1 : 0; // remember where it came from
+	return true;
+}
+
+bool C3D_TexInit(C3D_Tex *tex, u16 width, u16 height, GPU_TEXCOLOR format)
+{
+	return texInit(tex, width, height, format, false);
+}
+
+bool C3D_TexInitVRAM(C3D_Tex *tex, u16 width, u16 height, GPU_TEXCOLOR format)
+{
+	return texInit(tex, width, height, format, true);
+}
+
+void C3D_TexUpload(C3D_Tex *tex, const void *data)
+{
+	memcpy(tex->data, data, tex->size);
+}
+
+void C3D_TexFlush(C3D_Tex *tex)
+{
+}
+
+void C3D_TexDelete(C3D_Tex *tex)
+{
+	if ( ! tex->data )
+		return;
+	if ( tex->border )
+		vramFree(tex->data);
+	else
+		linearFree(tex->data);
+	tex->data = NULL;
+}
+
+void C3D_TexBind(int unitId, C3D_Tex *tex)
+{
+}
+
+void C3D_TexSetFilter(C3D_Tex *tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter)
+{
+}
+
+void C3D_TexSetWrap(C3D_Tex *tex, GPU_TEXTURE_WRAP_PARAM wrapS, GPU_TEXTURE_WRAP_PARAM wrapT)
+{
+}
+
+/* Fragment state */
+
+C3D_TexEnv *C3D_GetTexEnv(int id)
+{
+	return &tex_envs[id];
+}
+
+void C3D_TexEnvInit(C3D_TexEnv *env)
+{
+	memset(env, 0, sizeof(*env));
+}
+
+void C3D_TexEnvSrc(C3D_TexEnv *env, C3D_TexEnvMode mode, int s1, int s2, int s3)
+{
+	u16 src = s1 | (s2 << 4) | (s3 << 8);
+	if ( mode & C3D_RGB ) env->srcRgb = src;
+	if ( mode & C3D_Alpha ) env->srcAlpha = src;
+}
+
+void C3D_TexEnvOp(C3D_TexEnv *env, C3D_TexEnvMode mode, int o1, int o2, int o3)
+{
+	if ( mode & C3D_RGB ) env->opRgb = o1 | (o2 << 4) | (o3 << 8);
+	if ( mode & C3D_Alpha ) env->opAlpha = o1 | (o2 << 4) | (o3 << 8);
+}
+
+void C3D_TexEnvFunc(C3D_TexEnv *env, C3D_TexEnvMode mode, int param)
+{
+	if ( mode & C3D_RGB ) env->funcRgb = param;
+	if ( mode & C3D_Alpha ) env->funcAlpha = param;
+}
+
+void C3D_TexEnvColor(C3D_TexEnv *env, u32 color)
+{
+	env->color = color;
+}
+
+void C3D_DepthTest(bool enable, GPU_TESTFUNC function, GPU_WRITEMASK writemask)
+{
+}
+
+void C3D_AlphaTest(bool enable, GPU_TESTFUNC function, int ref)
+{
+}
+
+void C3D_AlphaBlend(GPU_BLENDEQUATION colorEq, GPU_BLENDEQUATION alphaEq, GPU_BLENDFACTOR srcClr, GPU_BLENDFACTOR dstClr, GPU_BLENDFACTOR srcAlpha, GPU_BLENDFACTOR dstAlpha)
+{
+}
+
+void C3D_ColorLogicOp(int op)
+{
+}
+
+void C3D_CullFace(GPU_CULLMODE mode)
+{
+}
+
+void C3D_SetScissor(int mode, u32 left, u32 top, u32 right, u32 bottom)
+{
+}
+
+/* Drawing: there is no rasterizer */
+
+void C3D_ImmDrawBegin(GPU_Primitive_t primitive)
+{
+}
+
+void C3D_ImmSendAttrib(float x, float y, float z, float w)
+{
+}
+
+void C3D_ImmDrawEnd(void)
+{
+}
+
+void C3D_DrawArrays(GPU_Primitive_t primitive, int first, int size)
+{
+}
+
+/* Lighting */
+
+void C3D_LightEnvInit(C3D_LightEnv *env)
+{
+	memset(env, 0, sizeof(*env));
+}
+
+void C3D_LightEnvBind(C3D_LightEnv *env)
+{
+}
+
+void C3D_LightEnvMaterial(C3D_LightEnv *env, const C3D_Material *mtl)
+{
+	env->material = *mtl;
+}
+
+void C3D_LightEnvAmbient(C3D_LightEnv *env, float r, float g, float b)
+{
+	env->ambient[0] = r;
+	env->ambient[1] = g;
+	env->ambient[2] = b;
+}
+
+void C3D_LightEnvLut(C3D_LightEnv *env, GPU_LIGHTLUTID lutId, GPU_LIGHTLUTINPUT input, bool negative, C3D_LightLut *lut)
+{
+	if ( lutId < 6 )
+		env->luts[lutId] = lut;
+}
+
+void C3D_LightEnvBumpMode(C3D_LightEnv *env, GPU_BUMPMODE mode)
+{
+}
+
+void C3D_LightEnvBumpSel(C3D_LightEnv *env, int texUnit)
+{
+}
+
+void C3D_LightEnvBumpNormalZ(C3D_LightEnv *env, bool usez)
+{
+}
+
+void C3D_LightEnvClampHighlights(C3D_LightEnv *env, bool clamp)
+{
+}
+
+int C3D_LightInit(C3D_Light *light, C3D_LightEnv *env)
+{
+	int i;
+	for ( i = 0; i < 8; i++ ) {
+		if ( ! env->lights[i] ) {
+			memset(light, 0, sizeof(*light));
+			light->id = i;
+			light->parent = env;
+			env->lights[i] = light;
+			return i;
+		}
+	}
+	return -1;
+}
+
+void C3D_LightEnable(C3D_Light *light, bool enable)
+{
+}
+
+void C3D_LightTwoSideDiffuse(C3D_Light *light, bool enable)
+{
+}
+
+void C3D_LightAmbient(C3D_Light *light, float r, float g, float b)
+{
+}
+
+void C3D_LightDiffuse(C3D_Light *light, float r, float g, float b)
+{
+}
+
+void C3D_LightSpecular0(C3D_Light *light, float r, float g, float b)
+{
+}
+
+void C3D_LightSpecular1(C3D_Light *light, float r, float g, float b)
+{
+}
+
+void C3D_LightPosition(C3D_Light *light, C3D_FVec *pos)
+{
+}
+
+void LightLut_FromArray(C3D_LightLut *lut, float *data)
+{
+	memset(lut, 0, sizeof(*lut));
+}
+
+/* Render targets. Their color buffers are tiled like the GPU's. */
+
+static const int colorbuf_transfer_fmt[] = {
+	GX_TRANSFER_FMT_RGBA8, GX_TRANSFER_FMT_RGB8, GX_TRANSFER_FMT_RGB5A1,
+	GX_TRANSFER_FMT_RGB565, GX_TRANSFER_FMT_RGBA4
+};
+
+static void fillTarget(C3D_RenderTarget *target, u32 color)
+{
+	int bpp = simFormatBytes(colorbuf_transfer_fmt[target->colorFmt]);
+	u8 *p = (u8 *)target->colorBuf;
+	int i, n = target->width * target->height;
+
+	for ( i = 0; i < n; i++, p += bpp ) {
+		// the value is in the buffer's format, as with GX_MemoryFill
+		p[0] = color & 0xFF;
+		p[1] = (color >> 8) & 0xFF;
+		if ( bpp > 2 ) p[2] = (color >> 16) & 0xFF;
+		if ( bpp > 3 ) p[3] = color >> 24;
+	}
+}
+
+C3D_RenderTarget *C3D_RenderTargetCreate(int width, int height, GPU_COLORBUF colorFmt, int depthFmt)
+{
+	C3D_RenderTarget *target = (C3D_RenderTarget *)calloc(1, sizeof(*target));
+	if ( ! target )
+		return NULL;
+	target->colorBuf = vramAlloc(width * height * simFormatBytes(colorbuf_transfer_fmt[colorFmt]));
+	if ( ! target->colorBuf ) {
+		free(target);
+		return NULL;
+	}
+	target->ownsColor = true;
+	target->width = width;
+	target->height = height;
+	target->colorFmt = colorFmt;
+	return target;
+}
+
+C3D_RenderTarget *C3D_RenderTargetCreateFromTex(C3D_Tex *tex, GPU_TEXFACE face, int level, int depthFmt)
+{
+	C3D_RenderTarget *target = (C3D_RenderTarget *)calloc(1, sizeof(*target));
+	if ( ! target )
+		return NULL;
+	target->colorBuf = tex->data;
+	target->width = tex->width;
+	target->height = tex->height;
+	target->colorFmt = (GPU_COLORBUF)tex->fmt; // the formats a texture can be drawn to have the same numbers
+	return target;
+}
+
+static void unlinkTarget(C3D_RenderTarget *target)
+{
+	if ( ! target->linked )
+		return;
+	if ( target->prev )
+		target->prev->next = target->next;
+	else
+		linked_targets = target->next;
+	if ( target->next )
+		target->next->prev = target->prev;
+	target->next = target->prev = NULL;
+	target->linked = false;
+}
+
+void C3D_RenderTargetDelete(C3D_RenderTarget *target)
+{
+	int i;
+	for ( i = 0; i < drawn_count; i++ ) {
+		if ( drawn_targets[i] == target )
+			drawn_targets[i] = drawn_targets[--drawn_count];
+	}
+	unlinkTarget(target);
+	if ( target->ownsColor )
+		vramFree(target->colorBuf);
+	free(target);
+}
+
+void C3D_RenderTargetSetOutput(C3D_RenderTarget *target, gfxScreen_t screen, gfx3dSide_t side, u32 transferFlags)
+{
+	C3D_RenderTarget *t;
+
+	// one target per screen, as in citro3d
+	for ( t = linked_targets; t; t = t->next ) {
+		if ( t != target && t->screen == screen && t->side == side ) {
+			unlinkTarget(t);
+			break;
+		}
+	}
+	if ( ! target )
+		return;
+	unlinkTarget(target);
+	target->screen = screen;
+	target->side = side;
+	target->transferFlags = transferFlags;
+	target->next = linked_targets;
+	if ( linked_targets )
+		linked_targets->prev = target;
+	linked_targets = target;
+	target->linked = true;
+}
+
+void C3D_RenderTargetSetClear(C3D_RenderTarget *target, C3D_ClearBits clearBits, u32 clearColor, u32 clearDepth)
+{
+	target->clearBits = clearBits;
+	target->clearColor = clearColor;
+}
+
+void C3D_RenderTargetClear(C3D_RenderTarget *target, C3D_ClearBits clearBits, u32 clearColor, u32 clearDepth)
+{
+	if ( clearBits & C3D_CLEAR_COLOR )
+		fillTarget(target, clearColor);
+}
+
+/* Frames. The GPU is done as soon as the frame is submitted, so nothing
+   ever waits here; the drivers do their own VBlank waits. */
+
+float C3D_FrameRate(float fps)
+{
+	return fps;
+}
+
+void C3D_FrameSync(void)
+{
+	gspWaitForVBlank();
+}
+
+u32 C3D_FrameCounter(int id)
+{
+	return frame_counter;
+}
+
+bool C3D_FrameBegin(u8 flags)
+{
+	in_frame = true;
+	return true;
+}
+
+bool C3D_FrameDrawOn(C3D_RenderTarget *target)
+{
+	if ( ! in_frame || ! target )
+		return false;
+	if ( ! target->used && drawn_count < 16 ) {
+		target->used = true;
+		drawn_targets[drawn_count++] = target;
+		if ( target->clearBits & C3D_CLEAR_COLOR )
+			fillTarget(target, target->clearColor);
+	}
+	return true;
+}
+
+void C3D_FrameSplit(u8 flags)
+{
+}
+
+void C3D_FrameEnd(u8 flags)
+{
+	int i;
+
+	for ( i = 0; i < drawn_count; i++ ) {
+		C3D_RenderTarget *t = drawn_targets[i];
+		u16 fbw, fbh;
+		u8 *fb;
+
+		t->used = false;
+		if ( ! t->linked )
+			continue;
+		fb = simFramebuffer(t->screen, t->side, &fbw, &fbh);
+		GX_DisplayTransfer((u32 *)t->colorBuf, GX_BUFFER_DIM(t->width, t->height),
+		                   (u32 *)fb, GX_BUFFER_DIM(fbw, fbh), t->transferFlags);
+		gfxScreenSwapBuffers(t->screen, false);
+	}
+	drawn_count = 0;
+	in_frame = false;
+	frame_counter++;
+}
+
+void C3D_SafeDisplayTransfer(u32 *inadr, u32 indim, u32 *outadr, u32 outdim, u32 flags)
+{
+	GX_DisplayTransfer(inadr, indim, outadr, outdim, flags);
+}
+
+void C3D_SafeTextureCopy(u32 *inadr, u32 indim, u32 *outadr, u32 outdim, u32 size, u32 flags)
+{
+	GX_TextureCopy(inadr, indim, outadr, outdim, size, flags);
+}
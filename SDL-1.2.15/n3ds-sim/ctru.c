@@ -0,0 +1,1010 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+/* The libctru part of the stand-in: kernel objects and threads on top of
+   pthreads, the linear and VRAM heaps, the screens and their VBlank, APT
+   and HID (the input comes from a script, see README). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+
+#include "sim.h"
+
+#define TIMEOUT_RESULT	0x09401BFE	// what the kernel returns for a timed out wait
+#define CUR_THREAD_HANDLE	0xFFFF8000
+
+pthread_mutex_t sim_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t sim_cond = PTHREAD_COND_INITIALIZER;
+
+/* Clock */
+
+static pthread_once_t clock_once = PTHREAD_ONCE_INIT;
+static struct timespec clock_start;
+static double clock_speed = 1.0;
+
+static void clockInit(void)
+{
+	const char *env = getenv("N3DS_SIM_SPEED");
+	clock_gettime(CLOCK_MONOTONIC, &clock_start);
+	if ( env && atof(env) > 0.0 )
+		clock_speed = atof(env);
+}
+
+u64 simTimeNs(void)
+{
+	struct timespec now;
+	double real;
+
+	pthread_once(&clock_once, clockInit);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	real = (double)(now.tv_sec - clock_start.tv_sec) * 1e9 + (double)(now.tv_nsec - clock_start.tv_nsec);
+	return (u64)(real * clock_speed);
+}
+
+struct timespec simDeadline(u64 ns)
+{
+	struct timespec ts;
+	double real;
+
+	pthread_once(&clock_once, clockInit);
+	real = (double)ns / clock_speed;
+	ts.tv_sec = clock_start.tv_sec + (time_t)(real / 1e9);
+	ts.tv_nsec = clock_start.tv_nsec + (long)(real - (double)(time_t)(real / 1e9) * 1e9);
+	if ( ts.tv_nsec >= 1000000000 ) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	return ts;
+}
+
+void simSleepUntil(u64 ns)
+{
+	struct timespec ts = simDeadline(ns);
+	while ( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR )
+		;
+}
+
+u64 svcGetSystemTick(void)
+{
+	return (u64)((double)simTimeNs() * (SYSCLOCK_ARM11 / 1e9));
+}
+
+void svcSleepThread(s64 ns)
+{
+	if ( ns > 0 )
+		simSleepUntil(simTimeNs() + ns);
+	else
+		sched_yield();
+}
+
+/* Kernel objects. Handles index a fixed table. */
+
+#define MAX_OBJECTS	256
+#define HANDLE_BASE	0x100
+
+enum { OBJ_FREE = 0, OBJ_EVENT, OBJ_SEMAPHORE, OBJ_THREAD };
+
+struct Object {
+	int type;
+	ResetType reset;	// events
+	int signaled;		// events; threads: finished
+	s32 count, max;		// semaphores
+};
+
+static struct Object objects[MAX_OBJECTS];
+
+static Result newObject(Handle *handle, int type)
+{
+	int i;
+	pthread_mutex_lock(&sim_lock);
+	for ( i = 0; i < MAX_OBJECTS; i++ ) {
+		if ( objects[i].type == OBJ_FREE ) {
+			memset(&objects[i], 0, sizeof(objects[i]));
+			objects[i].type = type;
+			*handle = HANDLE_BASE + i;
+			pthread_mutex_unlock(&sim_lock);
+			return 0;
+		}
+	}
+	pthread_mutex_unlock(&sim_lock);
+	*handle = 0;
+	return -1;
+}
+
+/* With sim_lock held */
+static struct Object *getObject(Handle handle)
+{
+	if ( handle < HANDLE_BASE || handle >= HANDLE_BASE + MAX_OBJECTS )
+		return NULL;
+	if ( objects[handle - HANDLE_BASE].type == OBJ_FREE )
+		return NULL;
+	return &objects[handle - HANDLE_BASE];
+}
+
+Result svcCreateEvent(Handle *event, ResetType reset_type)
+{
+	Result res = newObject(event, OBJ_EVENT);
+	if ( res == 0 )
+		objects[*event - HANDLE_BASE].reset = reset_type;
+	return res;
+}
+
+Result svcSignalEvent(Handle handle)
+{
+	struct Object *obj;
+	pthread_mutex_lock(&sim_lock);
+	obj = getObject(handle);
+	if ( obj && obj->type == OBJ_EVENT ) {
+		obj->signaled = 1;
+		pthread_cond_broadcast(&sim_cond);
+	}
+	pthread_mutex_unlock(&sim_lock);
+	return obj ? 0 : -1;
+}
+
+Result svcClearEvent(Handle handle)
+{
+	struct Object *obj;
+	pthread_mutex_lock(&sim_lock);
+	obj = getObject(handle);
+	if ( obj && obj->type == OBJ_EVENT )
+		obj->signaled = 0;
+	pthread_mutex_unlock(&sim_lock);
+	return obj ? 0 : -1;
+}
+
+Result svcCreateSemaphore(Handle *semaphore, s32 initial_count, s32 max_count)
+{
+	Result res = newObject(semaphore, OBJ_SEMAPHORE);
+	if ( res == 0 ) {
+		objects[*semaphore - HANDLE_BASE].count = initial_count;
+		objects[*semaphore - HANDLE_BASE].max = max_count;
+	}
+	return res;
+}
+
+Result svcReleaseSemaphore(s32 *count, Handle semaphore, s32 release_count)
+{
+	struct Object *obj;
+	Result res = -1;
+	pthread_mutex_lock(&sim_lock);
+	obj = getObject(semaphore);
+	if ( obj && obj->type == OBJ_SEMAPHORE && obj->count + release_count <= obj->max ) {
+		*count = obj->count;
+		obj->count += release_count;
+		pthread_cond_broadcast(&sim_cond);
+		res = 0;
+	}
+	pthread_mutex_unlock(&sim_lock);
+	return res;
+}
+
+Result svcCloseHandle(Handle handle)
+{
+	struct Object *obj;
+	pthread_mutex_lock(&sim_lock);
+	obj = getObject(handle);
+	// a thread object lives as long as its Thread
+	if ( obj && obj->type != OBJ_THREAD )
+		obj->type = OBJ_FREE;
+	pthread_mutex_unlock(&sim_lock);
+	return obj ? 0 : -1;
+}
+
+/* With sim_lock held: take the object if it is signaled */
+static int acquire(struct Object *obj)
+{
+	switch ( obj->type ) {
+		case OBJ_EVENT:
+			if ( ! obj->signaled )
+				return 0;
+			if ( obj->reset == RESET_ONESHOT )
+				obj->signaled = 0;
+			return 1;
+		case OBJ_SEMAPHORE:
+			if ( obj->count <= 0 )
+				return 0;
+			obj->count--;
+			return 1;
+		case OBJ_THREAD:
+			return obj->signaled;
+	}
+	return 0;
+}
+
+static Result waitObjects(s32 *out, const Handle *handles, s32 count, bool wait_all, s64 nanoseconds)
+{
+	struct timespec deadline;
+	Result res = 0;
+	int i;
+
+	if ( nanoseconds > 0 && (u64)nanoseconds != U64_MAX )
+		deadline = simDeadline(simTimeNs() + nanoseconds);
+	pthread_mutex_lock(&sim_lock);
+	for ( ;; ) {
+		int ready = 0;
+		for ( i = 0; i < count; i++ ) {
+			struct Object *obj = getObject(handles[i]);
+			if ( ! obj ) {
+				pthread_mutex_unlock(&sim_lock);
+				return -1;
+			}
+			if ( obj->type == OBJ_SEMAPHORE ? obj->count > 0 : (obj->type == OBJ_EVENT || obj->type == OBJ_THREAD) && obj->signaled ) {
+				ready++;
+				if ( ! wait_all ) {
+					acquire(obj);
+					if ( out ) *out = i;
+					goto done;
+				}
+			}
+		}
+		if ( wait_all && ready == count ) {
+			for ( i = 0; i < count; i++ )
+				acquire(getObject(handles[i]));
+			goto done;
+		}
+		if ( nanoseconds == 0 ) {
+			res = TIMEOUT_RESULT;
+			goto done;
+		}
+		if ( (u64)nanoseconds == U64_MAX || nanoseconds < 0 ) {
+			pthread_cond_wait(&sim_cond, &sim_lock);
+		} else if ( pthread_cond_timedwait(&sim_cond, &sim_lock, &deadline) == ETIMEDOUT ) {
+			res = TIMEOUT_RESULT;
+			goto done;
+		}
+	}
+done:
+	pthread_mutex_unlock(&sim_lock);
+	return res;
+}
+
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds)
+{
+	return waitObjects(NULL, &handle, 1, false, nanoseconds);
+}
+
+Result svcWaitSynchronizationN(s32 *out, const Handle *handles, s32 handles_num, bool wait_all, s64 nanoseconds)
+{
+	return waitObjects(out, handles, handles_num, wait_all, nanoseconds);
+}
+
+/* Light synchronization primitives, same lock */
+
+void LightEvent_Init(LightEvent *event, ResetType reset_type)
+{
+	event->state = 0;
+	event->type = reset_type;
+	event->counter = 0;
+}
+
+void LightEvent_Clear(LightEvent *event)
+{
+	pthread_mutex_lock(&sim_lock);
+	event->state = 0;
+	pthread_mutex_unlock(&sim_lock);
+}
+
+void LightEvent_Signal(LightEvent *event)
+{
+	pthread_mutex_lock(&sim_lock);
+	event->state = 1;
+	pthread_cond_broadcast(&sim_cond);
+	pthread_mutex_unlock(&sim_lock);
+}
+
+static int lightEventTake(LightEvent *event)
+{
+	if ( ! event->state )
+		return 0;
+	if ( event->type == RESET_ONESHOT )
+		event->state = 0;
+	return 1;
+}
+
+int LightEvent_TryWait(LightEvent *event)
+{
+	int res;
+	pthread_mutex_lock(&sim_lock);
+	res = lightEventTake(event);
+	pthread_mutex_unlock(&sim_lock);
+	return res;
+}
+
+void LightEvent_Wait(LightEvent *event)
+{
+	pthread_mutex_lock(&sim_lock);
+	while ( ! lightEventTake(event) )
+		pthread_cond_wait(&sim_cond, &sim_lock);
+	pthread_mutex_unlock(&sim_lock);
+}
+
+/* Returns 1 on timeout, like libctru */
+int LightEvent_WaitTimeout(LightEvent *event, s64 timeout_ns)
+{
+	struct timespec deadline = simDeadline(simTimeNs() + timeout_ns);
+	int res = 0;
+	pthread_mutex_lock(&sim_lock);
+	while ( ! lightEventTake(event) ) {
+		if ( pthread_cond_timedwait(&sim_cond, &sim_lock, &deadline) == ETIMEDOUT ) {
+			res = lightEventTake(event) ? 0 : 1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sim_lock);
+	return res;
+}
+
+void LightLock_Init(LightLock *lock)
+{
+	*lock = 0;
+}
+
+void LightLock_Lock(LightLock *lock)
+{
+	pthread_mutex_lock(&sim_lock);
+	while ( *lock )
+		pthread_cond_wait(&sim_cond, &sim_lock);
+	*lock = 1;
+	pthread_mutex_unlock(&sim_lock);
+}
+
+int LightLock_TryLock(LightLock *lock)
+{
+	int res = 1;
+	pthread_mutex_lock(&sim_lock);
+	if ( ! *lock ) {
+		*lock = 1;
+		res = 0;
+	}
+	pthread_mutex_unlock(&sim_lock);
+	return res;
+}
+
+void LightLock_Unlock(LightLock *lock)
+{
+	pthread_mutex_lock(&sim_lock);
+	*lock = 0;
+	pthread_cond_broadcast(&sim_cond);
+	pthread_mutex_unlock(&sim_lock);
+}
+
+/* Threads */
+
+struct Thread_tag {
+	pthread_t pthread;
+	Handle handle;
+	ThreadFunc func;
+	void *arg;
+	bool detached;
+	u32 id;
+};
+
+static __thread Thread current_thread; // NULL on the main thread, as in libctru
+static __thread u32 current_id;
+static u32 next_id = 1;
+
+static u32 threadId(void)
+{
+	if ( ! current_id ) {
+		pthread_mutex_lock(&sim_lock);
+		current_id = next_id++;
+		pthread_mutex_unlock(&sim_lock);
+	}
+	return current_id;
+}
+
+static void *threadEntry(void *arg)
+{
+	Thread t = (Thread)arg;
+	current_thread = t;
+	current_id = t->id;
+	t->func(t->arg);
+	pthread_mutex_lock(&sim_lock);
+	objects[t->handle - HANDLE_BASE].signaled = 1;
+	pthread_cond_broadcast(&sim_cond);
+	pthread_mutex_unlock(&sim_lock);
+	if ( t->detached ) {
+		svcCloseHandle(t->handle);
+		pthread_mutex_lock(&sim_lock);
+		objects[t->handle - HANDLE_BASE].type = OBJ_FREE;
+		pthread_mutex_unlock(&sim_lock);
+		free(t);
+	}
+	return NULL;
+}
+
+Thread threadCreate(ThreadFunc entrypoint, void *arg, size_t stack_size, int prio, int affinity, bool detached)
+{
+	Thread t = (Thread)calloc(1, sizeof(*t));
+	pthread_attr_t attr;
+
+	if ( ! t )
+		return NULL;
+	if ( newObject(&t->handle, OBJ_THREAD) != 0 ) {
+		free(t);
+		return NULL;
+	}
+	t->func = entrypoint;
+	t->arg = arg;
+	t->detached = detached;
+	pthread_mutex_lock(&sim_lock);
+	t->id = next_id++;
+	pthread_mutex_unlock(&sim_lock);
+
+	pthread_attr_init(&attr);
+	if ( stack_size < 64 * 1024 )
+		stack_size = 64 * 1024; // the host needs more stack than the 3DS for the same code
+	pthread_attr_setstacksize(&attr, stack_size);
+	if ( detached )
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if ( pthread_create(&t->pthread, &attr, threadEntry, t) != 0 ) {
+		pthread_attr_destroy(&attr);
+		pthread_mutex_lock(&sim_lock);
+		objects[t->handle - HANDLE_BASE].type = OBJ_FREE;
+		pthread_mutex_unlock(&sim_lock);
+		free(t);
+		return NULL;
+	}
+	pthread_attr_destroy(&attr);
+	return t;
+}
+
+Handle threadGetHandle(Thread thread)
+{
+	return thread ? thread->handle : CUR_THREAD_HANDLE;
+}
+
+Thread threadGetCurrent(void)
+{
+	return current_thread;
+}
+
+Result threadJoin(Thread thread, u64 timeout_ns)
+{
+	Result res;
+	if ( ! thread )
+		return 0;
+	res = svcWaitSynchronization(thread->handle, (s64)timeout_ns);
+	if ( res == 0 && ! thread->detached )
+		pthread_join(thread->pthread, NULL);
+	return res;
+}
+
+void threadFree(Thread thread)
+{
+	if ( ! thread || thread->detached )
+		return;
+	pthread_mutex_lock(&sim_lock);
+	objects[thread->handle - HANDLE_BASE].type = OBJ_FREE;
+	pthread_mutex_unlock(&sim_lock);
+	free(thread);
+}
+
+Result svcGetThreadPriority(s32 *out, Handle handle)
+{
+	*out = 0x30;
+	return 0;
+}
+
+Result svcGetThreadId(u32 *out, Handle handle)
+{
+	if ( handle == CUR_THREAD_HANDLE ) {
+		*out = threadId();
+		return 0;
+	}
+	// the Thread that owns this handle knows its id
+	*out = handle;
+	return 0;
+}
+
+Result APT_CheckNew3DS(bool *out)
+{
+	*out = false;
+	return 0;
+}
+
+/* Linear heap and VRAM. The blocks are kept in a list with their size,
+   so the use of both can be capped like on the console (N3DS_SIM_LINEAR
+   and N3DS_SIM_VRAM, in bytes), and freeing something that isn't a block
+   is caught: libctru ignores it, the sim says so on stderr. */
+
+#define HEAP_ALIGN	0x80
+#define LINEAR_SIZE	(32 * 1024 * 1024)
+#define VRAM_SIZE	(6 * 1024 * 1024)
+
+struct Heap {
+	const char *name, *env;
+	size_t size, used;
+};
+
+struct Block {
+	struct Block *next;
+	struct Heap *heap;
+	void *mem;
+	size_t size;
+};
+
+static struct Heap linear_heap = { "linear", "N3DS_SIM_LINEAR", 0, 0 };
+static struct Heap vram_heap = { "vram", "N3DS_SIM_VRAM", 0, 0 };
+static struct Block *blocks;
+
+static void *heapAlloc(struct Heap *heap, size_t defsize, size_t size, size_t alignment)
+{
+	struct Block *block = (struct Block *)malloc(sizeof(*block));
+
+	if ( alignment < HEAP_ALIGN )
+		alignment = HEAP_ALIGN;
+	if ( ! block )
+		return NULL;
+	if ( posix_memalign(&block->mem, alignment, size ? size : 1) != 0 ) {
+		free(block);
+		return NULL;
+	}
+	block->heap = heap;
+	block->size = size;
+
+	pthread_mutex_lock(&sim_lock);
+	if ( ! heap->size ) {
+		const char *env = getenv(heap->env);
+		heap->size = (env && strtoul(env, NULL, 0)) ? strtoul(env, NULL, 0) : defsize;
+	}
+	if ( heap->used + size > heap->size ) {
+		pthread_mutex_unlock(&sim_lock);
+		free(block->mem);
+		free(block);
+		return NULL;
+	}
+	heap->used += size;
+	block->next = blocks;
+	blocks = block;
+	pthread_mutex_unlock(&sim_lock);
+	return block->mem;
+}
+
+static void heapFree(struct Heap *heap, void *mem)
+{
+	struct Block **p, *block = NULL;
+
+	if ( ! mem )
+		return;
+	pthread_mutex_lock(&sim_lock);
+	for ( p = &blocks; *p; p = &(*p)->next ) {
+		if ( (*p)->mem == mem && (*p)->heap == heap ) {
+			block = *p;
+			*p = block->next;
+			heap->used -= block->size;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sim_lock);
+	if ( ! block ) {
+		fprintf(stderr, "n3ds-sim: %p isn't a %s block, not freed\n", mem, heap->name);
+		return;
+	}
+	free(block->mem);
+	free(block);
+}
+
+void *linearAlloc(size_t size)
+{
+	return heapAlloc(&linear_heap, LINEAR_SIZE, size, HEAP_ALIGN);
+}
+
+void *linearMemAlign(size_t size, size_t alignment)
+{
+	return heapAlloc(&linear_heap, LINEAR_SIZE, size, alignment);
+}
+
+void linearFree(void *mem)
+{
+	heapFree(&linear_heap, mem);
+}
+
+u32 linearSpaceFree(void)
+{
+	return (u32)((linear_heap.size ? linear_heap.size : LINEAR_SIZE) - linear_heap.used);
+}
+
+void *vramAlloc(size_t size)
+{
+	return heapAlloc(&vram_heap, VRAM_SIZE, size, HEAP_ALIGN);
+}
+
+void vramFree(void *mem)
+{
+	heapFree(&vram_heap, mem);
+}
+
+u32 vramSpaceFree(void)
+{
+	return (u32)((vram_heap.size ? vram_heap.size : VRAM_SIZE) - vram_heap.used);
+}
+
+u32 osConvertVirtToPhys(const void *vaddr)
+{
+	return (u32)(uintptr_t)vaddr;
+}
+
+/* Screens: two framebuffers each, stored in portrait like on the console
+   (240 pixels wide). gfxGetFramebuffer gives the one not shown. If
+   N3DS_SIM_SCREENSHOT is set, gfxExit saves what the screens show to
+   <prefix>-top.ppm and <prefix>-bottom.ppm. */
+
+#define VBLANK_NS	16713680	// the screens refresh at 59.83Hz
+
+struct Screen {
+	u16 width, height; // as gfxGetFramebuffer reports them
+	GSPGPU_FramebufferFormats format;
+	bool doublebuf;
+	int shown;
+	u8 *buffers[2];
+};
+
+static struct Screen screens[2] = {
+	{ 240, 400, GSP_BGR8_OES, true, 0, { NULL, NULL } },
+	{ 240, 320, GSP_BGR8_OES, true, 0, { NULL, NULL } },
+};
+
+int simFormatBytes(int fmt)
+{
+	switch ( fmt ) {
+		case GSP_RGBA8_OES:
+			return 4;
+		case GSP_BGR8_OES:
+			return 3;
+		default:
+			return 2;
+	}
+}
+
+void gfxInitDefault(void)
+{
+	int i, j;
+	for ( i = 0; i < 2; i++ ) {
+		for ( j = 0; j < 2; j++ ) {
+			if ( ! screens[i].buffers[j] )
+				screens[i].buffers[j] = calloc(screens[i].width * screens[i].height, 4);
+		}
+	}
+}
+
+/* The screen as it is shown, turned back to landscape, as a PPM */
+static void writeScreenshot(const char *prefix, gfxScreen_t screen)
+{
+	struct Screen *scr = &screens[screen];
+	const u8 *fb = scr->buffers[scr->shown];
+	int bpp = simFormatBytes(scr->format);
+	char path[1024];
+	FILE *f;
+	int x, y;
+
+	snprintf(path, sizeof(path), "%s-%s.ppm", prefix, screen == GFX_TOP ? "top" : "bottom");
+	if ( ! fb || ! (f = fopen(path, "wb")) )
+		return;
+	fprintf(f, "P6\n%d %d\n255\n", scr->height, scr->width);
+	for ( y = 0; y < scr->width; y++ ) {
+		for ( x = 0; x < scr->height; x++ ) {
+			const u8 *p = fb + (x * scr->width + (scr->width - 1 - y)) * bpp;
+			u8 rgb[3];
+			u16 v = p[0] | (p[1] << 8);
+			switch ( scr->format ) {
+				case GSP_RGBA8_OES:
+					rgb[0] = p[3]; rgb[1] = p[2]; rgb[2] = p[1];
+					break;
+				case GSP_BGR8_OES:
+					rgb[0] = p[2]; rgb[1] = p[1]; rgb[2] = p[0];
+					break;
+				case GSP_RGB565_OES:
+					rgb[0] = (v >> 11) << 3; rgb[1] = ((v >> 5) & 0x3F) << 2; rgb[2] = (v & 0x1F) << 3;
+					break;
+				case GSP_RGB5_A1_OES:
+					rgb[0] = (v >> 11) << 3; rgb[1] = ((v >> 6) & 0x1F) << 3; rgb[2] = ((v >> 1) & 0x1F) << 3;
+					break;
+				default:
+					rgb[0] = (v >> 12) << 4; rgb[1] = ((v >> 8) & 0xF) << 4; rgb[2] = ((v >> 4) & 0xF) << 4;
+					break;
+			}
+			fwrite(rgb, 3, 1, f);
+		}
+	}
+	fclose(f);
+}
+
+void gfxExit(void)
+{
+	const char *prefix = getenv("N3DS_SIM_SCREENSHOT");
+	int i, j;
+
+	if ( prefix ) {
+		writeScreenshot(prefix, GFX_TOP);
+		writeScreenshot(prefix, GFX_BOTTOM);
+	}
+	for ( i = 0; i < 2; i++ ) {
+		for ( j = 0; j < 2; j++ ) {
+			free(screens[i].buffers[j]);
+			screens[i].buffers[j] = NULL;
+		}
+	}
+}
+
+void gfxSet3D(bool enable)
+{
+}
+
+void gfxSetScreenFormat(gfxScreen_t screen, GSPGPU_FramebufferFormats format)
+{
+	screens[screen].format = format;
+}
+
+GSPGPU_FramebufferFormats gfxGetScreenFormat(gfxScreen_t screen)
+{
+	return screens[screen].format;
+}
+
+void gfxSetDoubleBuffering(gfxScreen_t screen, bool enable)
+{
+	screens[screen].doublebuf = enable;
+}
+
+u8 *gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16 *width, u16 *height)
+{
+	struct Screen *scr = &screens[screen];
+	if ( width ) *width = scr->width;
+	if ( height ) *height = scr->height;
+	return scr->buffers[scr->doublebuf ? scr->shown ^ 1 : scr->shown];
+}
+
+u8 *simFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16 *width, u16 *height)
+{
+	return gfxGetFramebuffer(screen, side, width, height);
+}
+
+void gfxScreenSwapBuffers(gfxScreen_t scr, bool hasStereo)
+{
+	if ( screens[scr].doublebuf )
+		screens[scr].shown ^= 1;
+}
+
+void gfxFlushBuffers(void)
+{
+}
+
+void gfxSwapBuffers(void)
+{
+	gfxScreenSwapBuffers(GFX_TOP, false);
+	gfxScreenSwapBuffers(GFX_BOTTOM, false);
+}
+
+void gfxSwapBuffersGpu(void)
+{
+	gfxSwapBuffers();
+}
+
+Result GSPGPU_FlushDataCache(const void *adr, u32 size)
+{
+	return 0;
+}
+
+Result GSPGPU_InvalidateDataCache(const void *adr, u32 size)
+{
+	return 0;
+}
+
+/* The GX transfers and the GPU are synchronous here, only the VBlank is waited for */
+void gspWaitForEvent(GSPGPU_Event id, bool nextEvent)
+{
+	if ( id == GSPGPU_EVENT_VBlank0 || id == GSPGPU_EVENT_VBlank1 )
+		simSleepUntil((simTimeNs() / VBLANK_NS + 1) * VBLANK_NS);
+}
+
+PrintConsole *consoleInit(gfxScreen_t screen, PrintConsole *console)
+{
+	// printf already goes to the terminal
+	return console;
+}
+
+/* Input script. Each line is "<scan> <keys> [touch <x> <y>] [circle <dx> <dy>]":
+   from the given hidScanInput call on, <keys> ('+' separated key names,
+   a number, or "-" for none) are held. A line "<scan> quit" makes
+   aptMainLoop return false. '#' starts a comment. */
+
+struct InputLine {
+	u32 scan;
+	u32 keys;
+	touchPosition touch;
+	circlePosition circle;
+	bool quit;
+};
+
+static const struct { const char *name; u32 key; } keynames[] = {
+	{ "A", KEY_A }, { "B", KEY_B }, { "SELECT", KEY_SELECT }, { "START", KEY_START },
+	{ "DRIGHT", KEY_DRIGHT }, { "DLEFT", KEY_DLEFT }, { "DUP", KEY_DUP }, { "DDOWN", KEY_DDOWN },
+	{ "R", KEY_R }, { "L", KEY_L }, { "X", KEY_X }, { "Y", KEY_Y }, { "ZL", KEY_ZL }, { "ZR", KEY_ZR },
+	{ "TOUCH", KEY_TOUCH },
+	{ "CSTICK_RIGHT", KEY_CSTICK_RIGHT }, { "CSTICK_LEFT", KEY_CSTICK_LEFT },
+	{ "CSTICK_UP", KEY_CSTICK_UP }, { "CSTICK_DOWN", KEY_CSTICK_DOWN },
+	{ "CPAD_RIGHT", KEY_CPAD_RIGHT }, { "CPAD_LEFT", KEY_CPAD_LEFT },
+	{ "CPAD_UP", KEY_CPAD_UP }, { "CPAD_DOWN", KEY_CPAD_DOWN },
+};
+
+static struct InputLine *input_lines;
+static int input_count, input_next;
+static bool input_loaded;
+static u32 input_scan;
+static u32 keys_held, keys_down, keys_up;
+static touchPosition touch_pos;
+static circlePosition circle_pos;
+static bool quit_requested;
+
+static u32 parseKeys(char *word)
+{
+	u32 keys = 0;
+	char *name;
+	if ( isdigit((unsigned char)word[0]) )
+		return (u32)strtoul(word, NULL, 0);
+	for ( name = strtok(word, "+"); name; name = strtok(NULL, "+") ) {
+		size_t i;
+		for ( i = 0; i < sizeof(keynames) / sizeof(keynames[0]); i++ ) {
+			if ( strcasecmp(name, keynames[i].name) == 0 )
+				keys |= keynames[i].key;
+		}
+	}
+	return keys;
+}
+
+static void loadInput(void)
+{
+	const char *path = getenv("N3DS_SIM_INPUT");
+	char line[256];
+	FILE *f;
+
+	input_loaded = true;
+	if ( ! path || ! (f = fopen(path, "r")) )
+		return;
+	while ( fgets(line, sizeof(line), f) ) {
+		struct InputLine in;
+		char *p = strchr(line, '#');
+		char *word, *save;
+		if ( p ) *p = '\0';
+		memset(&in, 0, sizeof(in));
+		if ( ! (word = strtok_r(line, " \t\r\n", &save)) )
+			continue;
+		in.scan = (u32)strtoul(word, NULL, 0);
+		while ( (word = strtok_r(NULL, " \t\r\n", &save)) ) {
+			if ( strcmp(word, "quit") == 0 ) {
+				in.quit = true;
+			} else if ( strcmp(word, "touch") == 0 ) {
+				in.keys |= KEY_TOUCH;
+				in.touch.px = (u16)atoi(strtok_r(NULL, " \t\r\n", &save) ?: "0");
+				in.touch.py = (u16)atoi(strtok_r(NULL, " \t\r\n", &save) ?: "0");
+			} else if ( strcmp(word, "circle") == 0 ) {
+				in.circle.dx = (s16)atoi(strtok_r(NULL, " \t\r\n", &save) ?: "0");
+				in.circle.dy = (s16)atoi(strtok_r(NULL, " \t\r\n", &save) ?: "0");
+			} else if ( strcmp(word, "-") != 0 ) {
+				in.keys |= parseKeys(word);
+			}
+		}
+		input_lines = realloc(input_lines, (input_count + 1) * sizeof(*input_lines));
+		input_lines[input_count++] = in;
+	}
+	fclose(f);
+}
+
+void hidScanInput(void)
+{
+	u32 held = keys_held;
+
+	if ( ! input_loaded )
+		loadInput();
+	while ( input_next < input_count && input_lines[input_next].scan <= input_scan ) {
+		struct InputLine *in = &input_lines[input_next++];
+		if ( in->quit ) {
+			__atomic_store_n(&quit_requested, true, __ATOMIC_RELAXED); // hidScanInput may run on an input thread
+			continue;
+		}
+		held = in->keys;
+		touch_pos = in->touch;
+		circle_pos = in->circle;
+	}
+	input_scan++;
+	keys_down = held & ~keys_held;
+	keys_up = keys_held & ~held;
+	keys_held = held;
+}
+
+u32 hidKeysHeld(void)
+{
+	return keys_held;
+}
+
+u32 hidKeysDown(void)
+{
+	return keys_down;
+}
+
+u32 hidKeysUp(void)
+{
+	return keys_up;
+}
+
+void hidTouchRead(touchPosition *pos)
+{
+	*pos = touch_pos;
+}
+
+void hidCircleRead(circlePosition *pos)
+{
+	*pos = circle_pos;
+}
+
+/* APT: the app runs until the input script says quit */
+
+static aptHookCookie *hooks;
+
+bool aptMainLoop(void)
+{
+	return ! __atomic_load_n(&quit_requested, __ATOMIC_RELAXED);
+}
+
+void aptHook(aptHookCookie *cookie, aptHookFn callback, void *param)
+{
+	cookie->callback = callback;
+	cookie->param = param;
+	cookie->next = hooks;
+	hooks = cookie;
+}
+
+void aptUnhook(aptHookCookie *cookie)
+{
+	aptHookCookie **p;
+	for ( p = &hooks; *p; p = &(*p)->next ) {
+		if ( *p == cookie ) {
+			*p = cookie->next;
+			break;
+		}
+	}
+}
+
+/* newlib has these, older glibc doesn't */
+__attribute__((weak)) size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len = strlen(src);
+	if ( size ) {
+		size_t n = (len < size - 1) ? len : size - 1;
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return len;
+}
+
+__attribute__((weak)) size_t strlcat(char *dst, const char *src, size_t size)
+{
+	size_t len = strlen(dst);
+	if ( len >= size )
+		return size + strlen(src);
+	return len + strlcpy(dst + len, src, size - len);
+}
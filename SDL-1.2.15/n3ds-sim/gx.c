@@ -0,0 +1,177 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+/* The GX transfer engine: display transfers (format conversion, tiling,
+   vertical flip, downscaling) and texture copies, done on the CPU when
+   they are submitted. Completion is immediate, so waiting for PPF never
+   blocks. */
+
+#include <string.h>
+
+#include "sim.h"
+
+#define FLAG_FLIP_VERT	BIT(0)
+#define FLAG_OUT_TILED	BIT(1)
+#define FLAG_RAW_COPY	BIT(3)
+
+/* Offset of pixel (x, y) in an image 'w' pixels wide stored in 8x8
+   tiles, the pixels of a tile in Morton order */
+static u32 tiledIndex(u32 x, u32 y, u32 w)
+{
+	u32 morton = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+	return ((y >> 3) * (w >> 3) + (x >> 3)) * 64 + morton;
+}
+
+static void decodePixel(const u8 *p, int fmt, u8 rgba[4])
+{
+	u16 v;
+	switch ( fmt ) {
+		case GX_TRANSFER_FMT_RGBA8:
+			rgba[0] = p[3]; rgba[1] = p[2]; rgba[2] = p[1]; rgba[3] = p[0];
+			break;
+		case GX_TRANSFER_FMT_RGB8:
+			rgba[0] = p[2]; rgba[1] = p[1]; rgba[2] = p[0]; rgba[3] = 0xFF;
+			break;
+		case GX_TRANSFER_FMT_RGB565:
+			v = p[0] | (p[1] << 8);
+			rgba[0] = ((v >> 11) & 0x1F) * 255 / 31;
+			rgba[1] = ((v >> 5) & 0x3F) * 255 / 63;
+			rgba[2] = (v & 0x1F) * 255 / 31;
+			rgba[3] = 0xFF;
+			break;
+		case GX_TRANSFER_FMT_RGB5A1:
+			v = p[0] | (p[1] << 8);
+			rgba[0] = ((v >> 11) & 0x1F) * 255 / 31;
+			rgba[1] = ((v >> 6) & 0x1F) * 255 / 31;
+			rgba[2] = ((v >> 1) & 0x1F) * 255 / 31;
+			rgba[3] = (v & 1) ? 0xFF : 0;
+			break;
+		default:
+			v = p[0] | (p[1] << 8);
+			rgba[0] = ((v >> 12) & 0xF) * 17;
+			rgba[1] = ((v >> 8) & 0xF) * 17;
+			rgba[2] = ((v >> 4) & 0xF) * 17;
+			rgba[3] = (v & 0xF) * 17;
+			break;
+	}
+}
+
+static void encodePixel(u8 *p, int fmt, const u8 rgba[4])
+{
+	u16 v;
+	switch ( fmt ) {
+		case GX_TRANSFER_FMT_RGBA8:
+			p[0] = rgba[3]; p[1] = rgba[2]; p[2] = rgba[1]; p[3] = rgba[0];
+			return;
+		case GX_TRANSFER_FMT_RGB8:
+			p[0] = rgba[2]; p[1] = rgba[1]; p[2] = rgba[0];
+			return;
+		case GX_TRANSFER_FMT_RGB565:
+			v = ((rgba[0] >> 3) << 11) | ((rgba[1] >> 2) << 5) | (rgba[2] >> 3);
+			break;
+		case GX_TRANSFER_FMT_RGB5A1:
+			v = ((rgba[0] >> 3) << 11) | ((rgba[1] >> 3) << 6) | ((rgba[2] >> 3) << 1) | (rgba[3] >> 7);
+			break;
+		default:
+			v = ((rgba[0] >> 4) << 12) | ((rgba[1] >> 4) << 8) | ((rgba[2] >> 4) << 4) | (rgba[3] >> 4);
+			break;
+	}
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+Result GX_DisplayTransfer(u32 *inadr, u32 indim, u32 *outadr, u32 outdim, u32 flags)
+{
+	const u8 *in = (const u8 *)inadr;
+	u8 *out = (u8 *)outadr;
+	u32 inw = indim & 0xFFFF, inh = indim >> 16;
+	u32 outw = outdim & 0xFFFF, outh = outdim >> 16;
+	int infmt = (flags >> 8) & 7, outfmt = (flags >> 12) & 7;
+	int inbpp = simFormatBytes(infmt), outbpp = simFormatBytes(outfmt);
+	int scale = (flags >> 24) & 3;
+	u32 sx = (scale >= GX_TRANSFER_SCALE_X) ? 2 : 1;
+	u32 sy = (scale == GX_TRANSFER_SCALE_XY) ? 2 : 1;
+	bool tiledin = ! (flags & FLAG_OUT_TILED), tiledout = (flags & FLAG_OUT_TILED) != 0;
+	u32 w, h, x, y;
+
+	if ( flags & FLAG_RAW_COPY ) {
+		memcpy(out, in, (inw * inh < outw * outh ? inw * inh : outw * outh) * inbpp);
+		return 0;
+	}
+
+	// the output is cropped to its own size
+	w = inw / sx < outw ? inw / sx : outw;
+	h = inh / sy < outh ? inh / sy : outh;
+	for ( y = 0; y < h; y++ ) {
+		u32 oy = (flags & FLAG_FLIP_VERT) ? h - 1 - y : y;
+		for ( x = 0; x < w; x++ ) {
+			u32 sum[4] = { 0, 0, 0, 0 };
+			u8 rgba[4];
+			u32 i, j, k;
+			for ( j = 0; j < sy; j++ ) {
+				for ( i = 0; i < sx; i++ ) {
+					u32 ix = x * sx + i, iy = y * sy + j;
+					u32 idx = tiledin ? tiledIndex(ix, iy, inw) : iy * inw + ix;
+					decodePixel(in + idx * inbpp, infmt, rgba);
+					for ( k = 0; k < 4; k++ )
+						sum[k] += rgba[k];
+				}
+			}
+			for ( k = 0; k < 4; k++ )
+				rgba[k] = sum[k] / (sx * sy);
+			encodePixel(out + (tiledout ? tiledIndex(x, oy, outw) : oy * outw + x) * outbpp, outfmt, rgba);
+		}
+	}
+	return 0;
+}
+
+/* The dimensions are line width and gap, in units of 16 bytes. A zero
+   width means the data is contiguous on that side. */
+Result GX_TextureCopy(u32 *inadr, u32 indim, u32 *outadr, u32 outdim, u32 size, u32 flags)
+{
+	const u8 *in = (const u8 *)inadr;
+	u8 *out = (u8 *)outadr;
+	u32 inw = (indim & 0xFFFF) * 16, ingap = (indim >> 16) * 16;
+	u32 outw = (outdim & 0xFFFF) * 16, outgap = (outdim >> 16) * 16;
+	u32 inpos = 0, outpos = 0;
+
+	if ( ! inw ) inw = size;
+	if ( ! outw ) outw = size;
+	while ( size ) {
+		u32 n = size;
+		if ( n > inw - inpos ) n = inw - inpos;
+		if ( n > outw - outpos ) n = outw - outpos;
+		memcpy(out, in, n);
+		in += n;
+		out += n;
+		size -= n;
+		if ( (inpos += n) == inw ) {
+			inpos = 0;
+			in += ingap;
+		}
+		if ( (outpos += n) == outw ) {
+			outpos = 0;
+			out += outgap;
+		}
+	}
+	return 0;
+}
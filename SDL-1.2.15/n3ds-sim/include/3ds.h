@@ -0,0 +1,170 @@
+#ifndef SIM_3DS_H
+#define SIM_3DS_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+typedef uint8_t u8; typedef uint16_t u16; typedef uint32_t u32; typedef uint64_t u64;
+typedef int8_t s8; typedef int16_t s16; typedef int32_t s32; typedef int64_t s64;
+typedef u32 Handle; typedef s32 Result;
+typedef volatile u8 vu8; typedef volatile u16 vu16; typedef volatile u32 vu32;
+#define U64_MAX UINT64_MAX
+#define BIT(n) (1U<<(n))
+#define R_SUCCEEDED(r) ((r)>=0)
+#define R_FAILED(r) ((r)<0)
+typedef enum { RESET_ONESHOT=0, RESET_STICKY=1, RESET_PULSE=2 } ResetType;
+typedef enum { GSP_RGBA8_OES=0, GSP_BGR8_OES=1, GSP_RGB565_OES=2, GSP_RGB5_A1_OES=3, GSP_RGBA4_OES=4 } GSPGPU_FramebufferFormats;
+typedef enum { GFX_TOP=0, GFX_BOTTOM=1 } gfxScreen_t;
+typedef enum { GFX_LEFT=0, GFX_RIGHT=1 } gfx3dSide_t;
+typedef enum { GSPGPU_EVENT_PSC0=0, GSPGPU_EVENT_PSC1, GSPGPU_EVENT_VBlank0, GSPGPU_EVENT_VBlank1, GSPGPU_EVENT_PPF, GSPGPU_EVENT_P3D, GSPGPU_EVENT_DMA } GSPGPU_Event;
+typedef enum { APTHOOK_ONSUSPEND=0, APTHOOK_ONRESTORE, APTHOOK_ONSLEEP, APTHOOK_ONWAKEUP, APTHOOK_ONEXIT } APT_HookType;
+typedef void (*aptHookFn)(APT_HookType hook, void* param);
+typedef struct tag_aptHookCookie { struct tag_aptHookCookie* next; aptHookFn callback; void* param; } aptHookCookie;
+typedef struct { u16 px, py; } touchPosition;
+typedef struct { s16 dx, dy; } circlePosition;
+typedef struct Thread_tag* Thread;
+typedef void (*ThreadFunc)(void*);
+typedef struct { s32 state; s32 type; s32 counter; } LightEvent;
+typedef s32 LightLock;
+typedef struct { LightLock lock; u32 thread_tag; u32 counter; } RecursiveLock;
+typedef struct PrintConsole PrintConsole;
+enum { KEY_A=BIT(0), KEY_B=BIT(1), KEY_SELECT=BIT(2), KEY_START=BIT(3), KEY_DRIGHT=BIT(4), KEY_DLEFT=BIT(5), KEY_DUP=BIT(6), KEY_DDOWN=BIT(7), KEY_R=BIT(8), KEY_L=BIT(9), KEY_X=BIT(10), KEY_Y=BIT(11), KEY_ZL=BIT(14), KEY_ZR=BIT(15), KEY_TOUCH=BIT(20), KEY_CSTICK_RIGHT=BIT(24), KEY_CSTICK_LEFT=BIT(25), KEY_CSTICK_UP=BIT(26), KEY_CSTICK_DOWN=BIT(27), KEY_CPAD_RIGHT=BIT(28), KEY_CPAD_LEFT=BIT(29), KEY_CPAD_UP=BIT(30), KEY_CPAD_DOWN=BIT(31) };
+#define SYSCLOCK_ARM11 268111856
+/* svc */
+void svcSleepThread(s64 ns);
+Result svcCreateEvent(Handle* event, ResetType reset_type);
+Result svcSignalEvent(Handle handle);
+Result svcClearEvent(Handle handle);
+Result svcCloseHandle(Handle handle);
+Result svcWaitSynchronization(Handle handle, s64 nanoseconds);
+Result svcWaitSynchronizationN(s32* out, const Handle* handles, s32 handles_num, bool wait_all, s64 nanoseconds);
+Result svcCreateSemaphore(Handle* semaphore, s32 initial_count, s32 max_count);
+Result svcReleaseSemaphore(s32* count, Handle semaphore, s32 release_count);
+Result svcGetThreadPriority(s32* out, Handle handle);
+Result svcGetThreadId(u32* out, Handle handle);
+u64 svcGetSystemTick(void);
+Result APT_CheckNew3DS(bool* out);
+/* synchronization */
+void LightEvent_Init(LightEvent* event, ResetType reset_type);
+void LightEvent_Clear(LightEvent* event);
+void LightEvent_Signal(LightEvent* event);
+int LightEvent_TryWait(LightEvent* event);
+void LightEvent_Wait(LightEvent* event);
+int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns);
+void LightLock_Init(LightLock* lock);
+void LightLock_Lock(LightLock* lock);
+int LightLock_TryLock(LightLock* lock);
+void LightLock_Unlock(LightLock* lock);
+/* threads */
+Thread threadCreate(ThreadFunc entrypoint, void* arg, size_t stack_size, int prio, int affinity, bool detached);
+Handle threadGetHandle(Thread thread);
+Thread threadGetCurrent(void);
+Result threadJoin(Thread thread, u64 timeout_ns);
+void threadFree(Thread thread);
+/* memory */
+void* linearAlloc(size_t size);
+void* linearMemAlign(size_t size, size_t alignment);
+void linearFree(void* mem);
+u32 linearSpaceFree(void);
+void* vramAlloc(size_t size);
+void vramFree(void* mem);
+u32 vramSpaceFree(void);
+u32 osConvertVirtToPhys(const void* vaddr);
+/* gfx / gsp */
+void gfxInitDefault(void);
+void gfxExit(void);
+void gfxSet3D(bool enable);
+void gfxSetScreenFormat(gfxScreen_t screen, GSPGPU_FramebufferFormats format);
+GSPGPU_FramebufferFormats gfxGetScreenFormat(gfxScreen_t screen);
+void gfxSetDoubleBuffering(gfxScreen_t screen, bool enable);
+u8* gfxGetFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16* width, u16* height);
+void gfxFlushBuffers(void);
+void gfxSwapBuffers(void);
+void gfxSwapBuffersGpu(void);
+void gfxScreenSwapBuffers(gfxScreen_t scr, bool hasStereo);
+Result GSPGPU_FlushDataCache(const void* adr, u32 size);
+Result GSPGPU_InvalidateDataCache(const void* adr, u32 size);
+void gspWaitForEvent(GSPGPU_Event id, bool nextEvent);
+#define gspWaitForPPF() gspWaitForEvent(GSPGPU_EVENT_PPF, false)
+#define gspWaitForVBlank() gspWaitForEvent(GSPGPU_EVENT_VBlank0, true)
+#define gspWaitForVBlank0() gspWaitForEvent(GSPGPU_EVENT_VBlank0, true)
+#define gspWaitForVBlank1() gspWaitForEvent(GSPGPU_EVENT_VBlank1, true)
+#define gspWaitForP3D() gspWaitForEvent(GSPGPU_EVENT_P3D, false)
+PrintConsole* consoleInit(gfxScreen_t screen, PrintConsole* console);
+/* apt */
+bool aptMainLoop(void);
+void aptHook(aptHookCookie* cookie, aptHookFn callback, void* param);
+void aptUnhook(aptHookCookie* cookie);
+/* hid */
+void hidScanInput(void);
+u32 hidKeysHeld(void);
+u32 hidKeysDown(void);
+u32 hidKeysUp(void);
+void hidTouchRead(touchPosition* pos);
+void hidCircleRead(circlePosition* pos);
+/* GX */
+#define GX_BUFFER_DIM(w, h) (((h)<<16)|((w)&0xFFFF))
+typedef enum { GX_TRANSFER_FMT_RGBA8=0, GX_TRANSFER_FMT_RGB8=1, GX_TRANSFER_FMT_RGB565=2, GX_TRANSFER_FMT_RGB5A1=3, GX_TRANSFER_FMT_RGBA4=4 } GX_TRANSFER_FORMAT;
+typedef enum { GX_TRANSFER_SCALE_NO=0, GX_TRANSFER_SCALE_X=1, GX_TRANSFER_SCALE_XY=2 } GX_TRANSFER_SCALE;
+#define GX_TRANSFER_FLIP_VERT(x) ((x)<<0)
+#define GX_TRANSFER_OUT_TILED(x) ((x)<<1)
+#define GX_TRANSFER_RAW_COPY(x) ((x)<<3)
+#define GX_TRANSFER_IN_FORMAT(x) ((x)<<8)
+#define GX_TRANSFER_OUT_FORMAT(x) ((x)<<12)
+#define GX_TRANSFER_SCALING(x) ((x)<<24)
+Result GX_DisplayTransfer(u32* inadr, u32 indim, u32* outadr, u32 outdim, u32 flags);
+Result GX_TextureCopy(u32* inadr, u32 indim, u32* outadr, u32 outdim, u32 size, u32 flags);
+/* ndsp */
+enum { NDSP_ENCODING_PCM8=0, NDSP_ENCODING_PCM16, NDSP_ENCODING_ADPCM };
+#define NDSP_CHANNELS(n) ((u32)(n) & 3)
+#define NDSP_ENCODING(n) (((u32)(n) & 3) << 2)
+enum { NDSP_FORMAT_MONO_PCM8=NDSP_CHANNELS(1)|NDSP_ENCODING(NDSP_ENCODING_PCM8), NDSP_FORMAT_MONO_PCM16=NDSP_CHANNELS(1)|NDSP_ENCODING(NDSP_ENCODING_PCM16), NDSP_FORMAT_MONO_ADPCM=NDSP_CHANNELS(1)|NDSP_ENCODING(NDSP_ENCODING_ADPCM), NDSP_FORMAT_STEREO_PCM8=NDSP_CHANNELS(2)|NDSP_ENCODING(NDSP_ENCODING_PCM8), NDSP_FORMAT_STEREO_PCM16=NDSP_CHANNELS(2)|NDSP_ENCODING(NDSP_ENCODING_PCM16) };
+typedef enum { NDSP_OUTPUT_MONO=0, NDSP_OUTPUT_STEREO=1, NDSP_OUTPUT_SURROUND=2 } ndspOutputMode;
+typedef enum { NDSP_INTERP_POLYPHASE=0, NDSP_INTERP_LINEAR=1, NDSP_INTERP_NONE=2 } ndspInterpType;
+enum { NDSP_WBUF_FREE=0, NDSP_WBUF_QUEUED=1, NDSP_WBUF_PLAYING=2, NDSP_WBUF_DONE=3 };
+typedef struct { u16 index; s16 history0, history1; } ndspAdpcmData;
+typedef struct tag_ndspWaveBuf ndspWaveBuf;
+struct tag_ndspWaveBuf { union { s8* data_pcm8; s16* data_pcm16; u8* data_adpcm; const void* data_vaddr; }; u32 nsamples; ndspAdpcmData* adpcm_data; u32 offset; bool looping; u8 status; u16 sequence_id; ndspWaveBuf* next; };
+typedef void (*ndspCallback)(void* data);
+Result ndspInit(void);
+void ndspExit(void);
+void ndspSetOutputMode(ndspOutputMode mode);
+void ndspSetMasterVol(float volume);
+void ndspSetCallback(ndspCallback callback, void* data);
+void ndspChnReset(int id);
+void ndspChnInitParams(int id);
+bool ndspChnIsPlaying(int id);
+u32 ndspChnGetSamplePos(int id);
+u16 ndspChnGetWaveBufSeq(int id);
+bool ndspChnIsPaused(int id);
+void ndspChnSetPaused(int id, bool paused);
+void ndspChnSetFormat(int id, u16 format);
+void ndspChnSetInterp(int id, ndspInterpType type);
+void ndspChnSetRate(int id, float rate);
+void ndspChnSetMix(int id, float mix[12]);
+void ndspChnSetAdpcmCoefs(int id, u16 coefs[16]);
+void ndspChnWaveBufClear(int id);
+void ndspChnWaveBufAdd(int id, ndspWaveBuf* buf);
+Result DSP_FlushDataCache(const void* address, u32 size);
+Result DSP_InvalidateDataCache(const void* address, u32 size);
+/* y2r */
+typedef enum { INPUT_YUV422_INDIV_8=0, INPUT_YUV420_INDIV_8, INPUT_YUV422_INDIV_16, INPUT_YUV420_INDIV_16, INPUT_YUV422_BATCH } Y2RU_InputFormat;
+typedef enum { OUTPUT_RGB_32=0, OUTPUT_RGB_24, OUTPUT_RGB_16_555, OUTPUT_RGB_16_565 } Y2RU_OutputFormat;
+typedef enum { ROTATION_NONE=0 } Y2RU_Rotation;
+typedef enum { BLOCK_LINE=0, BLOCK_8_BY_8 } Y2RU_BlockAlignment;
+typedef enum { COEFFICIENT_ITU_R_BT_601=0, COEFFICIENT_ITU_R_BT_709, COEFFICIENT_ITU_R_BT_601_SCALING, COEFFICIENT_ITU_R_BT_709_SCALING } Y2RU_StandardCoefficient;
+typedef struct { Y2RU_InputFormat input_format : 8; Y2RU_OutputFormat output_format : 8; Y2RU_Rotation rotation : 8; Y2RU_BlockAlignment block_alignment : 8; s16 input_line_width; s16 input_lines; Y2RU_StandardCoefficient standard_coefficient : 8; u8 unused; u16 alpha; } Y2RU_ConversionParams;
+Result y2rInit(void);
+void y2rExit(void);
+Result Y2RU_SetConversionParams(const Y2RU_ConversionParams* params);
+Result Y2RU_SetSendingY(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap);
+Result Y2RU_SetSendingU(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap);
+Result Y2RU_SetSendingV(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap);
+Result Y2RU_SetSendingYUYV(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap);
+Result Y2RU_SetReceiving(void* dst_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap);
+Result Y2RU_SetTransferEndInterrupt(bool should_interrupt);
+Result Y2RU_GetTransferEndEvent(Handle* end_event);
+Result Y2RU_StartConversion(void);
+Result Y2RU_StopConversion(void);
+Result Y2RU_IsBusyConversion(bool* is_busy);
+Result Y2RU_IsDoneReceiving(bool* is_done);
+#endif
@@ -0,0 +1,128 @@
+#ifndef SIM_CITRO3D_H
+#define SIM_CITRO3D_H
+#include <3ds.h>
+#define C3D_DEFAULT_CMDBUF_SIZE 0x40000
+typedef enum { GPU_RGBA8=0, GPU_RGB8=1, GPU_RGBA5551=2, GPU_RGB565=3, GPU_RGBA4=4, GPU_LA8=5, GPU_HILO8=6, GPU_L8=7, GPU_A8=8, GPU_LA4=9, GPU_L4=10, GPU_A4=11, GPU_ETC1=12, GPU_ETC1A4=13 } GPU_TEXCOLOR;
+typedef enum { GPU_NEAREST=0, GPU_LINEAR=1 } GPU_TEXTURE_FILTER_PARAM;
+typedef enum { GPU_CLAMP_TO_EDGE=0, GPU_CLAMP_TO_BORDER=1, GPU_REPEAT=2, GPU_MIRRORED_REPEAT=3 } GPU_TEXTURE_WRAP_PARAM;
+typedef enum { GPU_RB_RGBA8=0, GPU_RB_RGB8=1, GPU_RB_RGBA5551=2, GPU_RB_RGB565=3, GPU_RB_RGBA4=4 } GPU_COLORBUF;
+typedef enum { GPU_RB_DEPTH16=0, GPU_RB_DEPTH24=2, GPU_RB_DEPTH24_STENCIL8=3 } GPU_DEPTHBUF;
+typedef enum { GPU_TEXFACE_2D=0 } GPU_TEXFACE;
+typedef enum { GPU_PRIMARY_COLOR=0x00, GPU_FRAGMENT_PRIMARY_COLOR=0x01, GPU_FRAGMENT_SECONDARY_COLOR=0x02, GPU_TEXTURE0=0x03, GPU_TEXTURE1=0x04, GPU_TEXTURE2=0x05, GPU_TEXTURE3=0x06, GPU_PREVIOUS_BUFFER=0x0D, GPU_CONSTANT=0x0E, GPU_PREVIOUS=0x0F } GPU_TEVSRC;
+typedef enum { GPU_REPLACE=0x00, GPU_MODULATE=0x01, GPU_ADD=0x02 } GPU_COMBINEFUNC;
+typedef enum { GPU_TEVOP_RGB_SRC_COLOR=0, GPU_TEVOP_RGB_SRC_ALPHA=2 } GPU_TEVOP_RGB;
+typedef enum { GPU_TEVOP_A_SRC_ALPHA=0 } GPU_TEVOP_A;
+typedef enum { GPU_NEVER=0, GPU_ALWAYS=1, GPU_EQUAL=2, GPU_NOTEQUAL=3, GPU_LESS=4, GPU_LEQUAL=5, GPU_GREATER=6, GPU_GEQUAL=7 } GPU_TESTFUNC;
+typedef enum { GPU_BLEND_ADD=0 } GPU_BLENDEQUATION;
+typedef enum { GPU_ZERO=0, GPU_ONE=1, GPU_SRC_COLOR=2, GPU_ONE_MINUS_SRC_COLOR=3, GPU_DST_COLOR=4, GPU_ONE_MINUS_DST_COLOR=5, GPU_SRC_ALPHA=6, GPU_ONE_MINUS_SRC_ALPHA=7, GPU_DST_ALPHA=8, GPU_ONE_MINUS_DST_ALPHA=9, GPU_CONSTANT_COLOR=10, GPU_ONE_MINUS_CONSTANT_COLOR=11, GPU_CONSTANT_ALPHA=12, GPU_ONE_MINUS_CONSTANT_ALPHA=13 } GPU_BLENDFACTOR;
+typedef enum { GPU_WRITE_RED=1, GPU_WRITE_GREEN=2, GPU_WRITE_BLUE=4, GPU_WRITE_ALPHA=8, GPU_WRITE_COLOR=0xF, GPU_WRITE_DEPTH=0x10, GPU_WRITE_ALL=0x1F } GPU_WRITEMASK;
+typedef enum { GPU_CULL_NONE=0 } GPU_CULLMODE;
+typedef enum { GPU_TRIANGLES=0x0000, GPU_TRIANGLE_STRIP=0x0100, GPU_TRIANGLE_FAN=0x0200, GPU_GEOMETRY_PRIM=0x0300 } GPU_Primitive_t;
+typedef enum { GPU_BYTE=0, GPU_UNSIGNED_BYTE=1, GPU_SHORT=2, GPU_FLOAT=3 } GPU_FORMATS;
+typedef enum { GPU_VERTEX_SHADER=0, GPU_GEOMETRY_SHADER=1 } GPU_SHADER_TYPE;
+typedef enum { GPU_LUT_D0=0, GPU_LUT_D1=1, GPU_LUT_SP=2, GPU_LUT_FR=3, GPU_LUT_RB=4, GPU_LUT_RG=5, GPU_LUT_RR=6, GPU_LUT_DA=7 } GPU_LIGHTLUTID;
+typedef enum { GPU_LUTINPUT_NH=0, GPU_LUTINPUT_VH=1, GPU_LUTINPUT_NV=2, GPU_LUTINPUT_LN=3, GPU_LUTINPUT_SP=4, GPU_LUTINPUT_CP=5 } GPU_LIGHTLUTINPUT;
+typedef enum { GPU_BUMP_NOT_USED=0, GPU_BUMP_AS_BUMP=1, GPU_BUMP_AS_TANG=2 } GPU_BUMPMODE;
+typedef enum { C3D_RGB=1, C3D_Alpha=2, C3D_Both=3 } C3D_TexEnvMode;
+typedef enum { C3D_CLEAR_COLOR=1, C3D_CLEAR_DEPTH=2, C3D_CLEAR_ALL=3 } C3D_ClearBits;
+#define C3D_FRAME_SYNCDRAW  BIT(0)
+#define C3D_FRAME_NONBLOCK  BIT(1)
+typedef union { struct { float w, z, y, x; }; float c[4]; } C3D_FVec;
+typedef C3D_FVec C3D_FQuat;
+typedef union { C3D_FVec r[4]; float m[16]; } C3D_Mtx;
+typedef struct { void* data; GPU_TEXCOLOR fmt : 4; size_t size : 28; union { u32 dim; struct { u16 height; u16 width; }; }; u32 param; u32 border; union { u32 lodParam; struct { u16 lodBias; u8 maxLevel; u8 minLevel; }; }; } C3D_Tex;
+typedef struct C3D_RenderTarget_tag C3D_RenderTarget;
+struct C3D_RenderTarget_tag { C3D_RenderTarget *next, *prev; void* frameBuf; bool used; bool ownsColor, ownsDepth; bool linked; gfxScreen_t screen; gfx3dSide_t side; u32 transferFlags;
+	/* sim: the color buffer and its clear */ void* colorBuf; u16 width, height; GPU_COLORBUF colorFmt; C3D_ClearBits clearBits; u32 clearColor; };
+typedef struct { u32 flags[2]; u64 permutation; int attrCount; } C3D_AttrInfo;
+typedef struct { u32 base_paddr; int bufCount; } C3D_BufInfo;
+typedef struct { u16 srcRgb, srcAlpha; union { u32 opAll; struct { u32 opRgb:12, opAlpha:12; }; }; u16 funcRgb, funcAlpha; u32 color; u16 scaleRgb, scaleAlpha; } C3D_TexEnv;
+typedef struct { u32 data[256]; } C3D_LightLut;
+typedef struct { float ambient[3]; float diffuse[3]; float specular0[3]; float specular1[3]; float emission[3]; } C3D_Material;
+typedef struct C3D_LightEnv_t C3D_LightEnv;
+typedef struct C3D_Light_t C3D_Light;
+struct C3D_Light_t { u16 flags, id; C3D_LightEnv* parent; u32 conf[16]; };
+struct C3D_LightEnv_t { u32 flags; C3D_LightLut* luts[6]; float ambient[3]; C3D_Light* lights[8]; u32 conf[32]; C3D_Material material; };
+typedef struct { u32 code[512]; } DVLE_s;
+typedef struct { u32 numDVLE; DVLE_s* DVLE; } DVLB_s;
+typedef struct { void* dvle; } shaderInstance_s;
+typedef struct { shaderInstance_s* vertexShader; shaderInstance_s* geometryShader; } shaderProgram_s;
+DVLB_s* DVLB_ParseFile(u32* shbinData, u32 shbinSize);
+void DVLB_Free(DVLB_s* dvlb);
+Result shaderProgramInit(shaderProgram_s* sp);
+Result shaderProgramFree(shaderProgram_s* sp);
+Result shaderProgramSetVsh(shaderProgram_s* sp, DVLE_s* dvle);
+s8 shaderInstanceGetUniformLocation(shaderInstance_s* si, const char* name);
+bool C3D_Init(size_t cmdBufSize);
+void C3D_Fini(void);
+float C3D_GetCmdBufUsage(void);
+void C3D_BindProgram(shaderProgram_s* program);
+C3D_AttrInfo* C3D_GetAttrInfo(void);
+void AttrInfo_Init(C3D_AttrInfo* info);
+int AttrInfo_AddLoader(C3D_AttrInfo* info, int regId, GPU_FORMATS format, int count);
+C3D_BufInfo* C3D_GetBufInfo(void);
+void BufInfo_Init(C3D_BufInfo* info);
+int BufInfo_Add(C3D_BufInfo* info, const void* data, ptrdiff_t stride, int attribCount, u64 permutation);
+void C3D_FVUnifMtx4x4(GPU_SHADER_TYPE type, int id, const C3D_Mtx* mtx);
+void C3D_FVUnifSet(GPU_SHADER_TYPE type, int id, float x, float y, float z, float w);
+void Mtx_Identity(C3D_Mtx* out);
+void Mtx_Ortho(C3D_Mtx* mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded);
+void Mtx_OrthoTilt(C3D_Mtx* mtx, float left, float right, float bottom, float top, float near, float far, bool isLeftHanded);
+bool C3D_TexInit(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format);
+bool C3D_TexInitVRAM(C3D_Tex* tex, u16 width, u16 height, GPU_TEXCOLOR format);
+void C3D_TexUpload(C3D_Tex* tex, const void* data);
+void C3D_TexFlush(C3D_Tex* tex);
+void C3D_TexDelete(C3D_Tex* tex);
+void C3D_TexBind(int unitId, C3D_Tex* tex);
+void C3D_TexSetFilter(C3D_Tex* tex, GPU_TEXTURE_FILTER_PARAM magFilter, GPU_TEXTURE_FILTER_PARAM minFilter);
+void C3D_TexSetWrap(C3D_Tex* tex, GPU_TEXTURE_WRAP_PARAM wrapS, GPU_TEXTURE_WRAP_PARAM wrapT);
+C3D_TexEnv* C3D_GetTexEnv(int id);
+void C3D_TexEnvInit(C3D_TexEnv* env);
+void C3D_TexEnvSrc(C3D_TexEnv* env, C3D_TexEnvMode mode, int s1, int s2, int s3);
+void C3D_TexEnvOp(C3D_TexEnv* env, C3D_TexEnvMode mode, int o1, int o2, int o3);
+void C3D_TexEnvFunc(C3D_TexEnv* env, C3D_TexEnvMode mode, int param);
+void C3D_TexEnvColor(C3D_TexEnv* env, u32 color);
+void C3D_DepthTest(bool enable, GPU_TESTFUNC function, GPU_WRITEMASK writemask);
+void C3D_AlphaTest(bool enable, GPU_TESTFUNC function, int ref);
+void C3D_AlphaBlend(GPU_BLENDEQUATION colorEq, GPU_BLENDEQUATION alphaEq, GPU_BLENDFACTOR srcClr, GPU_BLENDFACTOR dstClr, GPU_BLENDFACTOR srcAlpha, GPU_BLENDFACTOR dstAlpha);
+void C3D_ColorLogicOp(int op);
+void C3D_CullFace(GPU_CULLMODE mode);
+void C3D_SetScissor(int mode, u32 left, u32 top, u32 right, u32 bottom);
+void C3D_ImmDrawBegin(GPU_Primitive_t primitive);
+void C3D_ImmSendAttrib(float x, float y, float z, float w);
+void C3D_ImmDrawEnd(void);
+void C3D_DrawArrays(GPU_Primitive_t primitive, int first, int size);
+float C3D_FrameRate(float fps);
+void C3D_FrameSync(void);
+u32 C3D_FrameCounter(int id);
+bool C3D_FrameBegin(u8 flags);
+bool C3D_FrameDrawOn(C3D_RenderTarget* target);
+void C3D_FrameSplit(u8 flags);
+void C3D_FrameEnd(u8 flags);
+C3D_RenderTarget* C3D_RenderTargetCreate(int width, int height, GPU_COLORBUF colorFmt, int depthFmt);
+C3D_RenderTarget* C3D_RenderTargetCreateFromTex(C3D_Tex* tex, GPU_TEXFACE face, int level, int depthFmt);
+void C3D_RenderTargetDelete(C3D_RenderTarget* target);
+void C3D_RenderTargetSetOutput(C3D_RenderTarget* target, gfxScreen_t screen, gfx3dSide_t side, u32 transferFlags);
+void C3D_RenderTargetClear(C3D_RenderTarget* target, C3D_ClearBits clearBits, u32 clearColor, u32 clearDepth);
+void C3D_RenderTargetSetClear(C3D_RenderTarget* target, C3D_ClearBits clearBits, u32 clearColor, u32 clearDepth);
+void C3D_SafeDisplayTransfer(u32* inadr, u32 indim, u32* outadr, u32 outdim, u32 flags);
+void C3D_SafeTextureCopy(u32* inadr, u32 indim, u32* outadr, u32 outdim, u32 size, u32 flags);
+void C3D_LightEnvInit(C3D_LightEnv* env);
+void C3D_LightEnvBind(C3D_LightEnv* env);
+void C3D_LightEnvMaterial(C3D_LightEnv* env, const C3D_Material* mtl);
+void C3D_LightEnvAmbient(C3D_LightEnv* env, float r, float g, float b);
+void C3D_LightEnvLut(C3D_LightEnv* env, GPU_LIGHTLUTID lutId, GPU_LIGHTLUTINPUT input, bool negative, C3D_LightLut* lut);
+void C3D_LightEnvBumpMode(C3D_LightEnv* env, GPU_BUMPMODE mode);
+void C3D_LightEnvBumpSel(C3D_LightEnv* env, int texUnit);
+void C3D_LightEnvBumpNormalZ(C3D_LightEnv *env, bool usez);
+void C3D_LightEnvClampHighlights(C3D_LightEnv* env, bool clamp);
+int C3D_LightInit(C3D_Light* light, C3D_LightEnv* env);
+void C3D_LightEnable(C3D_Light* light, bool enable);
+void C3D_LightTwoSideDiffuse(C3D_Light* light, bool enable);
+void C3D_LightAmbient(C3D_Light* light, float r, float g, float b);
+void C3D_LightDiffuse(C3D_Light* light, float r, float g, float b);
+void C3D_LightSpecular0(C3D_Light* light, float r, float g, float b);
+void C3D_LightSpecular1(C3D_Light* light, float r, float g, float b);
+void C3D_LightPosition(C3D_Light* light, C3D_FVec* pos);
+void LightLut_FromArray(C3D_LightLut* lut, float* data);
+#endif
@@ -0,0 +1,8 @@
+#ifndef SIM_LIBC_H
+#define SIM_LIBC_H
+/* newlib functions the n3ds config relies on (HAVE_STRLCPY...) that older
+   glibc lacks; n3ds-sim/ctru.c has weak definitions */
+#include <stddef.h>
+size_t strlcpy(char* dst, const char* src, size_t size);
+size_t strlcat(char* dst, const char* src, size_t size);
+#endif
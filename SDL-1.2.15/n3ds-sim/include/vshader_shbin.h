@@ -0,0 +1,2 @@
+#include <3ds.h>
+extern const u8 vshader_shbin[]; extern const u8 vshader_shbin_end[]; extern const u32 vshader_shbin_size;
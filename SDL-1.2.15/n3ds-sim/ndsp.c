@@ -0,0 +1,305 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+/* The DSP: 24 channels, each with a queue of wave buffers. A thread
+   runs a frame of 160 output samples at 32728Hz on the simulated clock,
+   like the DSP firmware does, moves the channels through their buffers
+   at their rate and calls the frame callback. Each buffer goes QUEUED,
+   PLAYING then DONE, as the drivers expect.
+
+   If N3DS_SIM_AUDIO names a file, the channels are mixed (nearest
+   sample, front left/right of the mix) into it, as raw signed 16 bit
+   stereo at 32728Hz. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define NDSP_CHANNELS_NUM	24
+#define NDSP_SAMPLE_RATE	(SYSCLOCK_ARM11 / 8192.0)	// 32728.5Hz
+#define NDSP_FRAME_SAMPLES	160
+
+struct Channel {
+	ndspWaveBuf *head;	// playing, then the queued ones
+	double pos;			// in samples of the head buffer
+	float rate;
+	u16 format;
+	float mix[12];
+	bool paused;
+	u16 seq, playingseq;
+};
+
+static pthread_mutex_t ndsp_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct Channel channels[NDSP_CHANNELS_NUM];
+static ndspCallback frame_callback;
+static void *frame_data;
+static int ndsp_refcount = 0;
+static volatile bool ndsp_running;
+static pthread_t ndsp_thread;
+static FILE *ndsp_out;
+
+static void resetChannel(struct Channel *chn)
+{
+	memset(chn, 0, sizeof(*chn));
+	chn->rate = 1.0f;
+	chn->format = NDSP_FORMAT_MONO_PCM16;
+	chn->mix[0] = chn->mix[1] = 1.0f;
+}
+
+/* Sample 'i' of a buffer, one channel of it */
+static float sampleAt(const ndspWaveBuf *buf, u16 format, u32 i, int c)
+{
+	int nch = (format & 3) == 2 ? 2 : 1;
+	if ( c >= nch )
+		c = 0;
+	switch ( (format >> 2) & 3 ) {
+		case NDSP_ENCODING_PCM8:
+			return buf->data_pcm8[i * nch + c] / 128.0f;
+		case NDSP_ENCODING_PCM16:
+			return buf->data_pcm16[i * nch + c] / 32768.0f;
+	}
+	return 0.0f; // ADPCM isn't decoded
+}
+
+/* One frame of one channel, with ndsp_lock held */
+static void runChannel(struct Channel *chn, float *out)
+{
+	double step = chn->rate / NDSP_SAMPLE_RATE;
+	int i;
+
+	if ( chn->paused )
+		return;
+	for ( i = 0; i < NDSP_FRAME_SAMPLES && chn->head; i++ ) {
+		ndspWaveBuf *buf = chn->head;
+		u32 s;
+
+		if ( buf->status != NDSP_WBUF_PLAYING ) {
+			buf->status = NDSP_WBUF_PLAYING;
+			chn->playingseq = buf->sequence_id;
+			chn->pos = buf->offset;
+		}
+		s = (u32)chn->pos;
+		if ( out && buf->data_vaddr ) {
+			out[i * 2] += sampleAt(buf, chn->format, s, 0) * chn->mix[0];
+			out[i * 2 + 1] += sampleAt(buf, chn->format, s, 1) * chn->mix[1];
+		}
+		chn->pos += step;
+		if ( chn->pos >= buf->nsamples ) {
+			if ( buf->looping ) {
+				chn->pos -= buf->nsamples;
+				continue;
+			}
+			buf->status = NDSP_WBUF_DONE;
+			chn->head = buf->next;
+			if ( chn->head ) {
+				chn->head->status = NDSP_WBUF_PLAYING;
+				chn->playingseq = chn->head->sequence_id;
+				chn->pos = chn->head->offset + (chn->pos - buf->nsamples);
+			} else {
+				chn->pos = 0.0;
+			}
+		}
+	}
+}
+
+static void *ndspThread(void *arg)
+{
+	u64 frame_ns = (u64)(NDSP_FRAME_SAMPLES * 1e9 / NDSP_SAMPLE_RATE);
+	u64 next = simTimeNs();
+	float mixed[NDSP_FRAME_SAMPLES * 2];
+	s16 pcm[NDSP_FRAME_SAMPLES * 2];
+	int i;
+
+	while ( ndsp_running ) {
+		ndspCallback callback;
+		void *data;
+
+		next += frame_ns;
+		simSleepUntil(next);
+
+		memset(mixed, 0, sizeof(mixed));
+		pthread_mutex_lock(&ndsp_lock);
+		for ( i = 0; i < NDSP_CHANNELS_NUM; i++ )
+			runChannel(&channels[i], ndsp_out ? mixed : NULL);
+		callback = frame_callback;
+		data = frame_data;
+		pthread_mutex_unlock(&ndsp_lock);
+
+		if ( ndsp_out ) {
+			for ( i = 0; i < NDSP_FRAME_SAMPLES * 2; i++ ) {
+				float v = mixed[i] * 32767.0f;
+				pcm[i] = v > 32767.0f ? 32767 : v < -32768.0f ? -32768 : (s16)v;
+			}
+			fwrite(pcm, sizeof(pcm), 1, ndsp_out);
+		}
+		if ( callback )
+			callback(data);
+	}
+	return NULL;
+}
+
+Result ndspInit(void)
+{
+	const char *path;
+	int i;
+
+	if ( ndsp_refcount++ > 0 )
+		return 0;
+	for ( i = 0; i < NDSP_CHANNELS_NUM; i++ )
+		resetChannel(&channels[i]);
+	if ( (path = getenv("N3DS_SIM_AUDIO")) != NULL )
+		ndsp_out = fopen(path, "wb");
+	ndsp_running = true;
+	if ( pthread_create(&ndsp_thread, NULL, ndspThread, NULL) != 0 ) {
+		ndsp_running = false;
+		ndsp_refcount--;
+		return -1;
+	}
+	return 0;
+}
+
+void ndspExit(void)
+{
+	if ( ndsp_refcount == 0 || --ndsp_refcount > 0 )
+		return;
+	ndsp_running = false;
+	pthread_join(ndsp_thread, NULL);
+	if ( ndsp_out ) {
+		fclose(ndsp_out);
+		ndsp_out = NULL;
+	}
+}
+
+void ndspSetOutputMode(ndspOutputMode mode)
+{
+}
+
+void ndspSetMasterVol(float volume)
+{
+}
+
+void ndspSetCallback(ndspCallback callback, void *data)
+{
+	pthread_mutex_lock(&ndsp_lock);
+	frame_callback = callback;
+	frame_data = data;
+	pthread_mutex_unlock(&ndsp_lock);
+}
+
+void ndspChnReset(int id)
+{
+	pthread_mutex_lock(&ndsp_lock);
+	resetChannel(&channels[id]);
+	pthread_mutex_unlock(&ndsp_lock);
+}
+
+void ndspChnInitParams(int id)
+{
+	ndspChnReset(id);
+}
+
+bool ndspChnIsPlaying(int id)
+{
+	return channels[id].head != NULL && ! channels[id].paused;
+}
+
+u32 ndspChnGetSamplePos(int id)
+{
+	return (u32)channels[id].pos;
+}
+
+u16 ndspChnGetWaveBufSeq(int id)
+{
+	return channels[id].head ? channels[id].playingseq : 0;
+}
+
+bool ndspChnIsPaused(int id)
+{
+	return channels[id].paused;
+}
+
+void ndspChnSetPaused(int id, bool paused)
+{
+	channels[id].paused = paused;
+}
+
+void ndspChnSetFormat(int id, u16 format)
+{
+	channels[id].format = format;
+}
+
+void ndspChnSetInterp(int id, ndspInterpType type)
+{
+}
+
+void ndspChnSetRate(int id, float rate)
+{
+	channels[id].rate = rate;
+}
+
+void ndspChnSetMix(int id, float mix[12])
+{
+	pthread_mutex_lock(&ndsp_lock);
+	memcpy(channels[id].mix, mix, sizeof(channels[id].mix));
+	pthread_mutex_unlock(&ndsp_lock);
+}
+
+void ndspChnSetAdpcmCoefs(int id, u16 coefs[16])
+{
+}
+
+void ndspChnWaveBufClear(int id)
+{
+	pthread_mutex_lock(&ndsp_lock);
+	channels[id].head = NULL;
+	channels[id].pos = 0.0;
+	pthread_mutex_unlock(&ndsp_lock);
+}
+
+void ndspChnWaveBufAdd(int id, ndspWaveBuf *buf)
+{
+	struct Channel *chn = &channels[id];
+	ndspWaveBuf **p;
+
+	pthread_mutex_lock(&ndsp_lock);
+	buf->next = NULL;
+	buf->status = NDSP_WBUF_QUEUED;
+	if ( ++chn->seq == 0 )
+		chn->seq = 1;
+	buf->sequence_id = chn->seq;
+	for ( p = &chn->head; *p; p = &(*p)->next )
+		;
+	*p = buf;
+	pthread_mutex_unlock(&ndsp_lock);
+}
+
+Result DSP_FlushDataCache(const void *address, u32 size)
+{
+	return 0;
+}
+
+Result DSP_InvalidateDataCache(const void *address, u32 size)
+{
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+
+#ifndef _n3ds_sim_h
+#define _n3ds_sim_h
+
+/* Shared by the pieces of the libctru/citro3d stand-in */
+
+#include <pthread.h>
+#include <3ds.h>
+
+/* One lock for all the simulated kernel objects; sim_cond is broadcast
+   whenever one of them changes state */
+extern pthread_mutex_t sim_lock;
+extern pthread_cond_t sim_cond;
+
+/* The simulated clock, in nanoseconds since the first use. It runs at
+   N3DS_SIM_SPEED times real time (1 by default). */
+extern u64 simTimeNs(void);
+/* Sleep until the simulated clock reaches 'ns' */
+extern void simSleepUntil(u64 ns);
+/* The real time at which the simulated clock reaches 'ns', for timed waits */
+extern struct timespec simDeadline(u64 ns);
+
+/* Back buffer of a screen, and its flip, for the citro3d frame end */
+extern u8 *simFramebuffer(gfxScreen_t screen, gfx3dSide_t side, u16 *width, u16 *height);
+
+/* Bytes per pixel of the GX/GSP formats (GSP_RGBA8_OES...) */
+extern int simFormatBytes(int fmt);
+
+#endif /* _n3ds_sim_h */
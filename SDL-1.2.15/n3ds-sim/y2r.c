@@ -0,0 +1,283 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* A portable stand-in for the libctru Y2R service, so the YUV overlay code
+   can be built and checked off the console. The conversion is done on the
+   CPU, synchronously, when it is started; the transfer end event is
+   signaled when it is done. It follows what the hardware does for the
+   modes the overlays use: 8 bit planar 4:2:0 and 4:2:2, packed YUYV, the
+   four output formats, line or 8x8 block output, BT.601/709 coefficients
+   in the PC or TV range. Rotation isn't emulated.
+
+   This is part of the host build in n3ds-sim/ (Makefile.n3ds-sim), the
+   3DS build uses the libctru service. */
+
+#include "SDL_stdinc.h"
+
+#include <3ds.h>
+
+struct Y2R_Transfer {
+	Uint8 *buf;
+	u32 size;
+	int unit, gap;
+};
+
+static Y2RU_ConversionParams y2r_params;
+static struct Y2R_Transfer y2r_y, y2r_u, y2r_v, y2r_yuyv, y2r_out;
+static Handle y2r_endevent;
+static bool y2r_interrupt;
+static bool y2r_done;
+static int y2r_refcount = 0;
+
+/* Byte 'i' of a transfer that skips 'gap' bytes after every 'unit' bytes */
+static Uint8 *Y2R_At(const struct Y2R_Transfer *t, u32 i)
+{
+	if ( t->unit <= 0 )
+		return(t->buf + i);
+	return(t->buf + (i / t->unit) * (t->unit + t->gap) + (i % t->unit));
+}
+
+static void Y2R_SetTransfer(struct Y2R_Transfer *t, const void *buf, u32 size, s16 unit, s16 gap)
+{
+	t->buf = (Uint8 *)buf;
+	t->size = size;
+	t->unit = unit;
+	t->gap = gap;
+}
+
+static int Y2R_Clamp(int v)
+{
+	return(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+/* One pixel, with 8.8 fixed point coefficients */
+static void Y2R_ToRGB(int y, int u, int v, int *r, int *g, int *b)
+{
+	int bt709 = (y2r_params.standard_coefficient == COEFFICIENT_ITU_R_BT_709 ||
+	             y2r_params.standard_coefficient == COEFFICIENT_ITU_R_BT_709_SCALING);
+	int tvrange = (y2r_params.standard_coefficient == COEFFICIENT_ITU_R_BT_601_SCALING ||
+	               y2r_params.standard_coefficient == COEFFICIENT_ITU_R_BT_709_SCALING);
+	int l;
+
+	u -= 128;
+	v -= 128;
+	if ( tvrange ) {
+		l = (y - 16) * 298;
+		if ( bt709 ) {
+			*r = l + 459 * v;
+			*g = l - 55 * u - 136 * v;
+			*b = l + 541 * u;
+		} else {
+			*r = l + 409 * v;
+			*g = l - 100 * u - 208 * v;
+			*b = l + 516 * u;
+		}
+	} else {
+		l = y * 256;
+		if ( bt709 ) {
+			*r = l + 403 * v;
+			*g = l - 48 * u - 120 * v;
+			*b = l + 475 * u;
+		} else {
+			*r = l + 359 * v;
+			*g = l - 88 * u - 183 * v;
+			*b = l + 454 * u;
+		}
+	}
+	*r = Y2R_Clamp((*r + 128) >> 8);
+	*g = Y2R_Clamp((*g + 128) >> 8);
+	*b = Y2R_Clamp((*b + 128) >> 8);
+}
+
+/* Output pixels are stored as the matching GPU texture formats, little endian */
+static int Y2R_OutputBpp(void)
+{
+	switch ( y2r_params.output_format ) {
+		case OUTPUT_RGB_32: return(4);
+		case OUTPUT_RGB_24: return(3);
+		default: return(2);
+	}
+}
+
+static void Y2R_Store(u32 offset, int r, int g, int b)
+{
+	Uint32 p;
+	int i, bpp = Y2R_OutputBpp();
+
+	switch ( y2r_params.output_format ) {
+		case OUTPUT_RGB_32:
+			p = (Uint32)r << 24 | (Uint32)g << 16 | (Uint32)b << 8 | (y2r_params.alpha & 0xFF);
+			break;
+		case OUTPUT_RGB_24:
+			p = (Uint32)r << 16 | (Uint32)g << 8 | (Uint32)b;
+			break;
+		case OUTPUT_RGB_16_555:
+			p = (Uint32)(r >> 3) << 11 | (Uint32)(g >> 3) << 6 | (Uint32)(b >> 3) << 1 | ((y2r_params.alpha & 0x80) ? 1 : 0);
+			break;
+		default:
+			p = (Uint32)(r >> 3) << 11 | (Uint32)(g >> 2) << 5 | (Uint32)(b >> 3);
+			break;
+	}
+	for ( i = 0; i < bpp; i++ )
+		*Y2R_At(&y2r_out, offset * bpp + i) = (Uint8)(p >> (i * 8));
+}
+
+/* Position of pixel (x, y) in the output stream */
+static u32 Y2R_OutputIndex(int x, int y, int w)
+{
+	if ( y2r_params.block_alignment == BLOCK_8_BY_8 ) {
+		// rows of 8x8 blocks, Z order inside a block
+		u32 i = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2) | ((x & 4) << 2) | ((y & 4) << 3);
+		return((y / 8) * 8 * w + (x / 8) * 64 + i);
+	}
+	return(y * w + x);
+}
+
+Result y2rInit(void)
+{
+	if ( y2r_refcount++ == 0 ) {
+		svcCreateEvent(&y2r_endevent, RESET_ONESHOT);
+		y2r_done = true;
+	}
+	return(0);
+}
+
+void y2rExit(void)
+{
+	if ( --y2r_refcount == 0 )
+		svcCloseHandle(y2r_endevent);
+}
+
+Result Y2RU_SetConversionParams(const Y2RU_ConversionParams* params)
+{
+	y2r_params = *params;
+	return(0);
+}
+
+Result Y2RU_SetSendingY(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap)
+{
+	Y2R_SetTransfer(&y2r_y, src_buf, image_size, transfer_unit, transfer_gap);
+	return(0);
+}
+
+Result Y2RU_SetSendingU(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap)
+{
+	Y2R_SetTransfer(&y2r_u, src_buf, image_size, transfer_unit, transfer_gap);
+	return(0);
+}
+
+Result Y2RU_SetSendingV(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap)
+{
+	Y2R_SetTransfer(&y2r_v, src_buf, image_size, transfer_unit, transfer_gap);
+	return(0);
+}
+
+Result Y2RU_SetSendingYUYV(const void* src_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap)
+{
+	Y2R_SetTransfer(&y2r_yuyv, src_buf, image_size, transfer_unit, transfer_gap);
+	return(0);
+}
+
+Result Y2RU_SetReceiving(void* dst_buf, u32 image_size, s16 transfer_unit, s16 transfer_gap)
+{
+	Y2R_SetTransfer(&y2r_out, dst_buf, image_size, transfer_unit, transfer_gap);
+	return(0);
+}
+
+Result Y2RU_SetTransferEndInterrupt(bool should_interrupt)
+{
+	y2r_interrupt = should_interrupt;
+	return(0);
+}
+
+Result Y2RU_GetTransferEndEvent(Handle* end_event)
+{
+	*end_event = y2r_endevent;
+	return(0);
+}
+
+Result Y2RU_StartConversion(void)
+{
+	int w = y2r_params.input_line_width;
+	int h = y2r_params.input_lines;
+	int x, y, r, g, b;
+
+	y2r_done = false;
+	for ( y = 0; y < h; y++ ) {
+		for ( x = 0; x < w; x++ ) {
+			int Y, U, V;
+			switch ( y2r_params.input_format ) {
+				case INPUT_YUV422_BATCH:
+					Y = *Y2R_At(&y2r_yuyv, (y * w + x) * 2);
+					U = *Y2R_At(&y2r_yuyv, (y * w + (x & ~1)) * 2 + 1);
+					V = *Y2R_At(&y2r_yuyv, (y * w + (x & ~1)) * 2 + 3);
+					break;
+				case INPUT_YUV420_INDIV_8:
+					Y = *Y2R_At(&y2r_y, y * w + x);
+					U = *Y2R_At(&y2r_u, (y / 2) * (w / 2) + x / 2);
+					V = *Y2R_At(&y2r_v, (y / 2) * (w / 2) + x / 2);
+					break;
+				case INPUT_YUV422_INDIV_8:
+					Y = *Y2R_At(&y2r_y, y * w + x);
+					U = *Y2R_At(&y2r_u, y * (w / 2) + x / 2);
+					V = *Y2R_At(&y2r_v, y * (w / 2) + x / 2);
+					break;
+				default:
+					// 16 bit planes: the low byte of each sample
+					Y = *Y2R_At(&y2r_y, (y * w + x) * 2);
+					if ( y2r_params.input_format == INPUT_YUV420_INDIV_16 ) {
+						U = *Y2R_At(&y2r_u, ((y / 2) * (w / 2) + x / 2) * 2);
+						V = *Y2R_At(&y2r_v, ((y / 2) * (w / 2) + x / 2) * 2);
+					} else {
+						U = *Y2R_At(&y2r_u, (y * (w / 2) + x / 2) * 2);
+						V = *Y2R_At(&y2r_v, (y * (w / 2) + x / 2) * 2);
+					}
+					break;
+			}
+			Y2R_ToRGB(Y, U, V, &r, &g, &b);
+			Y2R_Store(Y2R_OutputIndex(x, y, w), r, g, b);
+		}
+	}
+	y2r_done = true;
+	if ( y2r_interrupt )
+		svcSignalEvent(y2r_endevent);
+	return(0);
+}
+
+Result Y2RU_StopConversion(void)
+{
+	y2r_done = true;
+	return(0);
+}
+
+Result Y2RU_IsBusyConversion(bool* is_busy)
+{
+	*is_busy = !y2r_done;
+	return(0);
+}
+
+Result Y2RU_IsDoneReceiving(bool* is_done)
+{
+	*is_done = y2r_done;
+	return(0);
+}
@@ -124,6 +124,21 @@ SDL_AudioDevice *current_audio = NULL;
 int SDL_AudioInit(const char *driver_name);
 void SDL_AudioQuit(void);
 
+/* A conversion at an arbitrary rate ratio can come out a few frames
+   short of the device buffer: hold the last frame until its end */
+static void SDL_PadAudio(SDL_AudioDevice *audio, Uint8 *stream)
+{
+	int framesize = ((audio->spec.format & 0xFF) / 8) * audio->spec.channels;
+	int len = audio->convert.len_cvt;
+
+	if ( len < framesize ) {
+		return;
+	}
+	for ( ; len + framesize <= (int)audio->spec.size; len += framesize ) {
+		SDL_memcpy(stream + len, stream + len - framesize, framesize);
+	}
+}
+
 /* The general mixing thread function */
 int SDLCALL SDL_RunAudio(void *audiop)
 {
@@ -179,10 +194,18 @@ int SDLCALL SDL_RunAudio(void *audiop)
 
 	/* Loop, filling the audio buffers */
 	while ( audio->enabled ) {
+		Uint8 *cvtstream = NULL;
 
 		/* Fill the current buffer with sound */
 		if ( audio->convert.needed ) {
-			if ( audio->convert.buf ) {
+			/* Convert in place in the device buffer when the conversion
+			   fits in it, which saves copying the result there */
+			if ( audio->convert.len*audio->convert.len_mult <= (int)audio->spec.size ) {
+				cvtstream = audio->GetAudioBuf(audio);
+			}
+			if ( cvtstream ) {
+				stream = cvtstream;
+			} else if ( audio->convert.buf ) {
 				stream = audio->convert.buf;
 			} else {
 				continue;
@@ -203,7 +226,13 @@ int SDLCALL SDL_RunAudio(void *audiop)
 		}
 
 		/* Convert the audio if necessary */
-		if ( audio->convert.needed ) {
+		if ( cvtstream ) {
+			Uint8 *buf = audio->convert.buf;
+			audio->convert.buf = cvtstream;
+			SDL_ConvertAudio(&audio->convert);
+			audio->convert.buf = buf;
+			SDL_PadAudio(audio, stream);
+		} else if ( audio->convert.needed ) {
 			SDL_ConvertAudio(&audio->convert);
 			stream = audio->GetAudioBuf(audio);
 			if ( stream == NULL ) {
@@ -211,6 +240,7 @@ int SDLCALL SDL_RunAudio(void *audiop)
 			}
 			SDL_memcpy(stream, audio->convert.buf,
 			               audio->convert.len_cvt);
+			SDL_PadAudio(audio, stream);
 		}
 
 		/* Ready current buffer for play and change current buffer */
@@ -537,6 +567,9 @@ int SDL_OpenAudio(SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
 		if ( audio->convert.needed ) {
 			audio->convert.len = (int) ( ((double) audio->spec.size) /
                                           audio->convert.len_ratio );
+			/* in whole frames, the ratio may not be a power of two */
+			audio->convert.len -= audio->convert.len %
+				(((desired->format & 0xFF) / 8) * desired->channels);
 			audio->convert.buf =(Uint8 *)SDL_AllocAudioMem(
 			   audio->convert.len*audio->convert.len_mult);
 			if ( audio->convert.buf == NULL ) {
@@ -1300,6 +1300,236 @@ void SDLCALL SDL_RateSLOW(SDL_AudioCVT *cvt, Uint16 format)
 	}
 }
 
+/* Arbitrary ratio resampler, in a single pass and in fixed point:
+   cvt->rate_incr is the number of source frames per converted frame.
+   The source is moved to the end of the buffer (it is len*len_mult big)
+   and the converted frames are written from the start, so they never
+   overwrite source frames still to be read. The edges of the buffer are
+   held, as there is no history between two calls. */
+
+#define RESAMPLE_ZEROS	8	/* zero crossings on each side of the sinc */
+#define RESAMPLE_PHASES	256	/* table entries per zero crossing */
+#define RESAMPLE_BITS	14	/* fixed point of the table */
+#define RESAMPLE_MAXRATIO	8	/* past it, the filters chain */
+#define RESAMPLE_PI	3.14159265358979323846
+
+static Sint16 resample_table[RESAMPLE_ZEROS*RESAMPLE_PHASES+1];
+static int resample_table_ready = 0;
+
+/* Blackman windowed sinc from x=0 to ZEROS. The sines and cosines come
+   from rotations by small steps, so libm isn't needed. */
+static void SDL_BuildResampleTable(void)
+{
+	const double d1 = RESAMPLE_PI / RESAMPLE_PHASES;
+	const double d2 = d1 / RESAMPLE_ZEROS;
+	const double sd1 = d1 - d1*d1*d1/6 + d1*d1*d1*d1*d1/120;
+	const double cd1 = 1 - d1*d1/2 + d1*d1*d1*d1/24;
+	const double sd2 = d2 - d2*d2*d2/6 + d2*d2*d2*d2*d2/120;
+	const double cd2 = 1 - d2*d2/2 + d2*d2*d2*d2/24;
+	double s1 = 0.0, c1 = 1.0, s2 = 0.0, c2 = 1.0, t;
+	int i;
+
+	resample_table[0] = 1 << RESAMPLE_BITS;
+	for ( i = 1; i < RESAMPLE_ZEROS*RESAMPLE_PHASES; ++i ) {
+		t = s1*cd1 + c1*sd1; c1 = c1*cd1 - s1*sd1; s1 = t;
+		t = s2*cd2 + c2*sd2; c2 = c2*cd2 - s2*sd2; s2 = t;
+		t = s1 / (RESAMPLE_PI * i / RESAMPLE_PHASES);
+		t *= 0.42 + 0.5*c2 + 0.08*(2*c2*c2 - 1);
+		resample_table[i] = (Sint16)(t * (1 << RESAMPLE_BITS) + (t < 0 ? -0.5 : 0.5));
+	}
+	resample_table[i] = 0;
+	resample_table_ready = 1;
+}
+
+/* Samples are handled as 16 bit signed, 'flip' turns S8 into U8 */
+static __inline__ Sint32 SDL_ResampleGet(const Uint8 *src, int i, int bits, Uint8 flip)
+{
+	if ( bits == 16 ) {
+		return ((const Sint16 *)src)[i];
+	}
+	return ((Sint32)(src[i] ^ flip) - 128) * 256;
+}
+
+static __inline__ void SDL_ResamplePut(Uint8 *dst, int i, Sint32 sample, int bits, Uint8 flip)
+{
+	if ( bits != 16 ) {
+		sample = (sample + 0x80) >> 8;
+		if ( sample > 127 ) {
+			sample = 127;
+		} else if ( sample < -128 ) {
+			sample = -128;
+		}
+		dst[i] = (Uint8)(sample + 128) ^ flip;
+		return;
+	}
+	if ( sample > 32767 ) {
+		sample = 32767;
+	} else if ( sample < -32768 ) {
+		sample = -32768;
+	}
+	((Sint16 *)dst)[i] = (Sint16)sample;
+}
+
+static __inline__ void SDL_ResampleLinear(const Uint8 *src, Uint8 *dst,
+		int dstframes, int last, Uint32 istep, Uint32 fstep,
+		const int channels, const int bits, const Uint8 flip)
+{
+	Uint32 ipos = 0, fpos = 0;
+	int i, c;
+
+	for ( i = 0; i < dstframes; ++i ) {
+		const int i0 = (int)ipos * channels;
+		const int i1 = ((int)ipos < last) ? i0 + channels : i0;
+		const Sint32 frac = (Sint32)(fpos >> 18);
+
+		for ( c = 0; c < channels; ++c ) {
+			Sint32 s0 = SDL_ResampleGet(src, i0+c, bits, flip);
+			Sint32 s1 = SDL_ResampleGet(src, i1+c, bits, flip);
+			SDL_ResamplePut(dst, i*channels+c, s0 + (((s1 - s0) * frac) >> 14), bits, flip);
+		}
+		fpos += fstep;
+		ipos += istep + (fpos < fstep);
+	}
+}
+
+/* When downsampling the kernel is stretched by the ratio, and scaled
+   down, to cut what the destination rate can't hold */
+static __inline__ void SDL_ResampleSinc(const Uint8 *src, Uint8 *dst,
+		int dstframes, int last, Uint32 istep, Uint32 fstep, double ratio,
+		const int channels, const int bits, const Uint8 flip)
+{
+	const Sint32 tstep = (Sint32)(RESAMPLE_PHASES * 65536.0 / ratio);
+	const Sint32 wscale = (Sint32)(65536.0 / ratio);
+	const int width = (int)(RESAMPLE_ZEROS * ratio + 0.999999);
+	Sint32 weights[2*RESAMPLE_ZEROS*RESAMPLE_MAXRATIO];
+	Sint32 scale = 0;
+	Uint32 ipos = 0, fpos = 0, phase, lastphase = ~0;
+	int i, c, k;
+
+	for ( i = 0; i < dstframes; ++i ) {
+		const int first = (int)ipos - (width-1);
+
+		/* the weights only change with the phase, which repeats a lot
+		   with simple ratios (2x, 4x...) */
+		phase = fpos >> 20;
+		if ( phase != lastphase ) {
+			/* distance to the first tap, in table entries (16.16) */
+			Sint32 tpos = (Sint32)((phase * (Uint32)(tstep >> 8)) >> 4)
+					+ (width-1) * tstep;
+			Sint32 wsum = 0;
+
+			for ( k = 0; k < 2*width; ++k ) {
+				const Sint32 t = (tpos < 0) ? -tpos : tpos;
+				const Sint32 idx = t >> 16;
+				Sint32 h = 0;
+
+				if ( idx < RESAMPLE_ZEROS*RESAMPLE_PHASES ) {
+					/* between two entries of the table */
+					h = resample_table[idx] + (((resample_table[idx+1] -
+						resample_table[idx]) * ((t & 0xFFFF) >> 1) + 0x4000) >> 15);
+					if ( wscale != 65536 ) {
+						h = (h * wscale + 0x8000) >> 16;
+					}
+				}
+				weights[k] = h;
+				wsum += h;
+				tpos -= tstep;
+			}
+			/* the taps of a windowed sinc don't add up to exactly 1 */
+			scale = (1 << (RESAMPLE_BITS+15)) / wsum;
+			lastphase = phase;
+		}
+
+		for ( c = 0; c < channels; ++c ) {
+			Sint32 acc = 0;
+
+			if ( first >= 0 && first+2*width-1 <= last ) {
+				const int base = first*channels + c;
+				for ( k = 0; k < 2*width; ++k ) {
+					acc += SDL_ResampleGet(src, base + k*channels, bits, flip) * weights[k];
+				}
+			} else {
+				/* hold the edges */
+				for ( k = 0; k < 2*width; ++k ) {
+					int s = first + k;
+					s = (s < 0) ? 0 : (s > last) ? last : s;
+					acc += SDL_ResampleGet(src, s*channels + c, bits, flip) * weights[k];
+				}
+			}
+			SDL_ResamplePut(dst, i*channels+c, ((acc >> RESAMPLE_BITS) * scale) >> 15, bits, flip);
+		}
+		fpos += fstep;
+		ipos += istep + (fpos < fstep);
+	}
+}
+
+static __inline__ void SDL_RateResample(SDL_AudioCVT *cvt, Uint16 format,
+					const int channels, const int sinc)
+{
+	const int bits = (format & 0xFF);
+	const Uint8 flip = (format == AUDIO_S8) ? 0x80 : 0x00;
+	const int framesize = (bits / 8) * channels;
+	const int srcframes = cvt->len_cvt / framesize;
+	const double ratio = (cvt->rate_incr > 1.0) ? cvt->rate_incr : 1.0;
+	int dstframes;
+	Uint32 istep, fstep;
+	Uint8 *src;
+
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Resampling audio * %4.4f\n", 1.0/cvt->rate_incr);
+#endif
+	if ( srcframes == 0 ) {
+		cvt->len_cvt = 0;
+		goto done;
+	}
+	dstframes = (int)((double)srcframes / cvt->rate_incr);
+	istep = (Uint32)cvt->rate_incr;
+	fstep = (Uint32)((cvt->rate_incr - istep) * 4294967296.0);
+
+	src = cvt->buf + (cvt->len*cvt->len_mult - srcframes*framesize);
+	SDL_memmove(src, cvt->buf, srcframes*framesize);
+
+	if ( sinc && !resample_table_ready ) {
+		SDL_BuildResampleTable();
+	}
+	if ( bits == 16 ) {
+		if ( sinc ) {
+			SDL_ResampleSinc(src, cvt->buf, dstframes, srcframes-1,
+				istep, fstep, ratio, channels, 16, 0);
+		} else {
+			SDL_ResampleLinear(src, cvt->buf, dstframes, srcframes-1,
+				istep, fstep, channels, 16, 0);
+		}
+	} else {
+		if ( sinc ) {
+			SDL_ResampleSinc(src, cvt->buf, dstframes, srcframes-1,
+				istep, fstep, ratio, channels, 8, flip);
+		} else {
+			SDL_ResampleLinear(src, cvt->buf, dstframes, srcframes-1,
+				istep, fstep, channels, 8, flip);
+		}
+	}
+	cvt->len_cvt = dstframes * framesize;
+done:
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
+#define RESAMPLE_FILTER(name, channels, sinc) \
+void SDLCALL name(SDL_AudioCVT *cvt, Uint16 format) \
+{ \
+	SDL_RateResample(cvt, format, channels, sinc); \
+}
+RESAMPLE_FILTER(SDL_RateLinear, 1, 0)
+RESAMPLE_FILTER(SDL_RateLinear_c2, 2, 0)
+RESAMPLE_FILTER(SDL_RateLinear_c4, 4, 0)
+RESAMPLE_FILTER(SDL_RateLinear_c6, 6, 0)
+RESAMPLE_FILTER(SDL_RateSinc, 1, 1)
+RESAMPLE_FILTER(SDL_RateSinc_c2, 2, 1)
+RESAMPLE_FILTER(SDL_RateSinc_c4, 4, 1)
+RESAMPLE_FILTER(SDL_RateSinc_c6, 6, 1)
+
 int SDL_ConvertAudio(SDL_AudioCVT *cvt)
 {
 	/* Make sure there's data to convert */
@@ -1319,6 +1549,248 @@ int SDL_ConvertAudio(SDL_AudioCVT *cvt)
 	return(0);
 }
 
+/* The single pass resampler picked by SDL_AUDIO_RESAMPLER ("linear" or
+   "sinc"), NULL to chain the SDL_RateMUL2/SDL_RateDIV2 filters */
+typedef void (SDLCALL *SDL_AudioFilter)(SDL_AudioCVT *cvt, Uint16 format);
+
+static SDL_AudioFilter SDL_ChooseResampler(Uint16 format, int channels,
+					int src_rate, int dst_rate)
+{
+	const char *env = SDL_getenv("SDL_AUDIO_RESAMPLER");
+	int sinc;
+
+	if ( env == NULL ) {
+		return NULL;
+	}
+	if ( SDL_strcasecmp(env, "sinc") == 0 ) {
+		sinc = 1;
+	} else if ( SDL_strcasecmp(env, "linear") == 0 ) {
+		sinc = 0;
+	} else {
+		return NULL;
+	}
+	if ( format != AUDIO_S16SYS && format != AUDIO_U8 && format != AUDIO_S8 ) {
+		return NULL;
+	}
+	if ( src_rate > dst_rate*RESAMPLE_MAXRATIO ) {
+		return NULL;
+	}
+	switch (channels) {
+		case 1: return sinc ? SDL_RateSinc : SDL_RateLinear;
+		case 2: return sinc ? SDL_RateSinc_c2 : SDL_RateLinear_c2;
+		case 4: return sinc ? SDL_RateSinc_c4 : SDL_RateLinear_c4;
+		case 6: return sinc ? SDL_RateSinc_c6 : SDL_RateLinear_c6;
+	}
+	return NULL;
+}
+
+/* Fused conversion: the format, the channels (1 or 2) and steps of 2 of
+   the rate in a single pass, with the results of the chain of filters it
+   replaces (see SDL_FuseAudioCVT) but in one case: from 16 bit stereo to
+   AUDIO_S8 mono, the chain averages the channels as if they were U8, since
+   SDL_Convert8 leaves the format unsigned, where this averages the signed
+   samples (-14745, 29545 give 28 instead of -100). The sample values are
+   handled in the domain of the destination format, like the chain does
+   after its format filters: 'sx' sign extends them when it is signed. */
+#define FUSED_READ8(v) { \
+	Uint32 bits = (Uint32)(*src++ ^ flip) << lsh; \
+	v = (Sint32)(bits ^ sx) - sx; \
+}
+#define FUSED_READ16LSB(v) { \
+	Uint32 bits = (((Uint32)src[1] << 8 | src[0]) >> rsh) ^ flipx; \
+	src += 2; \
+	v = (Sint32)(bits ^ sx) - sx; \
+}
+#define FUSED_READ16MSB(v) { \
+	Uint32 bits = (((Uint32)src[0] << 8 | src[1]) >> rsh) ^ flipx; \
+	src += 2; \
+	v = (Sint32)(bits ^ sx) - sx; \
+}
+#define FUSED_WRITE8(v) { \
+	*dst++ = (Uint8)(v); \
+}
+#define FUSED_WRITE16LSB(v) { \
+	dst[0] = (Uint8)(v); \
+	dst[1] = (Uint8)((v) >> 8); \
+	dst += 2; \
+}
+#define FUSED_WRITE16MSB(v) { \
+	dst[0] = (Uint8)((v) >> 8); \
+	dst[1] = (Uint8)(v); \
+	dst += 2; \
+}
+
+/* Each step reads a frame and writes a group of 'dups' frames, the
+   frames between the ones read are dropped when downsampling. The
+   steps go backwards when the audio grows, so it doesn't overwrite
+   itself. */
+#define FUSED_LOOP(name, READ, WRITE) \
+static void name(Uint8 *buf, int steps, int srcstep, int dststep, \
+		int in, int out, int dups, Uint8 flip, int lsh, int rsh, \
+		Uint32 flipx, Uint32 sx) \
+{ \
+	int i, j, d, dir; \
+	if ( dststep > srcstep ) { \
+		i = steps-1; \
+		dir = -1; \
+	} else { \
+		i = 0; \
+		dir = 1; \
+	} \
+	for ( j = steps; j; --j, i += dir ) { \
+		const Uint8 *src = buf + i*srcstep; \
+		Uint8 *dst = buf + i*dststep; \
+		Sint32 l, r; \
+		READ(l); \
+		if ( in == 2 ) { \
+			READ(r); \
+			if ( out == 1 ) { \
+				l = (l + r) / 2; \
+			} \
+		} else { \
+			r = l; \
+		} \
+		for ( d = dups; d; --d ) { \
+			WRITE(l); \
+			if ( out == 2 ) { \
+				WRITE(r); \
+			} \
+		} \
+	} \
+}
+FUSED_LOOP(SDL_Fused8To8, FUSED_READ8, FUSED_WRITE8)
+FUSED_LOOP(SDL_Fused8To16LSB, FUSED_READ8, FUSED_WRITE16LSB)
+FUSED_LOOP(SDL_Fused8To16MSB, FUSED_READ8, FUSED_WRITE16MSB)
+FUSED_LOOP(SDL_Fused16LSBTo8, FUSED_READ16LSB, FUSED_WRITE8)
+FUSED_LOOP(SDL_Fused16LSBTo16LSB, FUSED_READ16LSB, FUSED_WRITE16LSB)
+FUSED_LOOP(SDL_Fused16LSBTo16MSB, FUSED_READ16LSB, FUSED_WRITE16MSB)
+FUSED_LOOP(SDL_Fused16MSBTo8, FUSED_READ16MSB, FUSED_WRITE8)
+FUSED_LOOP(SDL_Fused16MSBTo16LSB, FUSED_READ16MSB, FUSED_WRITE16LSB)
+FUSED_LOOP(SDL_Fused16MSBTo16MSB, FUSED_READ16MSB, FUSED_WRITE16MSB)
+
+static void SDL_ConvertFused(SDL_AudioCVT *cvt, Uint16 format,
+				int in, int out, int shift)
+{
+	const Uint16 src_format = cvt->src_format;
+	const Uint16 dst_format = cvt->dst_format;
+	const int src16 = ((src_format & 0xFF) == 16);
+	const int dst16 = ((dst_format & 0xFF) == 16);
+	const int dups = (shift > 0) ? (1 << shift) : 1;
+	const int srcstep = ((shift < 0) ? (1 << -shift) : 1) * (src16 ? 2 : 1) * in;
+	const int dststep = dups * (dst16 ? 2 : 1) * out;
+	const int steps = cvt->len_cvt / srcstep;
+	const Uint8 flip = ((src_format ^ dst_format) & 0x8000) ? 0x80 : 0x00;
+	const Uint32 flipx = dst16 ? (flip << 8) : flip;
+	const Uint32 sx = (dst_format & 0x8000) ? (dst16 ? 0x8000 : 0x80) : 0;
+	const int lsh = dst16 ? 8 : 0;
+	const int rsh = dst16 ? 0 : 8;
+	void (*loop)(Uint8 *, int, int, int, int, int, int, Uint8, int, int, Uint32, Uint32);
+
+#ifdef DEBUG_CONVERT
+	fprintf(stderr, "Converting audio in a single pass\n");
+#endif
+	if ( !src16 ) {
+		loop = !dst16 ? SDL_Fused8To8 :
+		       (dst_format & 0x1000) ? SDL_Fused8To16MSB : SDL_Fused8To16LSB;
+	} else if ( (src_format & 0x1000) == 0 ) {
+		loop = !dst16 ? SDL_Fused16LSBTo8 :
+		       (dst_format & 0x1000) ? SDL_Fused16LSBTo16MSB : SDL_Fused16LSBTo16LSB;
+	} else {
+		loop = !dst16 ? SDL_Fused16MSBTo8 :
+		       (dst_format & 0x1000) ? SDL_Fused16MSBTo16MSB : SDL_Fused16MSBTo16LSB;
+	}
+	loop(cvt->buf, steps, srcstep, dststep, in, out, dups, flip, lsh, rsh, flipx, sx);
+
+	cvt->len_cvt = steps * dststep;
+	format = dst_format;
+	if ( cvt->filters[++cvt->filter_index] ) {
+		cvt->filters[cvt->filter_index](cvt, format);
+	}
+}
+
+#define FUSED_FILTER(name, in, out, shift) \
+static void SDLCALL name(SDL_AudioCVT *cvt, Uint16 format) \
+{ \
+	SDL_ConvertFused(cvt, format, in, out, shift); \
+}
+FUSED_FILTER(SDL_ConvertFused_11_div4, 1, 1, -2)
+FUSED_FILTER(SDL_ConvertFused_11_div2, 1, 1, -1)
+FUSED_FILTER(SDL_ConvertFused_11, 1, 1, 0)
+FUSED_FILTER(SDL_ConvertFused_11_mul2, 1, 1, 1)
+FUSED_FILTER(SDL_ConvertFused_11_mul4, 1, 1, 2)
+FUSED_FILTER(SDL_ConvertFused_12_div4, 1, 2, -2)
+FUSED_FILTER(SDL_ConvertFused_12_div2, 1, 2, -1)
+FUSED_FILTER(SDL_ConvertFused_12, 1, 2, 0)
+FUSED_FILTER(SDL_ConvertFused_12_mul2, 1, 2, 1)
+FUSED_FILTER(SDL_ConvertFused_12_mul4, 1, 2, 2)
+FUSED_FILTER(SDL_ConvertFused_21_div4, 2, 1, -2)
+FUSED_FILTER(SDL_ConvertFused_21_div2, 2, 1, -1)
+FUSED_FILTER(SDL_ConvertFused_21, 2, 1, 0)
+FUSED_FILTER(SDL_ConvertFused_21_mul2, 2, 1, 1)
+FUSED_FILTER(SDL_ConvertFused_21_mul4, 2, 1, 2)
+FUSED_FILTER(SDL_ConvertFused_22_div4, 2, 2, -2)
+FUSED_FILTER(SDL_ConvertFused_22_div2, 2, 2, -1)
+FUSED_FILTER(SDL_ConvertFused_22, 2, 2, 0)
+FUSED_FILTER(SDL_ConvertFused_22_mul2, 2, 2, 1)
+FUSED_FILTER(SDL_ConvertFused_22_mul4, 2, 2, 2)
+
+static const SDL_AudioFilter fused_filters[2][2][5] = {
+	{ { SDL_ConvertFused_11_div4, SDL_ConvertFused_11_div2, SDL_ConvertFused_11,
+	    SDL_ConvertFused_11_mul2, SDL_ConvertFused_11_mul4 },
+	  { SDL_ConvertFused_12_div4, SDL_ConvertFused_12_div2, SDL_ConvertFused_12,
+	    SDL_ConvertFused_12_mul2, SDL_ConvertFused_12_mul4 } },
+	{ { SDL_ConvertFused_21_div4, SDL_ConvertFused_21_div2, SDL_ConvertFused_21,
+	    SDL_ConvertFused_21_mul2, SDL_ConvertFused_21_mul4 },
+	  { SDL_ConvertFused_22_div4, SDL_ConvertFused_22_div2, SDL_ConvertFused_22,
+	    SDL_ConvertFused_22_mul2, SDL_ConvertFused_22_mul4 } }
+};
+
+/* Replaces a chain of at least two filters that only convert the format,
+   between mono and stereo, and the rate by up to two steps of 2, by one
+   fused filter (that a resampler may still follow), so each sample is
+   read once instead of once per filter */
+static void SDL_FuseAudioCVT(SDL_AudioCVT *cvt, Uint16 src_format,
+			int src_channels, Uint16 dst_format, int dst_channels)
+{
+	int n = cvt->filter_index;
+	int i, shift = 0;
+
+	if ( src_channels > 2 || dst_channels > 2 ) {
+		return;
+	}
+	/* The single pass resampler comes last, it stays */
+	if ( n > 0 && cvt->rate_incr != 0.0 ) {
+		--n;
+	}
+	if ( n < 2 ) {
+		return;
+	}
+	for ( i = 0; i < n; ++i ) {
+		SDL_AudioFilter filter = cvt->filters[i];
+
+		if ( filter == SDL_RateMUL2 || filter == SDL_RateMUL2_c2 ) {
+			++shift;
+		} else if ( filter == SDL_RateDIV2 || filter == SDL_RateDIV2_c2 ) {
+			--shift;
+		} else if ( filter != SDL_ConvertEndian && filter != SDL_ConvertSign &&
+		            filter != SDL_Convert8 && filter != SDL_Convert16LSB &&
+		            filter != SDL_Convert16MSB && filter != SDL_ConvertStereo &&
+		            filter != SDL_ConvertMono ) {
+			return;
+		}
+	}
+	if ( shift < -2 || shift > 2 ) {
+		return;
+	}
+	cvt->src_format = src_format;
+	cvt->dst_format = dst_format;
+	cvt->filters[0] = fused_filters[src_channels-1][dst_channels-1][shift+2];
+	for ( i = 1; n+i-1 < cvt->filter_index; ++i ) {
+		cvt->filters[i] = cvt->filters[n+i-1];
+	}
+	cvt->filter_index = i;
+}
+
 /* Creates a set of audio filters to convert from one format to another. 
    Returns -1 if the format conversion is not supported, or 1 if the
    audio filter is set up.
@@ -1328,6 +1800,9 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 	Uint16 src_format, Uint8 src_channels, int src_rate,
 	Uint16 dst_format, Uint8 dst_channels, int dst_rate)
 {
+	SDL_AudioFilter resampler;
+	Uint8 in_channels = src_channels;
+
 /*printf("Build format %04x->%04x, channels %u->%u, rate %d->%d\n",
 		src_format, dst_format, src_channels, dst_channels, src_rate, dst_rate);*/
 	/* Start off with no conversion necessary */
@@ -1435,7 +1910,15 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 
 	/* Do rate conversion */
 	cvt->rate_incr = 0.0;
-	if ( (src_rate/100) != (dst_rate/100) ) {
+	if ( (src_rate/100) != (dst_rate/100) &&
+	     (resampler = SDL_ChooseResampler(dst_format, src_channels,
+	                                      src_rate, dst_rate)) ) {
+		/* One pass at the exact ratio, the source is moved to the end */
+		cvt->filters[cvt->filter_index++] = resampler;
+		cvt->rate_incr = (double)src_rate/dst_rate;
+		cvt->len_mult *= (dst_rate+src_rate-1)/src_rate + 1;
+		cvt->len_ratio *= (double)dst_rate/src_rate;
+	} else if ( (src_rate/100) != (dst_rate/100) ) {
 		Uint32 hi_rate, lo_rate;
 		int len_mult;
 		double len_ratio;
@@ -1497,6 +1980,10 @@ int SDL_BuildAudioCVT(SDL_AudioCVT *cvt,
 		}
 	}
 
+	if ( src_channels == dst_channels ) {
+		SDL_FuseAudioCVT(cvt, src_format, in_channels, dst_format, dst_channels);
+	}
+
 	/* Set up the filter information */
 	if ( cvt->filter_index != 0 ) {
 		cvt->needed = 1;
@@ -24,6 +24,7 @@
 /* This provides the default mixing callback for the SDL audio routines */
 
 #include "SDL_cpuinfo.h"
+#include "SDL_endian.h"
 #include "SDL_timer.h"
 #include "SDL_audio.h"
 #include "SDL_sysaudio.h"
@@ -31,6 +32,18 @@
 #include "SDL_mixer_MMX_VC.h"
 #include "SDL_mixer_m68k.h"
 
+/* Saturating SIMD mixers, picked by what the compiler targets */
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SDL_MIX_SSE2	1
+#elif defined(__GNUC__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SDL_MIX_NEON	1
+#elif defined(__GNUC__) && defined(__ARM_FEATURE_SIMD32)
+#include <arm_acle.h>
+#define SDL_MIX_SIMD32	1	/* ARMv6 (3DS): QADD16/QADD8 on 32 bit words */
+#endif
+
 /* This table is used to add two sound values together and pin
  * the value to avoid overflow.  (used with permission from ARDI)
  * Changed to use 0xFE instead of 0xFF for better sound quality.
@@ -90,6 +103,333 @@ static const Uint8 mix8[] =
 #define ADJUST_VOLUME(s, v)	(s = (s*v)/SDL_MIX_MAXVOLUME)
 #define ADJUST_VOLUME_U8(s, v)	(s = (((s-128)*v)/SDL_MIX_MAXVOLUME)+128)
 
+/* Divide by SDL_MIX_MAXVOLUME rounding towards zero, as ADJUST_VOLUME */
+#define DIV_VOLUME(p)	(((p) + (((p) >> 31) & (SDL_MIX_MAXVOLUME-1))) >> 7)
+
+/* The SIMD mixers below handle volumes up to SDL_MIX_MAXVOLUME and give
+   the same results as the C loops. They mix as much of the buffer as
+   they can and return the number of bytes done, the C loops do the rest.
+ */
+#if defined(SDL_MIX_SSE2)
+
+/* The eight samples of s times v / SDL_MIX_MAXVOLUME, in 32 bit */
+static __inline__ void SDL_MixProducts(__m128i s, __m128i v, __m128i *p0, __m128i *p1)
+{
+	__m128i lo = _mm_mullo_epi16(s, v);
+	__m128i hi = _mm_mulhi_epi16(s, v);
+	__m128i a = _mm_unpacklo_epi16(lo, hi);
+	__m128i b = _mm_unpackhi_epi16(lo, hi);
+
+	a = _mm_add_epi32(a, _mm_srli_epi32(_mm_srai_epi32(a, 31), 25));
+	b = _mm_add_epi32(b, _mm_srli_epi32(_mm_srai_epi32(b, 31), 25));
+	*p0 = _mm_srai_epi32(a, 7);
+	*p1 = _mm_srai_epi32(b, 7);
+}
+
+static __inline__ __m128i SDL_MixScale16(__m128i s, __m128i v)
+{
+	__m128i p0, p1;
+
+	SDL_MixProducts(s, v, &p0, &p1);
+	return _mm_packs_epi32(p0, p1);
+}
+
+static __inline__ __m128i SDL_MixScale8(__m128i s, __m128i v)
+{
+	__m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+	__m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8);
+	return _mm_packs_epi16(SDL_MixScale16(lo, v), SDL_MixScale16(hi, v));
+}
+
+static Uint32 SDL_MixS16_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const __m128i v = _mm_set1_epi16(volume);
+	Uint32 i;
+
+	len &= ~15;
+	if ( volume == SDL_MIX_MAXVOLUME ) {
+		for ( i = 0; i < len; i += 16 ) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src+i));
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst+i));
+			_mm_storeu_si128((__m128i *)(dst+i), _mm_adds_epi16(d, s));
+		}
+	} else {
+		for ( i = 0; i < len; i += 16 ) {
+			__m128i s = _mm_loadu_si128((const __m128i *)(src+i));
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst+i));
+			_mm_storeu_si128((__m128i *)(dst+i), _mm_adds_epi16(d, SDL_MixScale16(s, v)));
+		}
+	}
+	return(len);
+}
+
+static Uint32 SDL_MixS8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const __m128i v = _mm_set1_epi16(volume);
+	Uint32 i;
+
+	len &= ~15;
+	for ( i = 0; i < len; i += 16 ) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src+i));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst+i));
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, v);
+		}
+		_mm_storeu_si128((__m128i *)(dst+i), _mm_adds_epi8(d, s));
+	}
+	return(len);
+}
+
+/* Same as S8 around 0x80, pinned to 0xFE like the mix8 table */
+static Uint32 SDL_MixU8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const __m128i v = _mm_set1_epi16(volume);
+	const __m128i bias = _mm_set1_epi8((char)0x80);
+	const __m128i top = _mm_set1_epi8((char)0xFE);
+	Uint32 i;
+
+	len &= ~15;
+	for ( i = 0; i < len; i += 16 ) {
+		__m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src+i)), bias);
+		__m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(dst+i)), bias);
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, v);
+		}
+		d = _mm_xor_si128(_mm_adds_epi8(d, s), bias);
+		_mm_storeu_si128((__m128i *)(dst+i), _mm_min_epu8(d, top));
+	}
+	return(len);
+}
+
+/* For SDL_MixAudioMulti(), on native 16 bit samples */
+static int SDL_MixAccumS16_SIMD(Sint32 *acc, const Uint8 *buf, int n, int volume)
+{
+	const __m128i v = _mm_set1_epi16(volume);
+	int i;
+
+	for ( i = 0; i + 8 <= n; i += 8 ) {
+		__m128i p0, p1;
+		SDL_MixProducts(_mm_loadu_si128((const __m128i *)(buf+2*i)), v, &p0, &p1);
+		p0 = _mm_add_epi32(p0, _mm_loadu_si128((const __m128i *)(acc+i)));
+		p1 = _mm_add_epi32(p1, _mm_loadu_si128((const __m128i *)(acc+i+4)));
+		_mm_storeu_si128((__m128i *)(acc+i), p0);
+		_mm_storeu_si128((__m128i *)(acc+i+4), p1);
+	}
+	return(i);
+}
+
+static int SDL_MixStoreS16_SIMD(Uint8 *buf, const Sint32 *acc, int n)
+{
+	int i;
+
+	for ( i = 0; i + 8 <= n; i += 8 ) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(acc+i));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(acc+i+4));
+		_mm_storeu_si128((__m128i *)(buf+2*i), _mm_packs_epi32(p0, p1));
+	}
+	return(i);
+}
+
+#elif defined(SDL_MIX_NEON)
+
+/* The four samples of s times v / SDL_MIX_MAXVOLUME, in 32 bit */
+static __inline__ int32x4_t SDL_MixProducts(int16x4_t s, int16x4_t v)
+{
+	int32x4_t p = vmull_s16(s, v);
+
+	p = vaddq_s32(p, vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(vshrq_n_s32(p, 31)), 25)));
+	return vshrq_n_s32(p, 7);
+}
+
+static __inline__ int16x4_t SDL_MixScale16(int16x4_t s, int16x4_t v)
+{
+	return vqmovn_s32(SDL_MixProducts(s, v));
+}
+
+static __inline__ int8x16_t SDL_MixScale8(int8x16_t s, int16x4_t v)
+{
+	int16x8_t lo = vmovl_s8(vget_low_s8(s));
+	int16x8_t hi = vmovl_s8(vget_high_s8(s));
+
+	lo = vcombine_s16(SDL_MixScale16(vget_low_s16(lo), v), SDL_MixScale16(vget_high_s16(lo), v));
+	hi = vcombine_s16(SDL_MixScale16(vget_low_s16(hi), v), SDL_MixScale16(vget_high_s16(hi), v));
+	return vcombine_s8(vqmovn_s16(lo), vqmovn_s16(hi));
+}
+
+static Uint32 SDL_MixS16_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const int16x4_t v = vdup_n_s16(volume);
+	Uint32 i;
+
+	len &= ~15;
+	for ( i = 0; i < len; i += 16 ) {
+		int16x8_t s = vreinterpretq_s16_u8(vld1q_u8(src+i));
+		int16x8_t d = vreinterpretq_s16_u8(vld1q_u8(dst+i));
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = vcombine_s16(SDL_MixScale16(vget_low_s16(s), v), SDL_MixScale16(vget_high_s16(s), v));
+		}
+		vst1q_u8(dst+i, vreinterpretq_u8_s16(vqaddq_s16(d, s)));
+	}
+	return(len);
+}
+
+static Uint32 SDL_MixS8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const int16x4_t v = vdup_n_s16(volume);
+	Uint32 i;
+
+	len &= ~15;
+	for ( i = 0; i < len; i += 16 ) {
+		int8x16_t s = vreinterpretq_s8_u8(vld1q_u8(src+i));
+		int8x16_t d = vreinterpretq_s8_u8(vld1q_u8(dst+i));
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, v);
+		}
+		vst1q_u8(dst+i, vreinterpretq_u8_s8(vqaddq_s8(d, s)));
+	}
+	return(len);
+}
+
+/* Same as S8 around 0x80, pinned to 0xFE like the mix8 table */
+static Uint32 SDL_MixU8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	const int16x4_t v = vdup_n_s16(volume);
+	const uint8x16_t bias = vdupq_n_u8(0x80);
+	const uint8x16_t top = vdupq_n_u8(0xFE);
+	Uint32 i;
+
+	len &= ~15;
+	for ( i = 0; i < len; i += 16 ) {
+		int8x16_t s = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(src+i), bias));
+		int8x16_t d = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(dst+i), bias));
+		uint8x16_t r;
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, v);
+		}
+		r = veorq_u8(vreinterpretq_u8_s8(vqaddq_s8(d, s)), bias);
+		vst1q_u8(dst+i, vminq_u8(r, top));
+	}
+	return(len);
+}
+
+/* For SDL_MixAudioMulti(), on native 16 bit samples */
+static int SDL_MixAccumS16_SIMD(Sint32 *acc, const Uint8 *buf, int n, int volume)
+{
+	const int16x4_t v = vdup_n_s16(volume);
+	int i;
+
+	for ( i = 0; i + 8 <= n; i += 8 ) {
+		int16x8_t s = vreinterpretq_s16_u8(vld1q_u8(buf+2*i));
+		vst1q_s32(acc+i, vaddq_s32(vld1q_s32(acc+i), SDL_MixProducts(vget_low_s16(s), v)));
+		vst1q_s32(acc+i+4, vaddq_s32(vld1q_s32(acc+i+4), SDL_MixProducts(vget_high_s16(s), v)));
+	}
+	return(i);
+}
+
+static int SDL_MixStoreS16_SIMD(Uint8 *buf, const Sint32 *acc, int n)
+{
+	int i;
+
+	for ( i = 0; i + 8 <= n; i += 8 ) {
+		int16x8_t r = vcombine_s16(vqmovn_s32(vld1q_s32(acc+i)), vqmovn_s32(vld1q_s32(acc+i+4)));
+		vst1q_u8(buf+2*i, vreinterpretq_u8_s16(r));
+	}
+	return(i);
+}
+
+#elif defined(SDL_MIX_SIMD32)
+
+/* Scale the four signed bytes of a word */
+static __inline__ Uint32 SDL_MixScale8(Uint32 s, int volume)
+{
+	Sint32 b0 = (Sint8)s * volume;
+	Sint32 b1 = (Sint8)(s >> 8) * volume;
+	Sint32 b2 = (Sint8)(s >> 16) * volume;
+	Sint32 b3 = ((Sint32)s >> 24) * volume;
+
+	return (DIV_VOLUME(b0) & 0xFF) | ((DIV_VOLUME(b1) & 0xFF) << 8) |
+	       ((DIV_VOLUME(b2) & 0xFF) << 16) | ((Uint32)DIV_VOLUME(b3) << 24);
+}
+
+static Uint32 SDL_MixS16_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	Uint32 i, s, d;
+
+	len &= ~3;
+	for ( i = 0; i < len; i += 4 ) {
+		SDL_memcpy(&s, src+i, 4);
+		SDL_memcpy(&d, dst+i, 4);
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			Sint32 lo = (Sint16)s * volume;		/* SMULBB */
+			Sint32 hi = ((Sint32)s >> 16) * volume;	/* SMULTB */
+			s = (DIV_VOLUME(lo) & 0xFFFF) | ((Uint32)DIV_VOLUME(hi) << 16);
+		}
+		d = (Uint32)__qadd16((int16x2_t)d, (int16x2_t)s);
+		SDL_memcpy(dst+i, &d, 4);
+	}
+	return(len);
+}
+
+static Uint32 SDL_MixS8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	Uint32 i, s, d;
+
+	len &= ~3;
+	for ( i = 0; i < len; i += 4 ) {
+		SDL_memcpy(&s, src+i, 4);
+		SDL_memcpy(&d, dst+i, 4);
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, volume);
+		}
+		d = (Uint32)__qadd8((int8x4_t)d, (int8x4_t)s);
+		SDL_memcpy(dst+i, &d, 4);
+	}
+	return(len);
+}
+
+/* Same as S8 around 0x80, pinned to 0xFE like the mix8 table */
+static Uint32 SDL_MixU8_SIMD(Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
+{
+	Uint32 i, s, d;
+
+	len &= ~3;
+	for ( i = 0; i < len; i += 4 ) {
+		SDL_memcpy(&s, src+i, 4);
+		SDL_memcpy(&d, dst+i, 4);
+		s ^= 0x80808080;
+		if ( volume != SDL_MIX_MAXVOLUME ) {
+			s = SDL_MixScale8(s, volume);
+		}
+		d = (Uint32)__qadd8((int8x4_t)(d ^ 0x80808080), (int8x4_t)s) ^ 0x80808080;
+		__usub8(d, 0xFEFEFEFE);		/* GE flags set where d >= 0xFE */
+		d = __sel(0xFEFEFEFE, d);
+		SDL_memcpy(dst+i, &d, 4);
+	}
+	return(len);
+}
+
+#endif /* SIMD mixers */
+
+#if defined(SDL_MIX_SSE2) || defined(SDL_MIX_NEON) || defined(SDL_MIX_SIMD32)
+#define SDL_MIX_SIMD	1
+#endif
+#if defined(SDL_MIX_SSE2) || defined(SDL_MIX_NEON)
+#define SDL_MIX_ACCUM_SIMD	1
+#endif
+
+/* The format SDL_MixAudio mixes, the user-level audio format */
+static Uint16 SDL_MixFormat(void)
+{
+	if ( current_audio ) {
+		if ( current_audio->convert.needed ) {
+			return(current_audio->convert.src_format);
+		}
+		return(current_audio->spec.format);
+	}
+	/* HACK HACK HACK */
+	return(AUDIO_S16);
+}
+
 void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 {
 	Uint16 format;
@@ -98,16 +438,7 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 		return;
 	}
 	/* Mix the user-level audio format */
-	if ( current_audio ) {
-		if ( current_audio->convert.needed ) {
-			format = current_audio->convert.src_format;
-		} else {
-			format = current_audio->spec.format;
-		}
-	} else {
-  		/* HACK HACK HACK */
-		format = AUDIO_S16;
-	}
+	format = SDL_MixFormat();
 	switch (format) {
 
 		case AUDIO_U8: {
@@ -116,6 +447,14 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 #else
 			Uint8 src_sample;
 
+#if defined(SDL_MIX_SIMD)
+			if ( volume > 0 && volume <= SDL_MIX_MAXVOLUME ) {
+				Uint32 done = SDL_MixU8_SIMD(dst, src, len, volume);
+				dst += done;
+				src += done;
+				len -= done;
+			}
+#endif
 			while ( len-- ) {
 				src_sample = *src;
 				ADJUST_VOLUME_U8(src_sample, volume);
@@ -154,6 +493,14 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 			const int max_audioval = ((1<<(8-1))-1);
 			const int min_audioval = -(1<<(8-1));
 
+#if defined(SDL_MIX_SIMD)
+			if ( volume > 0 && volume <= SDL_MIX_MAXVOLUME ) {
+				Uint32 done = SDL_MixS8_SIMD(dst, src, len, volume);
+				dst += done;
+				src += done;
+				len -= done;
+			}
+#endif
 			src8 = (Sint8 *)src;
 			dst8 = (Sint8 *)dst;
 			while ( len-- ) {
@@ -202,6 +549,14 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 			const int max_audioval = ((1<<(16-1))-1);
 			const int min_audioval = -(1<<(16-1));
 
+#if defined(SDL_MIX_SIMD) && (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+			if ( volume > 0 && volume <= SDL_MIX_MAXVOLUME ) {
+				Uint32 done = SDL_MixS16_SIMD(dst, src, len, volume);
+				dst += done;
+				src += done;
+				len -= done;
+			}
+#endif
 			len /= 2;
 			while ( len-- ) {
 				src1 = ((src[1])<<8|src[0]);
@@ -234,6 +589,14 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 			const int max_audioval = ((1<<(16-1))-1);
 			const int min_audioval = -(1<<(16-1));
 
+#if defined(SDL_MIX_SIMD) && (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+			if ( volume > 0 && volume <= SDL_MIX_MAXVOLUME ) {
+				Uint32 done = SDL_MixS16_SIMD(dst, src, len, volume);
+				dst += done;
+				src += done;
+				len -= done;
+			}
+#endif
 			len /= 2;
 			while ( len-- ) {
 				src1 = ((src[0])<<8|src[1]);
@@ -262,3 +625,139 @@ void SDL_MixAudio (Uint8 *dst, const Uint8 *src, Uint32 len, int volume)
 	}
 }
 
+
+/* SDL_MixAudioMulti() sums the sources a chunk at a time in 32 bit, then
+   pins the sum once, instead of pinning after each source.
+ */
+#define MIX_CHUNK	256
+
+static void SDL_MixAccumulate(Sint32 *acc, const Uint8 *buf, int n, Uint16 format, int volume)
+{
+	int i;
+
+	switch (format) {
+		case AUDIO_U8:
+			for ( i = 0; i < n; ++i ) {
+				Sint32 p = (buf[i]-128) * volume;
+				acc[i] += DIV_VOLUME(p);
+			}
+			break;
+		case AUDIO_S8:
+			for ( i = 0; i < n; ++i ) {
+				Sint32 p = ((Sint8 *)buf)[i] * volume;
+				acc[i] += DIV_VOLUME(p);
+			}
+			break;
+		case AUDIO_S16LSB:
+			i = 0;
+#if defined(SDL_MIX_ACCUM_SIMD) && (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+			i = SDL_MixAccumS16_SIMD(acc, buf, n, volume);
+#endif
+			for ( ; i < n; ++i ) {
+				Sint32 p = (Sint16)SDL_SwapLE16(((Uint16 *)buf)[i]) * volume;
+				acc[i] += DIV_VOLUME(p);
+			}
+			break;
+		case AUDIO_S16MSB:
+			i = 0;
+#if defined(SDL_MIX_ACCUM_SIMD) && (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+			i = SDL_MixAccumS16_SIMD(acc, buf, n, volume);
+#endif
+			for ( ; i < n; ++i ) {
+				Sint32 p = (Sint16)SDL_SwapBE16(((Uint16 *)buf)[i]) * volume;
+				acc[i] += DIV_VOLUME(p);
+			}
+			break;
+	}
+}
+
+static void SDL_MixStore(Uint8 *buf, const Sint32 *acc, int n, Uint16 format)
+{
+	int i;
+
+	switch (format) {
+		case AUDIO_U8:
+			/* pinned to 0xFE like the mix8 table */
+			for ( i = 0; i < n; ++i ) {
+				Sint32 v = acc[i];
+				v = (v < -128) ? -128 : (v > 126) ? 126 : v;
+				buf[i] = (Uint8)(v + 128);
+			}
+			break;
+		case AUDIO_S8:
+			for ( i = 0; i < n; ++i ) {
+				Sint32 v = acc[i];
+				v = (v < -128) ? -128 : (v > 127) ? 127 : v;
+				buf[i] = (Uint8)v;
+			}
+			break;
+		case AUDIO_S16LSB:
+			i = 0;
+#if defined(SDL_MIX_ACCUM_SIMD) && (SDL_BYTEORDER == SDL_LIL_ENDIAN)
+			i = SDL_MixStoreS16_SIMD(buf, acc, n);
+#endif
+			for ( ; i < n; ++i ) {
+				Sint32 v = acc[i];
+				v = (v < -32768) ? -32768 : (v > 32767) ? 32767 : v;
+				((Uint16 *)buf)[i] = SDL_SwapLE16((Uint16)v);
+			}
+			break;
+		case AUDIO_S16MSB:
+			i = 0;
+#if defined(SDL_MIX_ACCUM_SIMD) && (SDL_BYTEORDER == SDL_BIG_ENDIAN)
+			i = SDL_MixStoreS16_SIMD(buf, acc, n);
+#endif
+			for ( ; i < n; ++i ) {
+				Sint32 v = acc[i];
+				v = (v < -32768) ? -32768 : (v > 32767) ? 32767 : v;
+				((Uint16 *)buf)[i] = SDL_SwapBE16((Uint16)v);
+			}
+			break;
+	}
+}
+
+void SDL_MixAudioMulti (Uint8 *dst, const Uint8 **src, const int *volume, int num, Uint32 len)
+{
+	Sint32 acc[MIX_CHUNK];
+	Uint16 format;
+	Uint32 pos;
+	int bytes, i;
+
+	format = SDL_MixFormat();
+	switch (format) {
+		case AUDIO_U8:
+		case AUDIO_S8:
+			bytes = 1;
+			break;
+		case AUDIO_S16LSB:
+		case AUDIO_S16MSB:
+			bytes = 2;
+			break;
+		default: /* If this happens... FIXME! */
+			SDL_SetError("SDL_MixAudioMulti(): unknown audio format");
+			return;
+	}
+
+	for ( i = 0; i < num; ++i ) {
+		if ( volume[i] != 0 )
+			break;
+	}
+	if ( i == num ) {
+		return;
+	}
+
+	len /= bytes;
+	for ( pos = 0; pos < len; pos += MIX_CHUNK ) {
+		int n = (len - pos < MIX_CHUNK) ? (int)(len - pos) : MIX_CHUNK;
+		Uint8 *out = dst + pos*bytes;
+
+		SDL_memset(acc, 0, n*sizeof(acc[0]));
+		SDL_MixAccumulate(acc, out, n, format, SDL_MIX_MAXVOLUME);
+		for ( i = 0; i < num; ++i ) {
+			if ( volume[i] != 0 ) {
+				SDL_MixAccumulate(acc, src[i] + pos*bytes, n, format, volume[i]);
+			}
+		}
+		SDL_MixStore(out, acc, n, format);
+	}
+}
@@ -28,7 +28,6 @@
 #include "SDL_rwops.h"
 #include "SDL_timer.h"
 #include "SDL_audio.h"
-#include "../SDL_audiomem.h"
 #include "../SDL_audio_c.h"
 #include "../SDL_audiodev_c.h"
 #include "SDL_n3dsaudio.h"
@@ -55,13 +54,6 @@ static int N3DSAUD_Available(void)
 
 static void N3DSAUD_DeleteDevice(SDL_AudioDevice *device)
 {
-	if ( device->hidden->mixbuf != NULL ) {
-		SDL_FreeAudioMem(device->hidden->mixbuf);
-		device->hidden->mixbuf = NULL;
-	}
-	if 	( device->hidden->waveBuf!= NULL )
-		linearFree(device->hidden->waveBuf);
-	ndspExit();
 	SDL_free(device->hidden);
 	SDL_free(device);
 }
@@ -103,53 +95,69 @@ AudioBootStrap N3DSAUD_bootstrap = {
 	N3DSAUD_Available, N3DSAUD_CreateDevice
 };
 
+/* Called by the DSP thread after each audio frame: wakes up the audio
+   thread as soon as the buffer it waits for has been played */
+static void N3DSAUD_FrameCallback(void *data)
+{
+	_THIS = (SDL_AudioDevice *)data;
+	if ( this->hidden->waveBuf[this->hidden->nextbuf].status == NDSP_WBUF_DONE )
+		LightEvent_Signal(&this->hidden->bufdone);
+}
+
 /* This function waits until it is possible to write a full sound buffer */
 static void N3DSAUD_WaitAudio(_THIS)
 {
-		while(this->hidden->waveBuf[this->hidden->nextbuf].status != NDSP_WBUF_DONE){
-			SDL_Delay(5);//Give other thread 5ms of execution time.
-		}
+	while ( this->hidden->waveBuf[this->hidden->nextbuf].status != NDSP_WBUF_DONE ) {
+		// the timeout only matters if the DSP stops (sleep mode, shutdown)
+		if ( LightEvent_WaitTimeout(&this->hidden->bufdone, 100000000LL) && !this->enabled )
+			break;
+	}
 }
 
+/* The audio was mixed straight into the wave buffer (see GetAudioBuf),
+   it only needs to reach the DSP */
 static void N3DSAUD_PlayAudio(_THIS)
 {
-	if (this->hidden->format==NDSP_FORMAT_STEREO_PCM8 || this->hidden->format==NDSP_FORMAT_MONO_PCM8) {
-//		if(this->hidden->isSigned) 
-			memcpy(this->hidden->waveBuf[this->hidden->nextbuf].data_pcm8,this->hidden->mixbuf,this->hidden->mixlen);
-/*		else {
-			u8 *dst = this->hidden->waveBuf[this->hidden->nextbuf].data_pcm8;
-			u8 *src = this->hidden->mixbuf;
-			for(int ii = 0; ii< this->hidden->mixlen; ii++) *dst++ = -128 + * src++;
-		} 
-*/		DSP_FlushDataCache(this->hidden->waveBuf[this->hidden->nextbuf].data_pcm8,
-							this->hidden->mixlen);
-//							this->hidden->waveBuf[this->hidden->nextbuf].nsamples);
-	} else {
-		memcpy(this->hidden->waveBuf[this->hidden->nextbuf].data_pcm16,this->hidden->mixbuf,this->hidden->mixlen);
-		DSP_FlushDataCache(this->hidden->waveBuf[this->hidden->nextbuf].data_pcm16,
-							this->hidden->mixlen);
-//							this->hidden->waveBuf[this->hidden->nextbuf].nsamples);
-	}
-	this->hidden->waveBuf[this->hidden->nextbuf].offset=0;
-	this->hidden->waveBuf[this->hidden->nextbuf].status=NDSP_WBUF_QUEUED;
-	ndspChnWaveBufAdd(0, &this->hidden->waveBuf[this->hidden->nextbuf]);
+	ndspWaveBuf *buf = &this->hidden->waveBuf[this->hidden->nextbuf];
+
+	DSP_FlushDataCache(buf->data_vaddr, this->hidden->mixlen);
+	buf->offset=0;
+	buf->status=NDSP_WBUF_QUEUED;
+	ndspChnWaveBufAdd(0, buf);
 
-	this->hidden->nextbuf = (this->hidden->nextbuf+1)%2;
+	this->hidden->nextbuf = (this->hidden->nextbuf+1)%this->hidden->numbufs;
 }
 
+/* The next wave buffer itself: it is free once WaitAudio returns */
 static Uint8 *N3DSAUD_GetAudioBuf(_THIS)
 {
-	return(this->hidden->mixbuf);
+	return((Uint8 *)this->hidden->waveBuf[this->hidden->nextbuf].data_vaddr);
 }
 
 static void N3DSAUD_CloseAudio(_THIS)
 {
-	if ( this->hidden->mixbuf != NULL ) {
-		SDL_FreeAudioMem(this->hidden->mixbuf);
-		this->hidden->mixbuf = NULL;
+	if ( this->hidden->wavemem != NULL ) {
+		ndspSetCallback(NULL, NULL);
+		ndspChnWaveBufClear(0);
+		ndspExit();
+		linearFree(this->hidden->wavemem);
+		this->hidden->wavemem = NULL;
+	}
+}
+
+/* The interpolation of the DSP resampler, from SDL_N3DS_AUDIO_INTERP:
+   "polyphase" (best), "linear" (default) or "none" */
+ndspInterpType N3DSAUD_GetInterp(void)
+{
+	const char *env = SDL_getenv("SDL_N3DS_AUDIO_INTERP");
+
+	if ( env ) {
+		if ( SDL_strcasecmp(env, "polyphase") == 0 )
+			return NDSP_INTERP_POLYPHASE;
+		if ( SDL_strcasecmp(env, "none") == 0 )
+			return NDSP_INTERP_NONE;
 	}
-	if 	( this->hidden->waveBuf!= NULL )
-		linearFree(this->hidden->waveBuf);
+	return NDSP_INTERP_LINEAR;
 }
 
 /*
@@ -213,32 +221,55 @@ static int N3DSAUD_OpenAudio(_THIS, SDL_AudioSpec *spec)
         return (-1);
     }
 
+	/* The DSP plays the stream at its own rate, only out of range rates
+	   are left to SDL to convert */
+	if ( spec->freq < N3DS_MIN_AUDIO_RATE ) spec->freq = N3DS_MIN_AUDIO_RATE;
+	if ( spec->freq > N3DS_MAX_AUDIO_RATE ) spec->freq = N3DS_MAX_AUDIO_RATE;
+
 	/* Update the fragment size as size in bytes */
 	SDL_CalculateAudioSpec(spec);
 
-	/* Allocate mixing buffer */
+	/* There is no mixing buffer, SDL mixes into the wave buffers */
 	this->hidden->mixlen = spec->size;
-	this->hidden->mixbuf = (Uint8 *) SDL_malloc(spec->size); 
-	if ( this->hidden->mixbuf == NULL ) {
+
+	/* The ring of wave buffers: by default enough of them to keep
+	   N3DS_AUDIO_QUEUED samples queued, so small buffers don't underrun */
+	const char *env = SDL_getenv("SDL_N3DS_AUDIO_BUFFERS");
+	int i, numbufs;
+	if ( env ) {
+		numbufs = SDL_atoi(env);
+	} else {
+		numbufs = (N3DS_AUDIO_QUEUED + spec->samples - 1) / spec->samples;
+	}
+	if ( numbufs < N3DS_MIN_AUDIO_BUFFERS ) numbufs = N3DS_MIN_AUDIO_BUFFERS;
+	if ( numbufs > N3DS_MAX_AUDIO_BUFFERS ) numbufs = N3DS_MAX_AUDIO_BUFFERS;
+
+	this->hidden->wavemem = (Uint8 *) linearAlloc(this->hidden->mixlen*numbufs);
+	if ( this->hidden->wavemem == NULL ) {
+		SDL_OutOfMemory();
 		return(-1);
 	}
-	SDL_memset(this->hidden->mixbuf, spec->silence, spec->size);
-	
-	Uint8 * temp = (Uint8 *) linearAlloc(this->hidden->mixlen*2); 
-	
+	SDL_memset(this->hidden->wavemem, spec->silence, this->hidden->mixlen*numbufs);
+
+	this->hidden->numbufs = numbufs;
 	this->hidden->nextbuf = 0;
 	this->hidden->channels = spec->channels;
 	this->hidden->samplerate = spec->freq;
 
     //start 3ds DSP init
-	ndspInit();
+	if ( ndspInit() != 0 ) {
+		linearFree(this->hidden->wavemem);
+		this->hidden->wavemem = NULL;
+		SDL_SetError("Couldn't initialize the DSP (is the DSP firmware dumped?)");
+		return(-1);
+	}
 
 	ndspChnReset(0);
 	ndspChnWaveBufClear(0);
 
 	ndspSetOutputMode((this->hidden->channels==2)?NDSP_OUTPUT_STEREO:NDSP_OUTPUT_MONO);
 
-	ndspChnSetInterp(0, NDSP_INTERP_LINEAR);
+	ndspChnSetInterp(0, N3DSAUD_GetInterp());
 	ndspChnSetRate(0, spec->freq);
 	ndspChnSetFormat(0, this->hidden->format);
 
@@ -250,13 +281,14 @@ static int N3DSAUD_OpenAudio(_THIS, SDL_AudioSpec *spec)
 	
 	memset(this->hidden->waveBuf,0,sizeof(this->hidden->waveBuf));
 
-	this->hidden->waveBuf[0].data_vaddr = temp;
-	this->hidden->waveBuf[0].nsamples = this->hidden->mixlen / this->hidden->bytePerSample;
-	this->hidden->waveBuf[0].status = NDSP_WBUF_DONE;
+	for ( i = 0; i < numbufs; i++ ) {
+		this->hidden->waveBuf[i].data_vaddr = this->hidden->wavemem + i*this->hidden->mixlen;
+		this->hidden->waveBuf[i].nsamples = this->hidden->mixlen / this->hidden->bytePerSample;
+		this->hidden->waveBuf[i].status = NDSP_WBUF_DONE;
+	}
 
-	this->hidden->waveBuf[1].data_vaddr = temp + this->hidden->mixlen;
-	this->hidden->waveBuf[1].nsamples = this->hidden->mixlen / this->hidden->bytePerSample;
-	this->hidden->waveBuf[1].status = NDSP_WBUF_DONE;
+	LightEvent_Init(&this->hidden->bufdone, RESET_ONESHOT);
+	ndspSetCallback(N3DSAUD_FrameCallback, this);
 
 	stream_offset += this->hidden->mixlen;
 
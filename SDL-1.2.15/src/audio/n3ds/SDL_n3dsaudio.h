@@ -29,12 +29,21 @@
 
 #define _THIS	SDL_AudioDevice *this
 
-#define NUM_BUFFERS 2			/* -- Don't lower this! */
+/* Ring of wave buffers queued to the DSP. SDL_N3DS_AUDIO_BUFFERS sets
+   how many, by default enough to queue N3DS_AUDIO_QUEUED samples. */
+#define N3DS_MIN_AUDIO_BUFFERS	2	/* -- Don't lower this! */
+#define N3DS_MAX_AUDIO_BUFFERS	16
+#define N3DS_AUDIO_QUEUED	1024
+
+/* Rates the DSP resamples from: the app gets any of them as is, there is
+   no rate conversion on the CPU. SDL_N3DS_AUDIO_INTERP picks how. */
+#define N3DS_MIN_AUDIO_RATE	1000
+#define N3DS_MAX_AUDIO_RATE	96000
+
+extern ndspInterpType N3DSAUD_GetInterp(void);
 
 struct SDL_PrivateAudioData {
-	/* The file descriptor for the audio device */
-	Uint8 *mixbuf;
-	Uint32 mixlen;
+	Uint32 mixlen;			/* size of a wave buffer */
 //	Uint32 write_delay;
 	Uint32 initial_calls;
 	Uint32 format;
@@ -43,7 +52,10 @@ struct SDL_PrivateAudioData {
     Uint8  bytePerSample;
 	Uint32 isSigned;
 	Uint32 nextbuf;
-	ndspWaveBuf waveBuf[NUM_BUFFERS];
+	Uint32 numbufs;
+	Uint8 *wavemem;			/* linear memory of the wave buffers */
+	LightEvent bufdone;		/* signaled by the DSP when waveBuf[nextbuf] is done */
+	ndspWaveBuf waveBuf[N3DS_MAX_AUDIO_BUFFERS];
 };
 
 #endif /* _SDL_n3dsaudio_h */
@@ -0,0 +1,229 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* Hardware voices: the ndsp channels other than the one of the audio
+   stream, handed out to the app. Each voice has a small pool of wave
+   buffers that are reused once the DSP is done with them. */
+
+#include "SDL_audio.h"
+#include "SDL_n3dsaudio.h"
+
+#define N3DS_VOICES		24
+#define N3DS_STREAM_VOICE	0	/* used by SDL_OpenAudio */
+
+struct N3DS_Voice {
+	int used;
+	int adpcm;
+	int framebytes;			/* bytes per sample frame, PCM only */
+	ndspWaveBuf waveBuf[SDL_N3DS_VOICE_QUEUE];
+	ndspAdpcmData adpcmData[SDL_N3DS_VOICE_QUEUE];
+};
+
+static struct N3DS_Voice voices[N3DS_VOICES];
+
+static struct N3DS_Voice *getVoice(int voice)
+{
+	if ( voice <= N3DS_STREAM_VOICE || voice >= N3DS_VOICES || !voices[voice].used ) {
+		SDL_SetError("Invalid voice %d", voice);
+		return(NULL);
+	}
+	return(&voices[voice]);
+}
+
+void *SDL_N3DSAllocVoiceData(Uint32 size)
+{
+	void *data = linearAlloc(size);
+	if ( data == NULL ) {
+		SDL_OutOfMemory();
+	}
+	return(data);
+}
+
+void SDL_N3DSFreeVoiceData(void *data)
+{
+	if ( data ) {
+		linearFree(data);
+	}
+}
+
+int SDL_N3DSAllocVoice(int channels, SDL_N3DSVoiceFormat format, int freq)
+{
+	u16 ndspformat;
+	int voice;
+
+	switch ( format ) {
+		case SDL_N3DS_VOICE_PCM8:
+			ndspformat = (channels == 2) ? NDSP_FORMAT_STEREO_PCM8 : NDSP_FORMAT_MONO_PCM8;
+			break;
+		case SDL_N3DS_VOICE_PCM16:
+			ndspformat = (channels == 2) ? NDSP_FORMAT_STEREO_PCM16 : NDSP_FORMAT_MONO_PCM16;
+			break;
+		case SDL_N3DS_VOICE_ADPCM:
+			if ( channels != 1 ) {
+				SDL_SetError("ADPCM voices are mono");
+				return(-1);
+			}
+			ndspformat = NDSP_FORMAT_MONO_ADPCM;
+			break;
+		default:
+			SDL_SetError("Unsupported voice format");
+			return(-1);
+	}
+
+	for ( voice = N3DS_STREAM_VOICE+1; voice < N3DS_VOICES; voice++ ) {
+		if ( !voices[voice].used )
+			break;
+	}
+	if ( voice == N3DS_VOICES ) {
+		SDL_SetError("No free voice");
+		return(-1);
+	}
+	// each voice holds a reference on the DSP, so they outlive the stream
+	if ( ndspInit() != 0 ) {
+		SDL_SetError("Couldn't initialize the DSP (is the DSP firmware dumped?)");
+		return(-1);
+	}
+
+	SDL_memset(&voices[voice], 0, sizeof(voices[voice]));
+	voices[voice].used = 1;
+	voices[voice].adpcm = (format == SDL_N3DS_VOICE_ADPCM);
+	voices[voice].framebytes = channels * (format == SDL_N3DS_VOICE_PCM16 ? 2 : 1);
+
+	ndspChnReset(voice);
+	ndspChnWaveBufClear(voice);
+	ndspChnSetInterp(voice, N3DSAUD_GetInterp());
+	ndspChnSetRate(voice, (float)freq);
+	ndspChnSetFormat(voice, ndspformat);
+	SDL_N3DSSetVoiceVolume(voice, 1.0f, 0.0f);
+	return(voice);
+}
+
+void SDL_N3DSFreeVoice(int voice)
+{
+	if ( getVoice(voice) == NULL )
+		return;
+	ndspChnWaveBufClear(voice);
+	ndspChnReset(voice);
+	voices[voice].used = 0;
+	ndspExit();
+}
+
+int SDL_N3DSQueueVoice(int voice, const void *data, Uint32 samples, int looping, const SDL_N3DSADPCMState *adpcm)
+{
+	struct N3DS_Voice *v = getVoice(voice);
+	ndspWaveBuf *buf;
+	int i;
+
+	if ( v == NULL )
+		return(-1);
+	for ( i = 0; i < SDL_N3DS_VOICE_QUEUE; i++ ) {
+		u8 status = v->waveBuf[i].status;
+		if ( status == NDSP_WBUF_FREE || status == NDSP_WBUF_DONE )
+			break;
+	}
+	if ( i == SDL_N3DS_VOICE_QUEUE ) {
+		SDL_SetError("Voice queue is full");
+		return(-1);
+	}
+
+	buf = &v->waveBuf[i];
+	SDL_memset(buf, 0, sizeof(*buf));
+	buf->data_vaddr = data;
+	buf->nsamples = samples;
+	buf->looping = looping ? true : false;
+	if ( v->adpcm && adpcm ) {
+		v->adpcmData[i].index = adpcm->index;
+		v->adpcmData[i].history0 = adpcm->history0;
+		v->adpcmData[i].history1 = adpcm->history1;
+		buf->adpcm_data = &v->adpcmData[i];
+	}
+
+	// DSP-ADPCM comes in frames of 14 samples in 8 bytes
+	DSP_FlushDataCache(data, v->adpcm ? (samples+13)/14*8 : samples*v->framebytes);
+	ndspChnWaveBufAdd(voice, buf);
+	return(0);
+}
+
+int SDL_N3DSVoiceQueued(int voice)
+{
+	struct N3DS_Voice *v = getVoice(voice);
+	int i, queued = 0;
+
+	if ( v == NULL )
+		return(0);
+	for ( i = 0; i < SDL_N3DS_VOICE_QUEUE; i++ ) {
+		u8 status = v->waveBuf[i].status;
+		if ( status == NDSP_WBUF_QUEUED || status == NDSP_WBUF_PLAYING )
+			queued++;
+	}
+	return(queued);
+}
+
+void SDL_N3DSStopVoice(int voice)
+{
+	struct N3DS_Voice *v = getVoice(voice);
+	int i;
+
+	if ( v == NULL )
+		return;
+	ndspChnWaveBufClear(voice);
+	for ( i = 0; i < SDL_N3DS_VOICE_QUEUE; i++ )
+		v->waveBuf[i].status = NDSP_WBUF_DONE;
+}
+
+void SDL_N3DSPauseVoice(int voice, int pause_on)
+{
+	if ( getVoice(voice) )
+		ndspChnSetPaused(voice, pause_on ? true : false);
+}
+
+void SDL_N3DSSetVoiceRate(int voice, float freq)
+{
+	if ( getVoice(voice) )
+		ndspChnSetRate(voice, freq);
+}
+
+void SDL_N3DSSetVoiceVolume(int voice, float volume, float pan)
+{
+	float mix[12];
+
+	if ( getVoice(voice) == NULL )
+		return;
+	if ( pan < -1.0f ) pan = -1.0f;
+	if ( pan > 1.0f ) pan = 1.0f;
+	SDL_memset(mix, 0, sizeof(mix));
+	// front left and right; centered is full volume on both sides
+	mix[0] = volume * (pan > 0.0f ? 1.0f - pan : 1.0f);
+	mix[1] = volume * (pan < 0.0f ? 1.0f + pan : 1.0f);
+	ndspChnSetMix(voice, mix);
+}
+
+void SDL_N3DSSetVoiceADPCMCoefs(int voice, const Uint16 coefs[16])
+{
+	u16 c[16];
+
+	if ( getVoice(voice) == NULL )
+		return;
+	SDL_memcpy(c, coefs, sizeof(c));
+	ndspChnSetAdpcmCoefs(voice, c);
+}
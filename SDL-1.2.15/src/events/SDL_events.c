@@ -37,15 +37,85 @@ SDL_EventFilter SDL_EventOK = NULL;
 Uint8 SDL_ProcessEvents[SDL_NUMEVENTS];
 static Uint32 SDL_eventstate = 0;
 
-/* Private data -- event queue */
+/* Private data -- event queue
+
+   Events are pushed without locking into a ring of slots, each with a
+   sequence number telling whether it is free for the producer of this
+   turn or full for the consumer (Dmitry Vyukov's bounded queue). Behind
+   it is the locked queue, which only holds events moved out of the ring:
+   the masked peeks of SDL_PeepEvents() work there, and it takes the
+   overflow of the ring, growing up to 'maxqueued' events. The events of
+   the locked queue are always older than the ones still in the ring.
+
+   The events of the locked queue are addressed by their position, which
+   only ever grows; slot = position & mask. The events of each type are
+   linked in a list, so a masked peek only visits matching events, and
+   the events taken out of the middle are only marked as cut, the queue
+   is squeezed when it runs out of room.
+
+   Only one thread may take events at a time: SDL_PollEvent() owns the
+   queue with an atomic flag instead of the mutex, the other paths take
+   the mutex and then wait for the flag.
+
+   SDL_WaitEventTimeout() sleeps on the 'wakeup' semaphore, which is
+   posted when an event is queued after the waiter cleared 'posted', so
+   there is at most one post in flight however many events are pushed.
+
+   Each event carries the time it was queued, or the time the pump set
+   with SDL_PrivateEventTime() for the input it sampled earlier; the one
+   of the last event taken is kept for SDL_GetEventTimestamp(). That time
+   is thread-local, so it only applies to the events the pump queues.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE) && !SDL_THREADS_DISABLED
+#define SDL_EVENTQ_LOCKFREE	1
+#endif
+
 #define MAXEVENTS	128
+#define MINEVENTS	8	/* the ring needs 2 slots at least */
+#define PUMP_INTERVAL	8	/* ms between pumps in SDL_WaitEvent() */
+
+#ifdef SDL_EVENTQ_LOCKFREE
+typedef struct {
+	Uint32 seq;
+	int cut;		/* taken by a masked peek */
+	Uint32 timestamp;
+	SDL_Event event;
+} SDL_EventSlot;
+#endif
+
+typedef struct {
+	SDL_Event event;
+	Uint32 timestamp;
+	Uint32 next;		/* position of the next event of this type */
+	int cut;
+} SDL_QueuedEvent;
+
 static struct {
 	SDL_mutex *lock;
 	int active;
-	int head;
-	int tail;
-	SDL_Event event[MAXEVENTS];
-	int wmmsg_next;
+#ifdef SDL_EVENTQ_LOCKFREE
+	SDL_EventSlot *ring;
+	Uint32 ringmask;
+	Uint32 ringtail;	/* next slot to fill, shared by the producers */
+	Uint32 ringhead;	/* next slot to take, owner only */
+	int owned;
+#endif
+	Uint32 head;		/* position of the oldest event */
+	Uint32 tail;		/* position of the next event */
+	Uint32 mask;		/* slots-1, the slots are a power of 2 */
+	Uint32 maxslots;
+	Uint32 maxqueued;	/* events it may hold, up to maxslots */
+	Uint32 cut;		/* events cut out between head and tail */
+	Uint32 types;		/* the types with events queued */
+	Uint32 typehead[SDL_NUMEVENTS];
+	Uint32 typetail[SDL_NUMEVENTS];
+	SDL_QueuedEvent *event;
+	Uint32 dropped;
+	Uint32 lasttime;	/* the time of the last event taken */
+	SDL_sem *wakeup;
+	int posted;		/* 'wakeup' was posted since the waiter looked */
+	Uint32 pumpinterval;
+	Uint32 wmmsg_next;
 	struct SDL_SysWMmsg wmmsg[MAXEVENTS];
 } SDL_EventQ;
 
@@ -55,6 +125,13 @@ static struct {
 	int safe;
 } SDL_EventLock;
 
+/* The time the pumping thread stamps the events it queues with, or 0 */
+#if defined(__GNUC__) && !SDL_THREADS_DISABLED
+static __thread Uint32 SDL_pumptime = 0;
+#else
+static Uint32 SDL_pumptime = 0;
+#endif
+
 /* Thread functions */
 static SDL_Thread *SDL_EventThread = NULL;	/* Thread handle */
 static Uint32 event_thread;			/* The event thread id */
@@ -157,6 +234,9 @@ static int SDL_StartEventThread(Uint32 flags)
 		return(-1);
 #endif
 	}
+	/* Without it SDL_WaitEvent() only wakes up to pump the events */
+	SDL_EventQ.wakeup = SDL_CreateSemaphore(0);
+	SDL_EventQ.posted = 0;
 #endif /* !SDL_THREADS_DISABLED */
 	SDL_EventQ.active = 1;
 
@@ -197,6 +277,10 @@ static void SDL_StopEventThread(void)
 	SDL_DestroyMutex(SDL_EventQ.lock);
 	SDL_EventQ.lock = NULL;
 #endif
+	if ( SDL_EventQ.wakeup ) {
+		SDL_DestroySemaphore(SDL_EventQ.wakeup);
+		SDL_EventQ.wakeup = NULL;
+	}
 }
 
 Uint32 SDL_EventThreadID(void)
@@ -220,7 +304,89 @@ void SDL_StopEventLoop(void)
 	/* Clean out EventQ */
 	SDL_EventQ.head = 0;
 	SDL_EventQ.tail = 0;
+	SDL_EventQ.cut = 0;
+	SDL_EventQ.types = 0;
 	SDL_EventQ.wmmsg_next = 0;
+	if ( SDL_EventQ.event ) {
+		SDL_free(SDL_EventQ.event);
+		SDL_EventQ.event = NULL;
+	}
+#ifdef SDL_EVENTQ_LOCKFREE
+	if ( SDL_EventQ.ring ) {
+		SDL_free(SDL_EventQ.ring);
+		SDL_EventQ.ring = NULL;
+	}
+#endif
+}
+
+/* Allocate the event queue: SDL_EVENT_QUEUE_SIZE sets the number of
+   events it holds, SDL_EVENT_QUEUE_MAX lets it grow up to that many at
+   most (both rounded up to a power of 2, and at least MINEVENTS). With
+   the ring, the ring holds half of the events and the locked queue the
+   rest, it is the one that grows. SDL_EVENT_PUMP_INTERVAL sets how many
+   ms SDL_WaitEvent() sleeps between pumps. */
+static int SDL_AllocEventQ(void)
+{
+	const char *env;
+	Uint32 size = MAXEVENTS, maxsize, slots;
+
+	env = SDL_getenv("SDL_EVENT_QUEUE_SIZE");
+	if ( env && SDL_atoi(env) > 0 ) {
+		size = SDL_atoi(env);
+	}
+	if ( size < MINEVENTS ) {
+		size = MINEVENTS;
+	}
+	maxsize = size;
+	env = SDL_getenv("SDL_EVENT_QUEUE_MAX");
+	if ( env && SDL_atoi(env) > (int)size ) {
+		maxsize = SDL_atoi(env);
+	}
+	for ( slots = 1; slots < size; slots *= 2 )
+		;
+	for ( size = slots; size < maxsize; size *= 2 )
+		;
+	maxsize = size;
+#ifdef SDL_EVENTQ_LOCKFREE
+	slots /= 2;
+	maxsize -= slots;
+#endif
+	SDL_EventQ.mask = slots-1;
+	SDL_EventQ.maxqueued = maxsize;
+	for ( SDL_EventQ.maxslots = slots; SDL_EventQ.maxslots < maxsize; SDL_EventQ.maxslots *= 2 )
+		;
+	SDL_EventQ.dropped = 0;
+	SDL_EventQ.lasttime = 0;
+	SDL_EventQ.pumpinterval = PUMP_INTERVAL;
+	env = SDL_getenv("SDL_EVENT_PUMP_INTERVAL");
+	if ( env && SDL_atoi(env) > 0 ) {
+		SDL_EventQ.pumpinterval = SDL_atoi(env);
+	}
+
+	SDL_EventQ.event = (SDL_QueuedEvent *)SDL_malloc(slots*sizeof(SDL_QueuedEvent));
+	if ( SDL_EventQ.event == NULL ) {
+		SDL_OutOfMemory();
+		return(-1);
+	}
+#ifdef SDL_EVENTQ_LOCKFREE
+	{
+		Uint32 i;
+
+		SDL_EventQ.ring = (SDL_EventSlot *)SDL_malloc(slots*sizeof(SDL_EventSlot));
+		if ( SDL_EventQ.ring == NULL ) {
+			SDL_OutOfMemory();
+			return(-1);
+		}
+		for ( i = 0; i < slots; ++i ) {
+			SDL_EventQ.ring[i].seq = i;
+		}
+		SDL_EventQ.ringmask = slots-1;
+		SDL_EventQ.ringtail = 0;
+		SDL_EventQ.ringhead = 0;
+		SDL_EventQ.owned = 0;
+	}
+#endif
+	return(0);
 }
 
 /* This function (and associated calls) may be called more than once */
@@ -252,8 +418,8 @@ int SDL_StartEventLoop(Uint32 flags)
 		return(-1);
 	}
 
-	/* Create the lock and event thread */
-	if ( SDL_StartEventThread(flags) < 0 ) {
+	/* Create the queue, the lock and event thread */
+	if ( (SDL_AllocEventQ() < 0) || (SDL_StartEventThread(flags) < 0) ) {
 		SDL_StopEventLoop();
 		return(-1);
 	}
@@ -261,58 +427,352 @@ int SDL_StartEventLoop(Uint32 flags)
 }
 
 
-/* Add an event to the event queue -- called with the queue locked */
-static int SDL_AddEvent(SDL_Event *event)
+#define TYPE_LIST(type)	((type) & (SDL_NUMEVENTS-1))
+#define TYPE_BIT(type)	((Uint32)1 << (type))
+
+#ifdef SDL_EVENTQ_LOCKFREE
+/* Push an event into the ring, or return 0 if it is full */
+static int SDL_RingPush(SDL_Event *event, Uint32 timestamp)
 {
-	int tail, added;
+	SDL_EventSlot *slot;
+	Uint32 pos;
+	Sint32 diff;
 
-	tail = (SDL_EventQ.tail+1)%MAXEVENTS;
-	if ( tail == SDL_EventQ.head ) {
-		/* Overflow, drop event */
-		added = 0;
-	} else {
-		SDL_EventQ.event[SDL_EventQ.tail] = *event;
-		if (event->type == SDL_SYSWMEVENT) {
-			/* Note that it's possible to lose an event */
-			int next = SDL_EventQ.wmmsg_next;
-			SDL_EventQ.wmmsg[next] = *event->syswm.msg;
-		        SDL_EventQ.event[SDL_EventQ.tail].syswm.msg =
-						&SDL_EventQ.wmmsg[next];
-			SDL_EventQ.wmmsg_next = (next+1)%MAXEVENTS;
+	pos = __atomic_load_n(&SDL_EventQ.ringtail, __ATOMIC_RELAXED);
+	for ( ;; ) {
+		slot = &SDL_EventQ.ring[pos & SDL_EventQ.ringmask];
+		diff = (Sint32)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+		if ( diff == 0 ) {
+			/* the slot is free, claim it (this reloads pos if we lost) */
+			if ( __atomic_compare_exchange_n(&SDL_EventQ.ringtail, &pos, pos+1,
+			                      1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) {
+				break;
+			}
+		} else if ( diff < 0 ) {
+			/* the slot of the previous turn wasn't taken yet */
+			return(0);
+		} else {
+			pos = __atomic_load_n(&SDL_EventQ.ringtail, __ATOMIC_RELAXED);
 		}
-		SDL_EventQ.tail = tail;
-		added = 1;
 	}
-	return(added);
+	slot->event = *event;
+	slot->timestamp = timestamp;
+	slot->cut = 0;
+	__atomic_store_n(&slot->seq, pos+1, __ATOMIC_RELEASE);
+	return(1);
 }
 
-/* Cut an event, and return the next valid spot, or the tail */
-/*                           -- called with the queue locked */
-static int SDL_CutEvent(int spot)
+/* Take the oldest event of the ring -- called by the owner */
+static int SDL_RingPop(SDL_Event *event, Uint32 *timestamp)
 {
-	if ( spot == SDL_EventQ.head ) {
-		SDL_EventQ.head = (SDL_EventQ.head+1)%MAXEVENTS;
-		return(SDL_EventQ.head);
-	} else
-	if ( (spot+1)%MAXEVENTS == SDL_EventQ.tail ) {
-		SDL_EventQ.tail = spot;
-		return(SDL_EventQ.tail);
-	} else
-	/* We cut the middle -- shift everything over */
-	{
-		int here, next;
+	SDL_EventSlot *slot;
+	Uint32 pos;
+
+	for ( ;; ) {
+		pos = SDL_EventQ.ringhead;
+		slot = &SDL_EventQ.ring[pos & SDL_EventQ.ringmask];
+		if ( __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos+1 ) {
+			return(0);
+		}
+		SDL_EventQ.ringhead = pos+1;
+		if ( ! slot->cut ) {
+			break;
+		}
+		__atomic_store_n(&slot->seq, pos+SDL_EventQ.ringmask+1, __ATOMIC_RELEASE);
+	}
+	*event = slot->event;
+	*timestamp = slot->timestamp;
+	__atomic_store_n(&slot->seq, pos+SDL_EventQ.ringmask+1, __ATOMIC_RELEASE);
+	return(1);
+}
+
+/* Peep at the events left in the ring when the locked queue is full */
+/*                                               -- called by the owner */
+static int SDL_RingPeep(SDL_Event *events, int numevents, SDL_eventaction action, Uint32 mask)
+{
+	SDL_EventSlot *slot;
+	Uint32 pos;
+	int used = 0;
+
+	for ( pos = SDL_EventQ.ringhead; used < numevents; ++pos ) {
+		slot = &SDL_EventQ.ring[pos & SDL_EventQ.ringmask];
+		if ( __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos+1 ) {
+			break;
+		}
+		if ( !slot->cut && (mask & TYPE_BIT(TYPE_LIST(slot->event.type))) ) {
+			events[used++] = slot->event;
+			SDL_EventQ.lasttime = slot->timestamp;
+			if ( action == SDL_GETEVENT ) {
+				slot->cut = 1;
+			}
+		}
+	}
+	return(used);
+}
+
+static int SDL_TryOwnEventQ(void)
+{
+	int owned = 0;
+	return __atomic_compare_exchange_n(&SDL_EventQ.owned, &owned, 1,
+	                      0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Wait for SDL_PollEvent() to be done -- called with the queue locked */
+static void SDL_OwnEventQ(void)
+{
+	int spin = 0;
+
+	/* it only holds the queue for a moment, unless it was preempted */
+	while ( ! SDL_TryOwnEventQ() ) {
+		if ( ++spin > 64 ) {
+			SDL_Delay(1);
+		}
+	}
+}
+
+static void SDL_DisownEventQ(void)
+{
+	__atomic_store_n(&SDL_EventQ.owned, 0, __ATOMIC_RELEASE);
+}
+
+static Uint32 SDL_NextWMmsg(void)
+{
+	return(__atomic_fetch_add(&SDL_EventQ.wmmsg_next, 1, __ATOMIC_RELAXED));
+}
+
+/* Wake up the waiter -- called after queueing an event. Either it sees
+   'posted' cleared and posts, or the waiter cleared it after the event
+   was queued, and will find the event before going to sleep. */
+static void SDL_WakeWaiter(void)
+{
+	if ( ! SDL_EventQ.wakeup ) {
+		return;
+	}
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if ( ! __atomic_load_n(&SDL_EventQ.posted, __ATOMIC_RELAXED) &&
+	     ! __atomic_exchange_n(&SDL_EventQ.posted, 1, __ATOMIC_SEQ_CST) ) {
+		SDL_SemPost(SDL_EventQ.wakeup);
+	}
+}
+
+/* Ask to be woken up by the next event -- called before looking */
+static void SDL_ArmWakeup(void)
+{
+	__atomic_store_n(&SDL_EventQ.posted, 0, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#else
+#define SDL_RingPush(event, timestamp)	0
+#define SDL_RingPop(event, timestamp)	0
+#define SDL_RingPeep(events, numevents, action, mask)	0
+#define SDL_TryOwnEventQ()	0
+#define SDL_OwnEventQ()
+#define SDL_DisownEventQ()
+#define SDL_NextWMmsg()		(SDL_EventQ.wmmsg_next++)
+
+/* The events are only queued with the queue locked */
+static void SDL_WakeWaiter(void)
+{
+	if ( SDL_EventQ.wakeup && ! SDL_EventQ.posted ) {
+		SDL_EventQ.posted = 1;
+		SDL_SemPost(SDL_EventQ.wakeup);
+	}
+}
+
+static void SDL_ArmWakeup(void)
+{
+	if ( SDL_EventQ.wakeup && (SDL_mutexP(SDL_EventQ.lock) == 0) ) {
+		SDL_EventQ.posted = 0;
+		SDL_mutexV(SDL_EventQ.lock);
+	}
+}
+#endif /* SDL_EVENTQ_LOCKFREE */
 
-		/* This can probably be optimized with SDL_memcpy() -- careful! */
-		if ( --SDL_EventQ.tail < 0 ) {
-			SDL_EventQ.tail = MAXEVENTS-1;
+#define QUEUED(pos)	(&SDL_EventQ.event[(pos) & SDL_EventQ.mask])
+#define QUEUE_FULL()	(SDL_EventQ.tail - SDL_EventQ.head > SDL_EventQ.mask || \
+			 SDL_EventQ.tail - SDL_EventQ.head >= SDL_EventQ.maxqueued)
+
+/* Append the event at the tail to the list of its type */
+static void SDL_LinkEvent(void)
+{
+	Uint32 pos = SDL_EventQ.tail++;
+	SDL_QueuedEvent *queued = QUEUED(pos);
+	int type = TYPE_LIST(queued->event.type);
+
+	queued->cut = 0;
+	if ( SDL_EventQ.types & TYPE_BIT(type) ) {
+		QUEUED(SDL_EventQ.typetail[type])->next = pos;
+	} else {
+		SDL_EventQ.typehead[type] = pos;
+		SDL_EventQ.types |= TYPE_BIT(type);
+	}
+	SDL_EventQ.typetail[type] = pos;
+}
+
+/* Cut the first event of its type, dropping the cut events at the head */
+static void SDL_CutEvent(Uint32 pos)
+{
+	SDL_QueuedEvent *queued = QUEUED(pos);
+	int type = TYPE_LIST(queued->event.type);
+
+	if ( pos == SDL_EventQ.typetail[type] ) {
+		SDL_EventQ.types &= ~TYPE_BIT(type);
+	} else {
+		SDL_EventQ.typehead[type] = queued->next;
+	}
+	queued->cut = 1;
+	++SDL_EventQ.cut;
+	while ( (SDL_EventQ.head != SDL_EventQ.tail) && QUEUED(SDL_EventQ.head)->cut ) {
+		++SDL_EventQ.head;
+		--SDL_EventQ.cut;
+	}
+}
+
+/* Move the events that weren't cut to 'event', which has mask+1 slots */
+static void SDL_SqueezeEventQ(SDL_QueuedEvent *event, Uint32 mask)
+{
+	SDL_QueuedEvent *old = SDL_EventQ.event;
+	Uint32 oldmask = SDL_EventQ.mask;
+	Uint32 pos, end = SDL_EventQ.tail;
+
+	/* in place, each event moves to a slot already read */
+	SDL_EventQ.event = event;
+	SDL_EventQ.mask = mask;
+	SDL_EventQ.tail = SDL_EventQ.head;
+	SDL_EventQ.cut = 0;
+	SDL_EventQ.types = 0;
+	for ( pos = SDL_EventQ.head; pos != end; ++pos ) {
+		if ( ! old[pos & oldmask].cut ) {
+			QUEUED(SDL_EventQ.tail)->event = old[pos & oldmask].event;
+			QUEUED(SDL_EventQ.tail)->timestamp = old[pos & oldmask].timestamp;
+			SDL_LinkEvent();
 		}
-		for ( here=spot; here != SDL_EventQ.tail; here = next ) {
-			next = (here+1)%MAXEVENTS;
-			SDL_EventQ.event[here] = SDL_EventQ.event[next];
+	}
+}
+
+/* Make room for one more event in the locked queue: squeeze out the cut
+   events, or grow it if it may -- called by the owner, with the queue locked */
+static int SDL_MakeRoom(void)
+{
+	Uint32 slots = SDL_EventQ.mask+1;
+	int cangrow;
+	SDL_QueuedEvent *event, *old;
+
+	if ( ! QUEUE_FULL() ) {
+		return(1);
+	}
+	cangrow = (slots < SDL_EventQ.maxslots &&
+	           SDL_EventQ.tail - SDL_EventQ.head < SDL_EventQ.maxqueued);
+	/* squeeze only if it frees enough slots to be worth it, or if it
+	   can't grow: with nothing cut, squeezing would leave it full */
+	if ( SDL_EventQ.cut && (SDL_EventQ.cut >= slots/8 || !cangrow) ) {
+		SDL_SqueezeEventQ(SDL_EventQ.event, SDL_EventQ.mask);
+		return(1);
+	}
+	if ( ! cangrow ) {
+		return(0);
+	}
+	event = (SDL_QueuedEvent *)SDL_malloc(2*slots*sizeof(SDL_QueuedEvent));
+	if ( event == NULL ) {
+		return(0);
+	}
+	old = SDL_EventQ.event;
+	SDL_SqueezeEventQ(event, 2*slots-1);
+	SDL_free(old);
+	return(1);
+}
+
+#ifndef SDL_EVENTQ_LOCKFREE
+/* Add an event to the locked queue -- called with the queue locked */
+static int SDL_AddEvent(SDL_Event *event, Uint32 timestamp)
+{
+	if ( ! SDL_MakeRoom() ) {
+		/* Overflow, drop event */
+		return(0);
+	}
+	QUEUED(SDL_EventQ.tail)->event = *event;
+	QUEUED(SDL_EventQ.tail)->timestamp = timestamp;
+	SDL_LinkEvent();
+	return(1);
+}
+#endif
+
+/* Move the events of the ring behind the ones of the locked queue */
+/*                           -- called by the owner, with the queue locked */
+static void SDL_DrainEventRing(void)
+{
+	while ( SDL_MakeRoom() && SDL_RingPop(&QUEUED(SDL_EventQ.tail)->event,
+	                                      &QUEUED(SDL_EventQ.tail)->timestamp) ) {
+		SDL_LinkEvent();
+	}
+}
+
+/* Queue an event: in the ring when there is room, else in the locked queue */
+static int SDL_QueueEvent(SDL_Event *event)
+{
+	SDL_Event copy;
+	Uint32 timestamp;
+	int added;
+
+	if ( event->type == SDL_SYSWMEVENT ) {
+		/* Note that it's possible to lose an event */
+		Uint32 next = SDL_NextWMmsg()%MAXEVENTS;
+		SDL_EventQ.wmmsg[next] = *event->syswm.msg;
+		copy = *event;
+		copy.syswm.msg = &SDL_EventQ.wmmsg[next];
+		event = &copy;
+	}
+	timestamp = SDL_pumptime;
+	if ( timestamp == 0 ) {
+		timestamp = SDL_GetTicks();
+	}
+	if ( SDL_RingPush(event, timestamp) ) {
+		SDL_WakeWaiter();
+		return(1);
+	}
+
+	if ( SDL_mutexP(SDL_EventQ.lock) < 0 ) {
+		return(0);
+	}
+	SDL_OwnEventQ();
+#ifdef SDL_EVENTQ_LOCKFREE
+	/* The ring stays full if the locked queue is full too, or for as
+	   long as the producer of its oldest slot is still writing it */
+	for ( ;; ) {
+		SDL_DrainEventRing();
+		added = SDL_RingPush(event, timestamp);
+		if ( added || QUEUE_FULL() ) {
+			break;
 		}
-		return(spot);
+		SDL_Delay(1);
+	}
+#else
+	added = SDL_AddEvent(event, timestamp);
+#endif
+	if ( added ) {
+		SDL_WakeWaiter();
+	} else {
+		++SDL_EventQ.dropped;
 	}
-	/* NOTREACHED */
+	SDL_DisownEventQ();
+	SDL_mutexV(SDL_EventQ.lock);
+	return(added);
+}
+
+/* Take the oldest events, whatever their type -- called by the owner */
+static int SDL_TakeEvents(SDL_Event *events, int numevents)
+{
+	int used = 0;
+
+	while ( (used < numevents) && (SDL_EventQ.head != SDL_EventQ.tail) ) {
+		events[used++] = QUEUED(SDL_EventQ.head)->event;
+		SDL_EventQ.lasttime = QUEUED(SDL_EventQ.head)->timestamp;
+		SDL_CutEvent(SDL_EventQ.head);
+	}
+	while ( (used < numevents) && SDL_RingPop(&events[used], &SDL_EventQ.lasttime) ) {
+		++used;
+	}
+	return(used);
 }
 
 /* Lock the event queue, take a peep at it, and unlock it */
@@ -325,37 +785,71 @@ int SDL_PeepEvents(SDL_Event *events, int numevents, SDL_eventaction action,
 	if ( ! SDL_EventQ.active ) {
 		return(-1);
 	}
+
+	/* Adding, or taking all events, doesn't need the lock */
+	if ( action == SDL_ADDEVENT ) {
+		used = 0;
+		for ( i=0; i<numevents; ++i ) {
+			used += SDL_QueueEvent(&events[i]);
+		}
+		return(used);
+	}
+	if ( (action == SDL_GETEVENT) && (mask == SDL_ALLEVENTS) &&
+	     (events != NULL) && SDL_TryOwnEventQ() ) {
+		used = SDL_TakeEvents(events, numevents);
+		SDL_DisownEventQ();
+		return(used);
+	}
+
 	/* Lock the event queue */
 	used = 0;
 	if ( SDL_mutexP(SDL_EventQ.lock) == 0 ) {
-		if ( action == SDL_ADDEVENT ) {
-			for ( i=0; i<numevents; ++i ) {
-				used += SDL_AddEvent(&events[i]);
+		SDL_Event tmpevent;
+		Uint32 next[SDL_NUMEVENTS];
+		Uint32 types, pos;
+		int type;
+
+		SDL_OwnEventQ();
+		SDL_DrainEventRing();
+
+		/* If 'events' is NULL, just see if they exist */
+		if ( events == NULL ) {
+			action = SDL_PEEKEVENT;
+			numevents = 1;
+			events = &tmpevent;
+		}
+
+		/* Merge the lists of the types in the mask, oldest first */
+		types = mask & SDL_EventQ.types;
+		for ( type = 0; (type < SDL_NUMEVENTS) && (types >> type); ++type ) {
+			next[type] = SDL_EventQ.typehead[type];
+		}
+		while ( (used < numevents) && types ) {
+			int oldest = -1;
+
+			for ( type = 0; (type < SDL_NUMEVENTS) && (types >> type); ++type ) {
+				if ( (types & TYPE_BIT(type)) && ((oldest < 0) ||
+				     (next[type]-SDL_EventQ.head < next[oldest]-SDL_EventQ.head)) ) {
+					oldest = type;
+				}
 			}
-		} else {
-			SDL_Event tmpevent;
-			int spot;
-
-			/* If 'events' is NULL, just see if they exist */
-			if ( events == NULL ) {
-				action = SDL_PEEKEVENT;
-				numevents = 1;
-				events = &tmpevent;
+			pos = next[oldest];
+			events[used++] = QUEUED(pos)->event;
+			SDL_EventQ.lasttime = QUEUED(pos)->timestamp;
+			if ( pos == SDL_EventQ.typetail[oldest] ) {
+				types &= ~TYPE_BIT(oldest);
+			} else {
+				next[oldest] = QUEUED(pos)->next;
 			}
-			spot = SDL_EventQ.head;
-			while ((used < numevents)&&(spot != SDL_EventQ.tail)) {
-				if ( mask & SDL_EVENTMASK(SDL_EventQ.event[spot].type) ) {
-					events[used++] = SDL_EventQ.event[spot];
-					if ( action == SDL_GETEVENT ) {
-						spot = SDL_CutEvent(spot);
-					} else {
-						spot = (spot+1)%MAXEVENTS;
-					}
-				} else {
-					spot = (spot+1)%MAXEVENTS;
-				}
+			if ( action == SDL_GETEVENT ) {
+				SDL_CutEvent(pos);
 			}
 		}
+		/* The ring is only left with events when the queue is full */
+		if ( used < numevents ) {
+			used += SDL_RingPeep(&events[used], numevents-used, action, mask);
+		}
+		SDL_DisownEventQ();
 		SDL_mutexV(SDL_EventQ.lock);
 	} else {
 		SDL_SetError("Couldn't lock event queue");
@@ -364,6 +858,21 @@ int SDL_PeepEvents(SDL_Event *events, int numevents, SDL_eventaction action,
 	return(used);
 }
 
+Uint32 SDL_GetDroppedEvents(void)
+{
+	return(SDL_EventQ.dropped);
+}
+
+Uint32 SDL_GetEventTimestamp(void)
+{
+	return(SDL_EventQ.lasttime);
+}
+
+void SDL_PrivateEventTime(Uint32 ticks)
+{
+	SDL_pumptime = ticks;
+}
+
 /* Run the system dependent event loops */
 void SDL_PumpEvents(void)
 {
@@ -400,18 +909,48 @@ int SDL_PollEvent (SDL_Event *event)
 	return 1;
 }
 
-int SDL_WaitEvent (SDL_Event *event)
+/* Sleep until an event is queued, waking up every 'pumpinterval' ms to
+   pump the events, unless the event thread does it */
+int SDL_WaitEventTimeout (SDL_Event *event, int timeout)
 {
+	Uint32 start = SDL_GetTicks();
+	Uint32 elapsed, wait;
+
 	while ( 1 ) {
+		SDL_ArmWakeup();
 		SDL_PumpEvents();
 		switch(SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_ALLEVENTS)) {
 		    case -1: return 0;
 		    case 1: return 1;
-		    case 0: SDL_Delay(10);
+		}
+
+		wait = SDL_MUTEX_MAXWAIT;
+		if ( timeout >= 0 ) {
+			elapsed = SDL_GetTicks() - start;
+			if ( elapsed >= (Uint32)timeout ) {
+				return 0;
+			}
+			wait = (Uint32)timeout - elapsed;
+		}
+		if ( !SDL_EventThread && (wait > SDL_EventQ.pumpinterval) ) {
+			wait = SDL_EventQ.pumpinterval;
+		}
+		if ( SDL_EventQ.wakeup ) {
+			SDL_SemWaitTimeout(SDL_EventQ.wakeup, wait);
+		} else {
+			if ( wait > SDL_EventQ.pumpinterval ) {
+				wait = SDL_EventQ.pumpinterval;
+			}
+			SDL_Delay(wait);
 		}
 	}
 }
 
+int SDL_WaitEvent (SDL_Event *event)
+{
+	return SDL_WaitEventTimeout(event, -1);
+}
+
 int SDL_PushEvent(SDL_Event *event)
 {
 	if ( SDL_PeepEvents(event, 1, SDL_ADDEVENT, 0) <= 0 )
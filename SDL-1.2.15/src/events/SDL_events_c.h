@@ -64,6 +64,11 @@ extern int SDL_PrivateExpose(void);
 extern int SDL_PrivateQuit(void);
 extern int SDL_PrivateSysWMEvent(SDL_SysWMmsg *message);
 
+/* Used by the pump to stamp the events it queues with the time the input
+   was sampled (SDL_GetTicks() ms), 0 to stamp them with the current time.
+   It only applies to the calling thread. */
+extern void SDL_PrivateEventTime(Uint32 ticks);
+
 /* Used to clamp the mouse coordinates separately from the video surface */
 extern void SDL_SetMouseRange(int maxX, int maxY);
 
@@ -10,8 +10,16 @@
 
 #include "../../video/n3ds/SDL_n3dsvideo.h"
 
-int old_x = 0, old_y = 0;
-u32 key_press, key_release = 0;
+#include "../../video/n3ds/SDL_n3dsevents_c.h"
+
+static int old_x = 0, old_y = 0;
+static u32 old_keys = 0;
+static SDL_Joystick *opened = NULL;
+
+/* The keys of the buttons, by button index */
+static const u32 buttons[8] = {
+	KEY_A, KEY_B, KEY_X, KEY_Y, KEY_L, KEY_R, KEY_SELECT, KEY_START
+};
 
 int SDL_SYS_JoystickInit (void) {
 	SDL_numjoysticks = 1;
@@ -34,76 +42,52 @@ int SDL_SYS_JoystickOpen(SDL_Joystick *joystick) {
 	joystick->nballs = 0;
 	joystick->naxes = 2;
 
+	opened = joystick;
+	old_keys = N3DS_KeysHeld ();
+
 	return 0;
 }
 
-void SDL_SYS_JoystickUpdate (SDL_Joystick *joystick) {
+/* Report what changed since the last call, from SDL_SYS_JoystickUpdate or
+   from the pump for each sample of the input thread */
+void N3DS_JoystickInput (u32 held, const circlePosition *circlePad) {
+	u32 changed;
+	int i;
 
-	circlePosition circlePad;
-	hidCircleRead(&circlePad);
-	if (old_x != circlePad.dx) {
-		old_x = circlePad.dx;
-		SDL_PrivateJoystickAxis (joystick, 0, circlePad.dx * 200);
-	}
-	if (old_y != circlePad.dy) {
-		old_y = circlePad.dy;
-		SDL_PrivateJoystickAxis (joystick, 1, - circlePad.dy * 200);
-	}	
-
-	key_press = hidKeysDown ();
-	if ((key_press & KEY_A)) {
-		SDL_PrivateJoystickButton (joystick, 0, SDL_PRESSED);
-	}
-	if ((key_press & KEY_B)) {
-		SDL_PrivateJoystickButton (joystick, 1, SDL_PRESSED);
-	}
-	if ((key_press & KEY_X)) {
-		SDL_PrivateJoystickButton (joystick, 2, SDL_PRESSED);
-	}
-	if ((key_press & KEY_Y)) {
-		SDL_PrivateJoystickButton (joystick, 3, SDL_PRESSED);
-	}
-	if ((key_press & KEY_SELECT)) {
-		SDL_PrivateJoystickButton (joystick, 6, SDL_PRESSED);
-	}
-	if ((key_press & KEY_START)) {
-		SDL_PrivateJoystickButton (joystick, 7, SDL_PRESSED);
-	}
-	if ((key_press & KEY_L)) {
-		SDL_PrivateJoystickButton (joystick, 4, SDL_PRESSED);
-	}
-	if ((key_press&KEY_R)) {
-		SDL_PrivateJoystickButton(joystick,5,SDL_PRESSED);
-	}
+	if (!opened)
+		return;
 
-	key_release = hidKeysUp ();
-	if ((key_release & KEY_A)) {
-		SDL_PrivateJoystickButton (joystick, 0, SDL_RELEASED);
-	}
-	if ((key_release & KEY_B)) {
-		SDL_PrivateJoystickButton (joystick, 1, SDL_RELEASED);
-	}
-	if ((key_release & KEY_X)) {
-		SDL_PrivateJoystickButton (joystick, 2, SDL_RELEASED);
-	}
-	if ((key_release & KEY_Y)) {
-		SDL_PrivateJoystickButton (joystick, 3, SDL_RELEASED);
+	if (old_x != circlePad->dx) {
+		old_x = circlePad->dx;
+		SDL_PrivateJoystickAxis (opened, 0, circlePad->dx * 200);
 	}
-	if ((key_release & KEY_SELECT)) {
-		SDL_PrivateJoystickButton (joystick, 6, SDL_RELEASED);
+	if (old_y != circlePad->dy) {
+		old_y = circlePad->dy;
+		SDL_PrivateJoystickAxis (opened, 1, - circlePad->dy * 200);
 	}
-	if ((key_release & KEY_START)) {
-		SDL_PrivateJoystickButton (joystick, 7, SDL_RELEASED);
-	}
-	if ((key_release & KEY_L)) {
-		SDL_PrivateJoystickButton (joystick, 4, SDL_RELEASED);
-	}
-	if ((key_release & KEY_R)) {
-		SDL_PrivateJoystickButton (joystick, 5, SDL_RELEASED);
+
+	changed = held ^ old_keys;
+	old_keys = held;
+	for (i = 0; i < 8; i++) {
+		if (changed & buttons[i])
+			SDL_PrivateJoystickButton (opened, i, (held & buttons[i]) ? SDL_PRESSED : SDL_RELEASED);
 	}
 }
 
+void SDL_SYS_JoystickUpdate (SDL_Joystick *joystick) {
+	circlePosition circlePad;
+
+	/* The input thread's samples are reported by the pump */
+	if (N3DS_InputThreadRunning ())
+		return;
+
+	hidCircleRead(&circlePad);
+	N3DS_JoystickInput (hidKeysHeld (), &circlePad);
+}
+
 void SDL_SYS_JoystickClose (SDL_Joystick *joystick) {
+	if (opened == joystick)
+		opened = NULL;
 }
 
 void SDL_SYS_JoystickQuit (void) {
@@ -0,0 +1,254 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#include "SDL_endian.h"
+#include "SDL_n3dsblit_c.h"
+
+/* The 3DS (ARM11 MPCore) is built with -march=armv6k */
+#if defined(__arm__) && defined(__ARM_ARCH) && (__ARM_ARCH >= 6) && !defined(__thumb__)
+#define N3DS_ARMV6_SIMD 1
+#endif
+
+#ifdef N3DS_ARMV6_SIMD
+/* lo[15:0] | hi[15:0] << 16 in one instruction */
+static __inline__ Uint32 pack16(Uint32 lo, Uint32 hi)
+{
+	Uint32 r;
+	__asm__ ("pkhbt %0, %1, %2, lsl #16" : "=r" (r) : "r" (lo), "r" (hi));
+	return r;
+}
+/* byte 'n' of a word, zero extended (uxtb with rotation) */
+#define BYTE0(w)	((w) & 0xff)
+static __inline__ Uint32 byte1(Uint32 w) { Uint32 r; __asm__ ("uxtb %0, %1, ror #8" : "=r" (r) : "r" (w)); return r; }
+static __inline__ Uint32 byte2(Uint32 w) { Uint32 r; __asm__ ("uxtb %0, %1, ror #16" : "=r" (r) : "r" (w)); return r; }
+#define BYTE1(w)	byte1(w)
+#define BYTE2(w)	byte2(w)
+#define BYTE3(w)	((w) >> 24)
+#define PREFETCH(p)	__asm__ ("pld [%0, #32]" : : "r" (p))
+#else
+#define pack16(lo, hi)	(((Uint32)(lo) & 0xffff) | ((Uint32)(hi) << 16))
+#define BYTE0(w)	((w) & 0xff)
+#define BYTE1(w)	(((w) >> 8) & 0xff)
+#define BYTE2(w)	(((w) >> 16) & 0xff)
+#define BYTE3(w)	((w) >> 24)
+#define PREFETCH(p)
+#endif
+
+/* Index bytes come from word loads, which are little endian here */
+#if SDL_BYTEORDER != SDL_LIL_ENDIAN
+#error The n3ds pixel kernels assume a little endian target
+#endif
+
+/* Reference versions */
+
+void N3DS_ExpandPal8To32_C(Uint32 *dst, const Uint8 *src, int n, const Uint32 *palette)
+{
+	while ( n-- > 0 )
+		*dst++ = palette[*src++];
+}
+
+void N3DS_ExpandPal8To16_C(Uint16 *dst, const Uint8 *src, int n, const Uint16 *palette)
+{
+	while ( n-- > 0 )
+		*dst++ = palette[*src++];
+}
+
+/* Unrolled versions */
+
+void N3DS_ExpandPal8To32(Uint32 *dst, const Uint8 *src, int n, const Uint32 *palette)
+{
+	const Uint32 *src32;
+
+	// word align the source
+	while ( n > 0 && ((uintptr_t)src & 3) ) {
+		*dst++ = palette[*src++];
+		n--;
+	}
+
+	// 8 pixels from two word loads
+	src32 = (const Uint32 *)src;
+	while ( n >= 8 ) {
+		Uint32 a = src32[0];
+		Uint32 b = src32[1];
+		PREFETCH(src32);
+		dst[0] = palette[BYTE0(a)];
+		dst[1] = palette[BYTE1(a)];
+		dst[2] = palette[BYTE2(a)];
+		dst[3] = palette[BYTE3(a)];
+		dst[4] = palette[BYTE0(b)];
+		dst[5] = palette[BYTE1(b)];
+		dst[6] = palette[BYTE2(b)];
+		dst[7] = palette[BYTE3(b)];
+		src32 += 2;
+		dst += 8;
+		n -= 8;
+	}
+	src = (const Uint8 *)src32;
+
+	while ( n-- > 0 )
+		*dst++ = palette[*src++];
+}
+
+void N3DS_ExpandPal8To16(Uint16 *dst, const Uint8 *src, int n, const Uint16 *palette)
+{
+	const Uint32 *src32;
+	Uint32 *dst32;
+
+	// word align the destination, then the source may still be unaligned
+	if ( n > 0 && ((uintptr_t)dst & 2) ) {
+		*dst++ = palette[*src++];
+		n--;
+	}
+	while ( n > 0 && ((uintptr_t)src & 3) ) {
+		if ( n < 2 ) break;
+		// keep dst word aligned: two pixels at a time
+		*(Uint32 *)dst = pack16(palette[src[0]], palette[src[1]]);
+		src += 2;
+		dst += 2;
+		n -= 2;
+	}
+
+	if ( ((uintptr_t)src & 3) == 0 ) {
+		// 8 pixels from two word loads, packed into four word stores
+		src32 = (const Uint32 *)src;
+		dst32 = (Uint32 *)dst;
+		while ( n >= 8 ) {
+			Uint32 a = src32[0];
+			Uint32 b = src32[1];
+			PREFETCH(src32);
+			dst32[0] = pack16(palette[BYTE0(a)], palette[BYTE1(a)]);
+			dst32[1] = pack16(palette[BYTE2(a)], palette[BYTE3(a)]);
+			dst32[2] = pack16(palette[BYTE0(b)], palette[BYTE1(b)]);
+			dst32[3] = pack16(palette[BYTE2(b)], palette[BYTE3(b)]);
+			src32 += 2;
+			dst32 += 4;
+			n -= 8;
+		}
+		src = (const Uint8 *)src32;
+		dst = (Uint16 *)dst32;
+	}
+
+	while ( n-- > 0 )
+		*dst++ = palette[*src++];
+}
+
+/* Framebuffer rotation. The framebuffers are stored in portrait: screen
+   pixel (x, y) is at fb[x * fbh + (fbh - 1 - y)], fbh being the screen
+   height. */
+
+void N3DS_RotateToFramebuffer_C(Uint8 *fb, int fbh, const Uint8 *src, int pitch, int bpp,
+                                int x, int y, int w, int h)
+{
+	int i, j, k;
+	for ( j = y; j < y + h; j++ ) {
+		for ( i = x; i < x + w; i++ ) {
+			for ( k = 0; k < bpp; k++ )
+				fb[(i * fbh + (fbh - 1 - j)) * bpp + k] = src[j * pitch + i * bpp + k];
+		}
+	}
+}
+
+void N3DS_RotatePal8ToFramebuffer32_C(Uint32 *fb, int fbh, const Uint8 *src, int pitch,
+                                      int x, int y, int w, int h, const Uint32 *palette)
+{
+	int i, j;
+	for ( j = y; j < y + h; j++ )
+		for ( i = x; i < x + w; i++ )
+			fb[i * fbh + (fbh - 1 - j)] = palette[src[j * pitch + i]];
+}
+
+void N3DS_RotatePal8ToFramebuffer16_C(Uint16 *fb, int fbh, const Uint8 *src, int pitch,
+                                      int x, int y, int w, int h, const Uint16 *palette)
+{
+	int i, j;
+	for ( j = y; j < y + h; j++ )
+		for ( i = x; i < x + w; i++ )
+			fb[i * fbh + (fbh - 1 - j)] = palette[src[j * pitch + i]];
+}
+
+/* The blocked versions go through 8x8 blocks: the reads are 8 short rows
+   and the writes 8 short runs of the framebuffer, both stay in the cache.
+   Inside a block one screen column (a framebuffer run) is written at a time. */
+#define ROTATE_BLOCK 8
+
+#define ROTATE_LOOP(DSTTYPE, SRCTYPE, CONVERT) \
+	int bx, by, bw, bh, i, j; \
+	for ( by = y; by < y + h; by += ROTATE_BLOCK ) { \
+		bh = y + h - by; \
+		if ( bh > ROTATE_BLOCK ) bh = ROTATE_BLOCK; \
+		for ( bx = x; bx < x + w; bx += ROTATE_BLOCK ) { \
+			bw = x + w - bx; \
+			if ( bw > ROTATE_BLOCK ) bw = ROTATE_BLOCK; \
+			for ( i = bx; i < bx + bw; i++ ) { \
+				const Uint8 *s = src + by * pitch + i * sizeof(SRCTYPE); \
+				DSTTYPE *d = fb + i * fbh + (fbh - 1 - by); \
+				PREFETCH(s + ROTATE_BLOCK * pitch); \
+				for ( j = 0; j < bh; j++ ) { \
+					*d-- = CONVERT(*(const SRCTYPE *)s); \
+					s += pitch; \
+				} \
+			} \
+		} \
+	}
+
+#define ROTATE_COPY(p)	(p)
+#define ROTATE_PAL(p)	palette[p]
+
+static void rotate32(Uint32 *fb, int fbh, const Uint8 *src, int pitch, int x, int y, int w, int h)
+{
+	ROTATE_LOOP(Uint32, Uint32, ROTATE_COPY)
+}
+
+static void rotate16(Uint16 *fb, int fbh, const Uint8 *src, int pitch, int x, int y, int w, int h)
+{
+	ROTATE_LOOP(Uint16, Uint16, ROTATE_COPY)
+}
+
+void N3DS_RotatePal8ToFramebuffer32(Uint32 *fb, int fbh, const Uint8 *src, int pitch,
+                                    int x, int y, int w, int h, const Uint32 *palette)
+{
+	ROTATE_LOOP(Uint32, Uint8, ROTATE_PAL)
+}
+
+void N3DS_RotatePal8ToFramebuffer16(Uint16 *fb, int fbh, const Uint8 *src, int pitch,
+                                    int x, int y, int w, int h, const Uint16 *palette)
+{
+	ROTATE_LOOP(Uint16, Uint8, ROTATE_PAL)
+}
+
+void N3DS_RotateToFramebuffer(Uint8 *fb, int fbh, const Uint8 *src, int pitch, int bpp,
+                              int x, int y, int w, int h)
+{
+	switch ( bpp ) {
+		case 4:
+			rotate32((Uint32 *)fb, fbh, src, pitch, x, y, w, h);
+			break;
+		case 2:
+			rotate16((Uint16 *)fb, fbh, src, pitch, x, y, w, h);
+			break;
+		default:
+			// 24 bit pixels have no word access, the reference loop does as well
+			N3DS_RotateToFramebuffer_C(fb, fbh, src, pitch, bpp, x, y, w, h);
+			break;
+	}
+}
@@ -0,0 +1,66 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#ifndef _SDL_n3dsblit_c_h
+#define _SDL_n3dsblit_c_h
+
+#include "SDL_stdinc.h"
+
+/* Pixel conversion kernels used by the n3ds video driver to fill the
+   staging buffers. They work on one run of 'n' pixels (a row or part
+   of it); there are no alignment requirements on src or dst.
+
+   The N3DS_* entry points are unrolled and work on whole words, using
+   the ARMv6 SIMD32 instructions when built for the 3DS. The *_C
+   functions are the straightforward reference versions, built on every
+   platform so the kernels can be checked and timed against them
+   (test/testn3dsblit.c).
+*/
+
+/* 8bpp indexes to 32bpp through a 256 entry palette */
+extern void N3DS_ExpandPal8To32(Uint32 *dst, const Uint8 *src, int n, const Uint32 *palette);
+extern void N3DS_ExpandPal8To32_C(Uint32 *dst, const Uint8 *src, int n, const Uint32 *palette);
+
+/* 8bpp indexes to 16bpp (RGB565) through a 256 entry palette */
+extern void N3DS_ExpandPal8To16(Uint16 *dst, const Uint8 *src, int n, const Uint16 *palette);
+extern void N3DS_ExpandPal8To16_C(Uint16 *dst, const Uint8 *src, int n, const Uint16 *palette);
+
+/* A rectangle of a surface into a framebuffer, which is stored rotated
+   (screen column x is framebuffer row x, from the bottom of the screen up).
+   'src' is the surface origin, 'fbh' the screen height in pixels. */
+extern void N3DS_RotateToFramebuffer(Uint8 *fb, int fbh, const Uint8 *src, int pitch, int bpp,
+                                     int x, int y, int w, int h);
+extern void N3DS_RotateToFramebuffer_C(Uint8 *fb, int fbh, const Uint8 *src, int pitch, int bpp,
+                                       int x, int y, int w, int h);
+
+/* The same for 8bpp surfaces, through a 256 entry palette */
+extern void N3DS_RotatePal8ToFramebuffer32(Uint32 *fb, int fbh, const Uint8 *src, int pitch,
+                                           int x, int y, int w, int h, const Uint32 *palette);
+extern void N3DS_RotatePal8ToFramebuffer32_C(Uint32 *fb, int fbh, const Uint8 *src, int pitch,
+                                             int x, int y, int w, int h, const Uint32 *palette);
+extern void N3DS_RotatePal8ToFramebuffer16(Uint16 *fb, int fbh, const Uint8 *src, int pitch,
+                                           int x, int y, int w, int h, const Uint16 *palette);
+extern void N3DS_RotatePal8ToFramebuffer16_C(Uint16 *fb, int fbh, const Uint8 *src, int pitch,
+                                             int x, int y, int w, int h, const Uint16 *palette);
+
+#endif /* _SDL_n3dsblit_c_h */
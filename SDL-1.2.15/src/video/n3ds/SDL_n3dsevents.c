@@ -81,59 +81,178 @@ void task_exit() {
 }
 
 static SDLKey keymap[N3DS_NUMKEYS];
-char keymem[N3DS_NUMKEYS];
+static u32 keymem; // the keys reported as pressed
+static touchPosition touchmem; // the last touch reported as motion
+
+/* Input thread (SDL_N3DS_INPUT_RATE): it samples the input at a fixed rate
+   between the pumps, and keeps the samples that changed in a ring, which
+   the pump turns into events stamped with the time of their sample. The
+   events themselves are still queued by the pump, SDL's keyboard and mouse
+   state are not thread safe. */
+#define N3DS_INPUT_SAMPLES 64 // a power of 2
+#define N3DS_INPUT_PRIORITY 0x18 // above the main thread and the SDL threads
+
+typedef struct {
+	Uint32 ticks;
+	u32 held;
+	touchPosition touch; // 0,0 when not touching
+	circlePosition circle;
+} N3DS_InputSample;
+
+static struct {
+	Thread thread;
+	int quit;
+	s64 period; // ns
+	Uint32 head; // next sample to take, pump only
+	Uint32 tail; // next sample to fill, input thread only
+	N3DS_InputSample sample[N3DS_INPUT_SAMPLES];
+} input;
+
+static void readInput(N3DS_InputSample *s)
+{
+	s->held = hidKeysHeld();
+	s->touch.px = s->touch.py = 0;
+	if (s->held & KEY_TOUCH)
+		hidTouchRead(&s->touch);
+	hidCircleRead(&s->circle);
+}
 
-void N3DS_PumpEvents(_THIS)
+static void inputThread(void *arg)
 {
-	
-	if(!aptMainLoop())
-	{
-		SDL_PrivateQuit();
-		this->hidden->exiting = 1;
+	N3DS_InputSample last, s;
+	Uint32 tail;
+
+	SDL_memset(&last, 0, sizeof(last));
+	while (!__atomic_load_n(&input.quit, __ATOMIC_ACQUIRE)) {
+		hidScanInput();
+		readInput(&s);
+		if (s.held != last.held || s.touch.px != last.touch.px || s.touch.py != last.touch.py ||
+		    s.circle.dx != last.circle.dx || s.circle.dy != last.circle.dy) {
+			// when the ring is full the change stays pending, and is merged with the next ones
+			tail = input.tail;
+			if (tail - __atomic_load_n(&input.head, __ATOMIC_ACQUIRE) < N3DS_INPUT_SAMPLES) {
+				s.ticks = SDL_GetTicks();
+				input.sample[tail & (N3DS_INPUT_SAMPLES-1)] = s;
+				__atomic_store_n(&input.tail, tail+1, __ATOMIC_RELEASE);
+				last = s;
+			}
+		}
+		svcSleepThread(input.period);
 	}
-	svcSleepThread(1000000); //1ms;
-	
-	hidScanInput();
+}
 
-	int i;
-	SDL_keysym keysym;
-	keysym.mod = KMOD_NONE;
+static void startInputThread(void)
+{
+	const char *env = SDL_getenv("SDL_N3DS_INPUT_RATE");
+	int rate = env ? SDL_atoi(env) : 0;
+
+	if (rate <= 0 || input.thread)
+		return;
+	if (rate > 1000)
+		rate = 1000;
+	input.quit = 0;
+	input.period = 1000000000LL / rate;
+	input.head = input.tail = 0;
+	// on the system core if the app gave it some time (APT_SetAppCpuTimeLimit), else next to the main thread
+	input.thread = threadCreate(inputThread, NULL, 4096, N3DS_INPUT_PRIORITY, 1, false);
+	if (!input.thread)
+		input.thread = threadCreate(inputThread, NULL, 4096, N3DS_INPUT_PRIORITY, -2, false);
+}
 
-	for (i = 0; i < N3DS_NUMKEYS; i++) {
-		keysym.scancode = i;
-		keysym.sym = keymap[i];
+void N3DS_StopInputThread(_THIS)
+{
+	if (!input.thread)
+		return;
+	__atomic_store_n(&input.quit, 1, __ATOMIC_RELEASE);
+	threadJoin(input.thread, U64_MAX);
+	threadFree(input.thread);
+	input.thread = NULL;
+}
 
-		if (hidKeysHeld() & (1 << i) && !keymem[i]) {
-			keymem[i] = 1;
+int N3DS_InputThreadRunning(void)
+{
+	return (input.thread != NULL);
+}
 
-			SDL_PrivateKeyboard (SDL_PRESSED, &keysym);
-		}
+/* The keys held as of the last pump (hidKeysHeld would race with the input thread) */
+u32 N3DS_KeysHeld(void)
+{
+	return keymem;
+}
 
-		if (!(hidKeysHeld() & (1 << i)) && keymem[i]) {
-			keymem[i] = 0;
+static void sendInput(_THIS, u32 held, const touchPosition *touch)
+{
+	u32 changed;
+	int i;
+	SDL_keysym keysym;
 
-			SDL_PrivateKeyboard (SDL_RELEASED, &keysym);
-		}
+	// diff against what was reported rather than hidKeysDown/Up, so an app
+	// calling hidScanInput itself can't make a release go missing
+	changed = held ^ keymem;
+	keymem = held;
+	keysym.mod = KMOD_NONE;
+	while (changed) {
+		i = __builtin_ctz(changed);
+		changed &= changed - 1;
+		keysym.scancode = i;
+		keysym.sym = keymap[i];
+		SDL_PrivateKeyboard ((held & (1u << i)) ? SDL_PRESSED : SDL_RELEASED, &keysym);
 	}
 
-	if (hidKeysHeld() & KEY_TOUCH) {
-		touchPosition touch;
-
-		hidTouchRead (&touch);
-		if (touch.px != 0 || touch.py != 0) {
-			SDL_PrivateMouseMotion (0, 0, (touch.px * 400) / 320, (touch.py * 240) / 240);
+	if (held & KEY_TOUCH) {
+		if (touch->px != 0 || touch->py != 0) {
+			// the touch is sampled at the pump rate, most pumps see the same position
+			if (touch->px != touchmem.px || touch->py != touchmem.py) {
+				touchmem = *touch;
+				SDL_PrivateMouseMotion (0, 0, (touch->px * 400) / 320, (touch->py * 240) / 240);
+			}
 			if (!SDL_GetMouseState (NULL, NULL))
 				SDL_PrivateMouseButton (SDL_PRESSED, 1, 0, 0);
 		}
 	} else {
+		touchmem.px = touchmem.py = 0; // a new touch moves the pointer, even to the same place
 		if (SDL_GetMouseState (NULL, NULL))
 			SDL_PrivateMouseButton (SDL_RELEASED, 1, 0, 0);
 	}
 }
 
+void N3DS_PumpEvents(_THIS)
+{
+	N3DS_InputSample s;
+	Uint32 head;
+	
+	// one SDL_QUIT: a polling loop would never drain a new one per pump
+	if(!this->hidden->exiting && !aptMainLoop())
+	{
+		SDL_PrivateQuit();
+		this->hidden->exiting = 1;
+	}
+	if (this->hidden->pumpsleep)
+		svcSleepThread(1000000); //1ms, for apps that need it to let their threads run
+	
+	if (input.thread) {
+		head = input.head;
+		while (head != __atomic_load_n(&input.tail, __ATOMIC_ACQUIRE)) {
+			s = input.sample[head & (N3DS_INPUT_SAMPLES-1)];
+			__atomic_store_n(&input.head, ++head, __ATOMIC_RELEASE);
+			SDL_PrivateEventTime(s.ticks);
+			sendInput(this, s.held, &s.touch);
+			N3DS_JoystickInput(s.held, &s.circle);
+		}
+		SDL_PrivateEventTime(0);
+		return;
+	}
+
+	hidScanInput();
+	readInput(&s);
+	sendInput(this, s.held, &s.touch);
+}
+
 void N3DS_InitOSKeymap(_THIS)
 {
-	SDL_memset(keymem,1,N3DS_NUMKEYS);
+	const char *env = SDL_getenv("SDL_N3DS_PUMP_SLEEP");
+	this->hidden->pumpsleep = (env && SDL_atoi(env));
+
 	keymap[0]=SDLK_a; //KEY_A
 	keymap[1]=SDLK_b; // KEY_B
 	keymap[2]=SDLK_ESCAPE; //KEY_SELECT
@@ -168,10 +287,11 @@ void N3DS_InitOSKeymap(_THIS)
 	keymap[31]=SDLK_UNKNOWN; 
 
 // init the key state
-	int i;
 	hidScanInput();
-	for (i = 0; i < N3DS_NUMKEYS; i++)
-		keymem[i] = (hidKeysHeld() & (1 << i))?1:0;
+	keymem = hidKeysHeld();
+	touchmem.px = touchmem.py = 0;
+
+	startInputThread();
 
 }
 
@@ -29,6 +29,12 @@
 */
 extern void N3DS_InitOSKeymap(_THIS);
 extern void N3DS_PumpEvents(_THIS);
+extern void N3DS_StopInputThread(_THIS);
+extern int N3DS_InputThreadRunning(void);
+extern u32 N3DS_KeysHeld(void);
+
+/* From the joystick driver: the input thread's samples feed the joystick too */
+extern void N3DS_JoystickInput(u32 held, const circlePosition *circle);
 
 void task_init();
 void task_exit();
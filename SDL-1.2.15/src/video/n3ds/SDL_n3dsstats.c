@@ -0,0 +1,119 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#include "SDL_video.h"
+#include "SDL_n3dsstats_c.h"
+
+#if SDL_VIDEO_N3DS_FRAMESTATS
+
+#define STATS_FRAMES 64 // frames kept, a bit over a second
+
+// ARM11 ticks between two VBlanks, the screens refresh at 59.83Hz
+#define VBLANK_TICKS 4481136
+
+static Uint32 stats_frames[STATS_FRAMES][SDL_N3DS_STAGE_COUNT]; // ticks
+static Uint8 stats_missed[STATS_FRAMES];
+static Uint32 stats_current[SDL_N3DS_STAGE_COUNT];
+static int stats_next, stats_count;
+static u64 stats_last; // tick of the previous present, 0 before the first one
+
+void N3DS_StatsAdd(SDL_N3DSStage stage, u64 ticks)
+{
+	stats_current[stage] += (Uint32)ticks;
+}
+
+/* Called after each present: close the frame and put it into the ring */
+void N3DS_StatsFrame(void)
+{
+	u64 now = svcGetSystemTick();
+	u64 vblanks;
+
+	if ( stats_last ) {
+		// a present each VBlank is on time, every further VBlank in between was missed
+		vblanks = (now - stats_last + VBLANK_TICKS / 2) / VBLANK_TICKS;
+		stats_current[SDL_N3DS_STAGE_FRAME] = (Uint32)(now - stats_last);
+		if ( vblanks > 256 )
+			vblanks = 256;
+		stats_missed[stats_next] = (vblanks > 1) ? (Uint8)(vblanks - 1) : 0;
+		SDL_memcpy(stats_frames[stats_next], stats_current, sizeof(stats_current));
+		stats_next = (stats_next + 1) % STATS_FRAMES;
+		if ( stats_count < STATS_FRAMES )
+			stats_count++;
+	}
+	stats_last = now;
+	SDL_memset(stats_current, 0, sizeof(stats_current));
+}
+
+/* Forget the frames so far, the next present starts over */
+void N3DS_StatsReset(void)
+{
+	stats_next = 0;
+	stats_count = 0;
+	stats_last = 0;
+	SDL_memset(stats_current, 0, sizeof(stats_current));
+}
+
+static Uint32 ticksToUsec(u64 ticks)
+{
+	return (Uint32)(ticks * 1000000 / SYSCLOCK_ARM11);
+}
+
+int SDL_N3DSGetFrameStats(SDL_N3DSFrameStats *stats)
+{
+	int stage, i;
+
+	if ( ! stats ) {
+		SDL_SetError("Parameter 'stats' is invalid");
+		return(-1);
+	}
+	SDL_memset(stats, 0, sizeof(*stats));
+	stats->frames = stats_count;
+	for ( stage = 0; stage < SDL_N3DS_STAGE_COUNT; stage++ ) {
+		Uint32 min = 0xffffffff, max = 0;
+		u64 sum = 0;
+		if ( ! stats_count )
+			break;
+		for ( i = 0; i < stats_count; i++ ) {
+			Uint32 ticks = stats_frames[i][stage];
+			if ( ticks < min ) min = ticks;
+			if ( ticks > max ) max = ticks;
+			sum += ticks;
+		}
+		stats->min[stage] = ticksToUsec(min);
+		stats->avg[stage] = ticksToUsec(sum / stats_count);
+		stats->max[stage] = ticksToUsec(max);
+	}
+	for ( i = 0; i < stats_count; i++ )
+		stats->missedvblanks += stats_missed[i];
+	return(0);
+}
+
+#else
+
+int SDL_N3DSGetFrameStats(SDL_N3DSFrameStats *stats)
+{
+	SDL_SetError("SDL was built without SDL_VIDEO_N3DS_FRAMESTATS");
+	return(-1);
+}
+
+#endif /* SDL_VIDEO_N3DS_FRAMESTATS */
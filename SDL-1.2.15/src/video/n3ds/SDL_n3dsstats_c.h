@@ -0,0 +1,58 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#ifndef _SDL_n3dsstats_c_h
+#define _SDL_n3dsstats_c_h
+
+/* Timing of the present path, see SDL_N3DSGetFrameStats(). The stages
+   are timed with the system tick counter and summed per frame; without
+   SDL_VIDEO_N3DS_FRAMESTATS all of it compiles to nothing. */
+
+#include <3ds.h>
+#include "SDL_video.h"
+
+#if SDL_VIDEO_N3DS_FRAMESTATS
+
+extern void N3DS_StatsAdd(SDL_N3DSStage stage, u64 ticks);
+extern void N3DS_StatsFrame(void);
+extern void N3DS_StatsReset(void);
+
+/* Run 'call' and add the time it took to 'stage' */
+#define N3DS_TIMED(stage, call) \
+	do { \
+		u64 _timed_start = svcGetSystemTick(); \
+		call; \
+		N3DS_StatsAdd(stage, svcGetSystemTick() - _timed_start); \
+	} while(0)
+#define N3DS_STATS_FRAME()	N3DS_StatsFrame()
+#define N3DS_STATS_RESET()	N3DS_StatsReset()
+
+#else
+
+#define N3DS_TIMED(stage, call)	do { call; } while(0)
+#define N3DS_STATS_FRAME()
+#define N3DS_STATS_RESET()
+
+#endif /* SDL_VIDEO_N3DS_FRAMESTATS */
+
+#endif /* _SDL_n3dsstats_c_h */
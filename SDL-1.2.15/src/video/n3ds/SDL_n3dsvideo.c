@@ -48,10 +48,14 @@
 #include "SDL_n3dsvideo.h"
 #include "SDL_n3dsevents_c.h"
 #include "SDL_n3dsmouse_c.h"
+#include "SDL_n3dsblit_c.h"
+#include "SDL_n3dsyuv_c.h"
+#include "SDL_n3dsstats_c.h"
 
 #define N3DSVID_DRIVER_NAME "n3ds"
 
 static Uint32 n3ds_palette[256] = {0};
+static Uint16 n3ds_palette16[256] = {0};
 
 /* Low level N3ds */
 
@@ -59,6 +63,14 @@ static Uint32 n3ds_palette[256] = {0};
 #include "vshader_shbin.h"
 
 #define TEX_MIN_SIZE 32
+#define TEX_MAX_SIZE 1024
+
+// PICA textures are stored as 8x8 tiles, so partial uploads work on whole tile rows
+#define TILE_SIZE 8
+#define MAX_TILE_ROWS (TEX_MAX_SIZE/TILE_SIZE)
+// dirty bands separated by at most this many clean tile rows are uploaded in one transfer
+#define BAND_MERGE_GAP 2
+
 #define CLEAR_COLOR0 0x000000FF
 #define CLEAR_COLOR1 0x000000
 #define CLEAR_COLOR2 0x000000
@@ -101,23 +113,121 @@ static Uint32 n3ds_palette[256] = {0};
 	GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB5A1) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB5A1) | \
 	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
 
+// Used to read the screen texture back into the buffer (the inverse of the texture transfer)
+#define READBACK_TRANSFER_FLAGS0 \
+	(GX_TRANSFER_FLIP_VERT(1) | GX_TRANSFER_OUT_TILED(0) | GX_TRANSFER_RAW_COPY(0) | \
+	GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGBA8) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGBA8) | \
+	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+#define READBACK_TRANSFER_FLAGS1 \
+	(GX_TRANSFER_FLIP_VERT(1) | GX_TRANSFER_OUT_TILED(0) | GX_TRANSFER_RAW_COPY(0) | \
+	GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB8) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB8) | \
+	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+#define READBACK_TRANSFER_FLAGS2 \
+	(GX_TRANSFER_FLIP_VERT(1) | GX_TRANSFER_OUT_TILED(0) | GX_TRANSFER_RAW_COPY(0) | \
+	GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB5A1) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB565) | \
+	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+#define READBACK_TRANSFER_FLAGS3 \
+	(GX_TRANSFER_FLIP_VERT(1) | GX_TRANSFER_OUT_TILED(0) | GX_TRANSFER_RAW_COPY(0) | \
+	GX_TRANSFER_IN_FORMAT(GX_TRANSFER_FMT_RGB5A1) | GX_TRANSFER_OUT_FORMAT(GX_TRANSFER_FMT_RGB5A1) | \
+	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+
+// Used to upload hardware surfaces, which are never converted
+#define HWSURFACE_TRANSFER_FLAGS(fmt) \
+	(GX_TRANSFER_FLIP_VERT(1) | GX_TRANSFER_OUT_TILED(1) | GX_TRANSFER_RAW_COPY(0) | \
+	GX_TRANSFER_IN_FORMAT(fmt) | GX_TRANSFER_OUT_FORMAT(fmt) | \
+	GX_TRANSFER_SCALING(GX_TRANSFER_SCALE_NO))
+
 static DVLB_s* vshader_dvlb;
 static shaderProgram_s program;
 static int uLoc_projection;
 static C3D_Mtx projection;
 static C3D_Mtx projection2;
+static C3D_Mtx texprojection; // surface coordinates to the screen texture
 static bool drawing = false;
 
 C3D_RenderTarget *VideoSurface1;
 C3D_RenderTarget *VideoSurface2;
 static C3D_Tex spritesheet_tex;
+static int scenemode = -1; // format VideoSurface1 and VideoSurface2 were created with
+
+// GPU palette lookup: the L8 index texture is used as a bump map, so N.V
+// gives back the index and the reflection LUTs (RR, RG, RB) hold the palette
+static C3D_LightEnv palette_env;
+static C3D_Light palette_light;
+static C3D_LightLut palette_lut[3];
+static float palette_lutdata[3][512];
 
 static int textureTranferFlags[4] = { TEXTURE_TRANSFER_FLAGS0, TEXTURE_TRANSFER_FLAGS1, TEXTURE_TRANSFER_FLAGS2, TEXTURE_TRANSFER_FLAGS3};
+static int readbackTranferFlags[4] = { READBACK_TRANSFER_FLAGS0, READBACK_TRANSFER_FLAGS1, READBACK_TRANSFER_FLAGS2, READBACK_TRANSFER_FLAGS3};
 static int displayTranferFlags[4] = { DISPLAY_TRANSFER_FLAGS0, DISPLAY_TRANSFER_FLAGS1, DISPLAY_TRANSFER_FLAGS2, DISPLAY_TRANSFER_FLAGS3};
 static unsigned int clearcolors[4] = { CLEAR_COLOR0, CLEAR_COLOR1, CLEAR_COLOR2, CLEAR_COLOR3};
 
-static void sceneInit(GSPGPU_FramebufferFormats mode);
+/* Pixel formats that can back a hardware surface. Colorkeyed surfaces are
+   uploaded from a copy in the key format, where the alpha channel marks
+   the transparent pixels. */
+struct N3DS_HWFormat {
+	int bpp;
+	Uint32 Rmask, Gmask, Bmask;
+	GPU_TEXCOLOR texfmt;
+	GX_TRANSFER_FORMAT transferfmt;
+	GPU_TEXCOLOR keytexfmt;
+	GX_TRANSFER_FORMAT keytransferfmt;
+	int keybpp;
+};
+
+static const struct N3DS_HWFormat hwformats[] = {
+	{ 32, 0xff000000, 0x00ff0000, 0x0000ff00, GPU_RGBA8, GX_TRANSFER_FMT_RGBA8, GPU_RGBA8, GX_TRANSFER_FMT_RGBA8, 4 },
+	{ 24, 0x00ff0000, 0x0000ff00, 0x000000ff, GPU_RGB8, GX_TRANSFER_FMT_RGB8, GPU_RGBA8, GX_TRANSFER_FMT_RGBA8, 4 },
+	{ 16, 0xF800, 0x07E0, 0x001F, GPU_RGB565, GX_TRANSFER_FMT_RGB565, GPU_RGBA5551, GX_TRANSFER_FMT_RGB5A1, 2 },
+	{ 16, 0xF800, 0x07C0, 0x003E, GPU_RGBA5551, GX_TRANSFER_FMT_RGB5A1, GPU_RGBA5551, GX_TRANSFER_FMT_RGB5A1, 2 },
+	{ 16, 0xF000, 0x0F00, 0x00F0, GPU_RGBA4, GX_TRANSFER_FMT_RGBA4, GPU_RGBA4, GX_TRANSFER_FMT_RGBA4, 2 },
+};
+
+/* How a quad is drawn into the screen texture */
+#define DRAW_COPY 0
+#define DRAW_PIXELALPHA 1
+#define DRAW_SURFACEALPHA 2
+#define DRAW_FILL 3
+
+struct N3DS_DrawState {
+	C3D_Tex *tex; // NULL for fills
+	int mode; // DRAW_*
+	int keyed; // drop the texels with alpha 0
+	Uint32 color; // fill color, or the surface alpha (0xAABBGGRR)
+};
+
+/* The deferred draw list: quads are recorded in blit order and grouped in
+   batches with the same state, one draw call each. A quad may only join an
+   earlier batch if nothing recorded after that batch overlaps it, so the
+   result is the same as drawing in order. */
+struct N3DS_DrawBatch {
+	struct N3DS_DrawState state;
+	int count; // quads
+	int first; // first vertex, while the list is emitted
+	int x1, y1, x2, y2; // bounding box of the quads
+};
+
+struct N3DS_DrawOp {
+	int batch;
+	Sint16 x, y, w, h;
+	float left, right, top, bottom;
+};
+
+struct N3DS_Vertex {
+	float x, y, z;
+	float u, v;
+};
+
+/* A texture freed while a frame that samples it may still be running */
+struct N3DS_FreedTex {
+	C3D_Tex tex;
+	Uint32 usedframe;
+};
+
+static void sceneInit(void);
+static void sceneSetMode(GSPGPU_FramebufferFormats mode);
 static void sceneExit(void);
+static void paletteInit(int enable);
 void drawTexture( int x, int y, int width, int height, float left, float right, float top, float bottom);
 
 /* Initialization/Query functions */
@@ -134,6 +244,14 @@ static int N3DS_LockHWSurface(_THIS, SDL_Surface *surface);
 static void N3DS_UnlockHWSurface(_THIS, SDL_Surface *surface);
 static void N3DS_FreeHWSurface(_THIS, SDL_Surface *surface);
 static int N3DS_FlipHWSurface (_THIS, SDL_Surface *surface); 
+static int N3DS_CheckHWBlit(_THIS, SDL_Surface *src, SDL_Surface *dst);
+static int N3DS_HWAccelBlit(SDL_Surface *src, SDL_Rect *srcrect, SDL_Surface *dst, SDL_Rect *dstrect);
+static int N3DS_FillHWRect(_THIS, SDL_Surface *dst, SDL_Rect *rect, Uint32 color);
+static int N3DS_SetHWColorKey(_THIS, SDL_Surface *surface, Uint32 key);
+static int N3DS_SetHWAlpha(_THIS, SDL_Surface *surface, Uint8 value);
+
+static void flushFrame(_THIS);
+static void emitDrawList(_THIS);
 
 //Copied from sf2dlib that grabbet it from: http://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
 unsigned int next_pow2(unsigned int v)
@@ -188,15 +306,15 @@ static SDL_VideoDevice *N3DS_CreateDevice(int devindex)
 	device->VideoInit = N3DS_VideoInit;
 	device->ListModes = N3DS_ListModes;
 	device->SetVideoMode = N3DS_SetVideoMode;
-	device->CreateYUVOverlay = NULL;
+	device->CreateYUVOverlay = N3DS_CreateYUVOverlay;
 	device->SetColors = N3DS_SetColors;
 	device->UpdateRects = N3DS_UpdateRects;
 	device->VideoQuit = N3DS_VideoQuit;
 	device->AllocHWSurface = N3DS_AllocHWSurface;
-	device->CheckHWBlit = NULL;
-	device->FillHWRect = NULL;
-	device->SetHWColorKey = NULL;
-	device->SetHWAlpha = NULL;
+	device->CheckHWBlit = N3DS_CheckHWBlit;
+	device->FillHWRect = N3DS_FillHWRect;
+	device->SetHWColorKey = N3DS_SetHWColorKey;
+	device->SetHWAlpha = N3DS_SetHWAlpha;
 	device->LockHWSurface = N3DS_LockHWSurface;
 	device->UnlockHWSurface = N3DS_UnlockHWSurface;
 	device->FlipHWSurface = N3DS_FlipHWSurface;
@@ -208,7 +326,6 @@ static SDL_VideoDevice *N3DS_CreateDevice(int devindex)
 	device->GetWMInfo = NULL;
 	device->InitOSKeymap = N3DS_InitOSKeymap;
 	device->PumpEvents = N3DS_PumpEvents;
-//	device->info.blit_hw = 1;
 
 	device->free = N3DS_DeleteDevice;
 
@@ -227,6 +344,7 @@ int N3DS_VideoInit(_THIS, SDL_PixelFormat *vformat)
 	gfxInitDefault();
 	gfxSet3D(false);
 	C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
+	sceneInit();
 	
 	vformat->BitsPerPixel = 32;	
 	vformat->BytesPerPixel = 4;
@@ -244,6 +362,56 @@ SDL_Rect **N3DS_ListModes(_THIS, SDL_PixelFormat *format, Uint32 flags)
    	 return (SDL_Rect **) -1;
 }
 
+static void freeBuffers(_THIS)
+{
+	int i;
+	for ( i = 0; i < N3DS_MAX_BUFFERS; i++ ) {
+		if ( this->hidden->buffers[i] ) {
+			linearFree( this->hidden->buffers[i] );
+			this->hidden->buffers[i] = NULL;
+		}
+	}
+	this->hidden->buffer = NULL;
+}
+
+/* Get 'n' cleared staging buffers of 'size' bytes. The ones from the
+   previous mode are kept if they are large enough, so switching between
+   modes doesn't churn the linear heap. */
+static int allocBuffers(_THIS, int n, int size)
+{
+	int i;
+	for ( i = 0; i < N3DS_MAX_BUFFERS; i++ ) {
+		if ( this->hidden->buffers[i] && (i >= n || this->hidden->buffersizes[i] < size) ) {
+			linearFree( this->hidden->buffers[i] );
+			this->hidden->buffers[i] = NULL;
+		}
+		if ( i >= n )
+			continue;
+		if ( ! this->hidden->buffers[i] ) {
+			this->hidden->buffers[i] = linearAlloc(size);
+			if ( ! this->hidden->buffers[i] ) {
+				freeBuffers(this);
+				return(-1);
+			}
+			this->hidden->buffersizes[i] = size;
+		}
+		SDL_memset(this->hidden->buffers[i], 0, size);
+	}
+	this->hidden->buffer = this->hidden->buffers[0];
+	return(0);
+}
+
+/* Set up spritesheet_tex, keeping the previous one if it matches */
+static int sceneTexture(int w, int h, GPU_TEXCOLOR fmt)
+{
+	if ( spritesheet_tex.data ) {
+		if ( spritesheet_tex.width == w && spritesheet_tex.height == h && spritesheet_tex.fmt == fmt )
+			return(1);
+		C3D_TexDelete(&spritesheet_tex);
+	}
+	return(C3D_TexInit(&spritesheet_tex, w, h, fmt));
+}
+
 SDL_Surface *N3DS_SetVideoMode(_THIS, SDL_Surface *current,
 				int width, int height, int bpp, Uint32 flags)
 {
@@ -251,6 +419,9 @@ SDL_Surface *N3DS_SetVideoMode(_THIS, SDL_Surface *current,
 Uint32 Rmask, Gmask, Bmask, Amask; 
 int hw = next_pow2(width);
 int hh= next_pow2(height);
+int bw = (width + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+int bh = (height + TILE_SIZE - 1) & ~(TILE_SIZE - 1);
+const char *env;
 
 	this->hidden->exiting = 0;
 	this->hidden->screens = flags & (SDL_DUALSCR); // SDL_DUALSCR = SDL_TOPSCR | SDL_BOTTOMSCR
@@ -306,53 +477,132 @@ int hh= next_pow2(height);
 			this->hidden->mode=GSP_RGBA8_OES;
 			this->hidden->byteperpixel=4;
 			this->hidden->bpp = 8;
+			// halve the expansion and upload cost, at the price of a RGB565 palette
+			env = SDL_getenv("SDL_N3DS_PALETTE16");
+			if ( env && SDL_atoi(env) ) {
+				this->hidden->mode=GSP_RGB565_OES;
+				this->hidden->byteperpixel=2;
+			}
 			break;
 		default:
 			return NULL;
 			break;
 	}
 
-	if ( this->hidden->buffer ) {
-		linearFree( this->hidden->buffer );
-		this->hidden->buffer = NULL;
-	}
-	if ( this->hidden->palettedbuffer ) {
-		free( this->hidden->palettedbuffer );
-		this->hidden->palettedbuffer = NULL;
+	flushFrame(this);
+	if ( this->hidden->screentarget ) {
+		C3D_RenderTargetDelete(this->hidden->screentarget);
+		this->hidden->screentarget = NULL;
 	}
 
 	if(flags & SDL_FULLSCREEN) 
 		flags |= (SDL_FITWIDTH | SDL_FITHEIGHT);
 	this->hidden->fitscreen = flags & (SDL_FITWIDTH | SDL_FITHEIGHT);
 
-	this->hidden->buffer = (u8*) linearAlloc(hw * hh * this->hidden->byteperpixel);
-	if ( ! this->hidden->buffer ) {
+	// Pipelined present, requested with SDL_ASYNCBLIT or SDL_N3DS_PRESENT=pipelined
+	this->hidden->pipelined = (flags & SDL_ASYNCBLIT) != 0;
+	env = SDL_getenv("SDL_N3DS_PRESENT");
+	if ( env ) {
+		if ( SDL_strcasecmp(env, "pipelined") == 0 )
+			this->hidden->pipelined = 1;
+		else if ( SDL_strcasecmp(env, "vsync") == 0 )
+			this->hidden->pipelined = 0;
+	}
+	// 8bpp palette lookup on the GPU, requested with SDL_N3DS_GPUPALETTE=1
+	this->hidden->gpupalette = 0;
+	if ( bpp == 8 ) {
+		env = SDL_getenv("SDL_N3DS_GPUPALETTE");
+		if ( env && SDL_atoi(env) )
+			this->hidden->gpupalette = 1;
+	}
+
+	// Direct present, for a screen of exactly the size of one display: the
+	// buffer is rotated straight into the framebuffer, no texture and no GPU.
+	// It is the default unless the app wants hardware surfaces.
+	this->hidden->direct = 0;
+	if ( !this->hidden->gpupalette && height == 240 &&
+	     ((this->hidden->screens == SDL_TOPSCR && width == 400) ||
+	      (this->hidden->screens == SDL_BOTTOMSCR && width == 320)) ) {
+		env = SDL_getenv("SDL_N3DS_DIRECT");
+		if ( env ) {
+			this->hidden->direct = SDL_atoi(env) != 0;
+		} else {
+			const char *hwenv = SDL_getenv("SDL_N3DS_HWACCEL");
+			this->hidden->direct = !((flags & SDL_HWSURFACE) && bpp > 8 && (!hwenv || SDL_atoi(hwenv)));
+		}
+	}
+
+	this->hidden->numbuffers = 1;
+	if ( this->hidden->direct ) {
+		// presenting is synchronous, a single buffer is enough; 8bpp expands
+		// the paletted buffer straight into the framebuffer
+		if ( bpp == 8 )
+			this->hidden->numbuffers = 0;
+	} else if ( this->hidden->gpupalette ) {
+		// the indexes are swizzled straight into the texture, no staging buffer
+		this->hidden->numbuffers = 0;
+	} else if ( this->hidden->pipelined && (flags & SDL_DOUBLEBUF) ) {
+		// the app redraws every frame, so it can draw into the next buffer
+		// while the GPU is still reading the previous one
+		this->hidden->numbuffers = 2;
+		env = SDL_getenv("SDL_N3DS_PRESENT_BUFFERS");
+		if ( env && SDL_atoi(env) >= 3 )
+			this->hidden->numbuffers = 3;
+	}
+
+	// the staging buffers only hold the mode, the transfers pad it out to the texture
+	if ( allocBuffers(this, this->hidden->numbuffers, bw * bh * this->hidden->byteperpixel) < 0 ) {
 		SDL_SetError("Couldn't allocate buffer for requested mode");
 		return(NULL);
 	}
-
-	SDL_memset(this->hidden->buffer, 0, hw * hh * this->hidden->byteperpixel);
+	this->hidden->curbuffer = 0;
+	this->hidden->stale = 0;
+
+	// GPU blits and fills need a hardware screen with a single RGB buffer
+	this->hidden->hwaccel = 0;
+	if ( (flags & SDL_HWSURFACE) && bpp > 8 && this->hidden->numbuffers == 1 && !this->hidden->direct ) {
+		env = SDL_getenv("SDL_N3DS_HWACCEL");
+		if ( !env || SDL_atoi(env) )
+			this->hidden->hwaccel = 1;
+	}
+	this->hidden->screengpu = 0;
+	this->hidden->screencpu = 0;
+	this->hidden->screendirty = this->hidden->screens;
+	// GPU blits are recorded and drawn in batches when the frame is presented
+	env = SDL_getenv("SDL_N3DS_BATCH");
+	this->hidden->batching = !env || SDL_atoi(env);
+	this->info.hw_available = this->hidden->hwaccel;
+	this->info.blit_hw = this->hidden->hwaccel;
+	this->info.blit_hw_CC = this->hidden->hwaccel;
+	this->info.blit_hw_A = this->hidden->hwaccel;
+	this->info.blit_fill = this->hidden->hwaccel;
 
 	if(bpp==8) {
-		this->hidden->palettedbuffer = malloc(width * height);
-		if ( ! this->hidden->palettedbuffer ) {
-			SDL_SetError("Couldn't allocate buffer for requested mode");
-			linearFree(this->hidden->buffer);
-			return(NULL);
+		if ( this->hidden->palettedsize < width * height ) {
+			free( this->hidden->palettedbuffer );
+			this->hidden->palettedsize = 0;
+			this->hidden->palettedbuffer = malloc(width * height);
+			if ( ! this->hidden->palettedbuffer ) {
+				SDL_SetError("Couldn't allocate buffer for requested mode");
+				freeBuffers(this);
+				return(NULL);
+			}
+			this->hidden->palettedsize = width * height;
 		}
 		SDL_memset(this->hidden->palettedbuffer, 0, width * height);
+		if ( this->hidden->gpupalette )
+			this->hidden->buffer = this->hidden->palettedbuffer;
 	}
 
 	/* Allocate the new pixel format for the screen */
 	if ( ! SDL_ReallocFormat(current, bpp, Rmask, Gmask, Bmask, Amask) ) {
-		linearFree(this->hidden->buffer);
-		this->hidden->buffer = NULL;
+		freeBuffers(this);
 		SDL_SetError("Couldn't allocate new pixel format for requested mode");
 		return(NULL);
 	}
 
 	//setup the screens mode
-	sceneInit(this->hidden->mode);
+	sceneSetMode(this->hidden->mode);
 	if((flags & SDL_CONSOLETOP) && !(this->hidden->screens & SDL_TOPSCR)) {
 		consoleInit(GFX_TOP, NULL);
 		this->hidden->console = SDL_CONSOLETOP;
@@ -366,6 +616,8 @@ int hh= next_pow2(height);
 	current->flags =  SDL_HWSURFACE | SDL_DOUBLEBUF;
 	this->hidden->w = hw;
 	this->hidden->h = hh;
+	this->hidden->bufw = bw;
+	this->hidden->bufh = bh;
 
 	this->hidden->x1 = 0;
 	this->hidden->y1 = 0;
@@ -413,7 +665,7 @@ int hh= next_pow2(height);
 	this->info.current_h = current->h = height;
 	if(bpp>8) {
 		current->pixels = this->hidden->buffer;
-		current->pitch = hw * this->hidden->byteperpixel;
+		current->pitch = bw * this->hidden->byteperpixel;
 	} else {
 		current->pixels = this->hidden->palettedbuffer;
 		current->pitch = width;
@@ -425,115 +677,532 @@ int hh= next_pow2(height);
 	if (mode==2) mode = 3; 
 
 	// Setup the textures
-	C3D_TexInit(&spritesheet_tex, hw, hh, this->hidden->mode);
-	C3D_TexSetFilter(&spritesheet_tex, GPU_LINEAR, GPU_NEAREST);
+	if ( this->hidden->gpupalette ) {
+		// indexes must not be filtered
+		if ( ! sceneTexture(hw, hh, GPU_L8) ) {
+			SDL_SetError("Couldn't allocate texture for requested mode");
+			return(NULL);
+		}
+		C3D_TexSetFilter(&spritesheet_tex, GPU_NEAREST, GPU_NEAREST);
+		SDL_memset(spritesheet_tex.data, 0, hw * hh);
+		GSPGPU_FlushDataCache(spritesheet_tex.data, hw * hh);
+	} else {
+		if ( ! sceneTexture(hw, hh, this->hidden->mode) ) {
+			SDL_SetError("Couldn't allocate texture for requested mode");
+			return(NULL);
+		}
+		C3D_TexSetFilter(&spritesheet_tex, GPU_LINEAR, GPU_NEAREST);
+	}
 	C3D_TexBind(0, &spritesheet_tex);
+	paletteInit(this->hidden->gpupalette);
+
+	if ( bpp > 8 && this->hidden->numbuffers == 1 && !this->hidden->direct ) {
+		// GPU blits and YUV overlays draw here; no depth buffer, they don't use the depth test
+		this->hidden->screentarget = C3D_RenderTargetCreateFromTex(&spritesheet_tex, GPU_TEXFACE_2D, 0, -1);
+		if ( ! this->hidden->screentarget ) {
+			this->hidden->hwaccel = 0;
+			this->info.hw_available = this->info.blit_hw = 0;
+			this->info.blit_hw_CC = this->info.blit_hw_A = this->info.blit_fill = 0;
+		}
+		// same layout as the texture upload: row y of the surface is sampled at v = y/h
+		Mtx_Ortho(&texprojection, 0.0, hw, 0.0, hh, 0.0, 1.0, true);
+	}
+
+	N3DS_STATS_RESET();
+
+	if ( this->hidden->direct ) {
+		// the framebuffer takes the pixels as they are; both of its buffers are filled by the first presents
+		this->hidden->directscreen = (this->hidden->screens & SDL_TOPSCR) ? GFX_TOP : GFX_BOTTOM;
+		gfxSetScreenFormat(this->hidden->directscreen, this->hidden->mode);
+		gfxSetDoubleBuffering(this->hidden->directscreen, true);
+		this->hidden->directfull = 2;
+	}
 
 	/* We're done */
 	return(current);
 }
 
-/* We don't actually allow hardware surfaces other than the main one */
-static int N3DS_AllocHWSurface(_THIS, SDL_Surface *surface)
+/* Set up (or tear down) the fragment lighting used for the GPU palette lookup */
+static void paletteInit(int enable)
 {
-	return(-1);
+	static const C3D_Material material = {
+		{ 0.0f, 0.0f, 0.0f }, //ambient
+		{ 0.0f, 0.0f, 0.0f }, //diffuse
+		{ 0.0f, 0.0f, 0.0f }, //specular0
+		{ 1.0f, 1.0f, 1.0f }, //specular1
+		{ 0.0f, 0.0f, 0.0f }, //emission
+	};
+	C3D_TexEnv* env = C3D_GetTexEnv(0);
+	C3D_FVec lightpos;
+	int i;
+
+	if(!enable) {
+		C3D_LightEnvBind(NULL);
+		C3D_TexEnvSrc(env, C3D_Both, GPU_TEXTURE0, 0, 0);
+		C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
+		return;
+	}
+
+	C3D_LightEnvInit(&palette_env);
+	C3D_LightEnvBind(&palette_env);
+	C3D_LightEnvMaterial(&palette_env, &material);
+	// texture 0 is the normal map, taken as-is: N = (2i-1, 2i-1, 2i-1) with i = index/255
+	C3D_LightEnvBumpMode(&palette_env, GPU_BUMP_AS_BUMP);
+	C3D_LightEnvBumpSel(&palette_env, 0);
+	C3D_LightEnvBumpNormalZ(&palette_env, true);
+	C3D_LightEnvClampHighlights(&palette_env, false);
+
+	// the vertex shader outputs an identity normal quaternion and V = (1,0,0)
+	for(i=0; i<3; i++) {
+		SDL_memset(palette_lutdata[i], 0, sizeof(palette_lutdata[i]));
+		LightLut_FromArray(&palette_lut[i], palette_lutdata[i]);
+	}
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RR, GPU_LUTINPUT_NV, true, &palette_lut[0]);
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RG, GPU_LUTINPUT_NV, true, &palette_lut[1]);
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RB, GPU_LUTINPUT_NV, true, &palette_lut[2]);
+
+	C3D_LightInit(&palette_light, &palette_env);
+	C3D_LightSpecular1(&palette_light, 1.0f, 1.0f, 1.0f);
+	// the light vector does not take part in the lookup
+	lightpos.x = 0.0f; lightpos.y = 0.0f; lightpos.z = 1.0f; lightpos.w = 0.0f;
+	C3D_LightPosition(&palette_light, &lightpos);
+
+	// the specular (secondary) color is the palette entry
+	C3D_TexEnvSrc(env, C3D_RGB, GPU_FRAGMENT_SECONDARY_COLOR, 0, 0);
+	C3D_TexEnvSrc(env, C3D_Alpha, GPU_CONSTANT, 0, 0);
+	C3D_TexEnvColor(env, 0xFFFFFFFF);
+	C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
 }
-static void N3DS_FreeHWSurface(_THIS, SDL_Surface *surface)
+
+/* Load palette entries into the reflection LUTs. N.V is a signed LUT input:
+   index i gives N.V = 2i/255-1, which falls on LUT entry i-128 (i^0x80
+   as an unsigned entry) with a fraction below one step, so the deltas
+   are left at zero to avoid blending with the next entry. */
+static void paletteLoad(int firstcolor, int ncolors, SDL_Color *colors)
 {
-	return;
+	int i;
+	for(i=0; i<ncolors; i++) {
+		int entry = (firstcolor + i) ^ 0x80;
+		palette_lutdata[0][entry] = colors[i].r / 255.0f;
+		palette_lutdata[1][entry] = colors[i].g / 255.0f;
+		palette_lutdata[2][entry] = colors[i].b / 255.0f;
+	}
+	for(i=0; i<3; i++)
+		LightLut_FromArray(&palette_lut[i], palette_lutdata[i]);
+	// mark the LUTs dirty so they are uploaded with the next frame
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RR, GPU_LUTINPUT_NV, true, &palette_lut[0]);
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RG, GPU_LUTINPUT_NV, true, &palette_lut[1]);
+	C3D_LightEnvLut(&palette_env, GPU_LUT_RB, GPU_LUTINPUT_NV, true, &palette_lut[2]);
 }
 
-/* We need to wait for vertical retrace on page flipped displays */
-static int N3DS_LockHWSurface(_THIS, SDL_Surface *surface)
+/* Swizzle the 8bpp rows [y, y+h) into the tiled L8 texture (same layout
+   the GX transfer produces: flipped rows, 8x8 tiles in Morton order) */
+static void swizzleBand(_THIS, int y, int h)
 {
-	return(0);
+	static const Uint8 morton_x[8] = { 0x00, 0x01, 0x04, 0x05, 0x10, 0x11, 0x14, 0x15 };
+	static const Uint8 morton_y[8] = { 0x00, 0x02, 0x08, 0x0a, 0x20, 0x22, 0x28, 0x2a };
+	int srcw = this->info.current_w;
+	int srch = this->info.current_h;
+	Uint8 *tiles = (Uint8 *)spritesheet_tex.data + (this->hidden->h - y - h)*this->hidden->w;
+	int row, x, c;
+
+	for(row = y; row < y + h; row++) {
+		Uint8 *src = this->hidden->palettedbuffer + row*srcw;
+		// rows go bottom-up inside the band, so row y+h-1 is the first one of its tile
+		Uint8 *dst = tiles + ((y + h - 1 - row) & ~7)*this->hidden->w;
+		int my = morton_y[(y + h - 1 - row) & 7];
+		int cols = (row < srch) ? srcw : 0;
+		for(x = 0; x < this->hidden->w; x += 8, dst += 64) {
+			for(c = 0; c < 8; c++)
+				dst[my | morton_x[c]] = (x + c < cols) ? src[x + c] : 0;
+		}
+	}
+	N3DS_TIMED(SDL_N3DS_STAGE_FLUSH, GSPGPU_FlushDataCache(tiles, h*this->hidden->w));
 }
 
-static void N3DS_UnlockHWSurface(_THIS, SDL_Surface *surface)
+/* Delete the freed textures no frame still samples. Called once
+   C3D_FrameBegin has waited for the previous frame. */
+static void deleteFreedTextures(_THIS)
+{
+	int i, n = 0;
+
+	for ( i = 0; i < this->hidden->numfreedtex; i++ ) {
+		struct N3DS_FreedTex *freed = &this->hidden->freedtex[i];
+		if ( freed->usedframe != this->hidden->frameserial )
+			C3D_TexDelete(&freed->tex);
+		else
+			this->hidden->freedtex[n++] = *freed;
+	}
+	this->hidden->numfreedtex = n;
+}
+
+/* Open the citro3d frame the GPU blits and the screens are drawn in */
+static void beginFrame(_THIS)
+{
+	if(this->hidden->inframe)
+		return;
+	if(this->hidden->pipelined) {
+		// C3D_FrameBegin waits for the previous frame's commands, nothing more
+		N3DS_TIMED(SDL_N3DS_STAGE_FRAMEBEGIN, C3D_FrameBegin(0));
+	} else {
+		N3DS_TIMED(SDL_N3DS_STAGE_FRAMEBEGIN, C3D_FrameBegin(C3D_FRAME_SYNCDRAW));
+	}
+	this->hidden->inframe = 1;
+	this->hidden->vboused = 0;
+	deleteFreedTextures(this);
+}
+
+/* GPU work has been recorded and not submitted yet */
+static int framePending(_THIS)
+{
+	return(this->hidden->inframe || this->hidden->numdrawops);
+}
+
+/* Submit the open frame. The GX queue runs in order, so transfers queued
+   after this see the result of the GPU blits recorded before. */
+static void flushFrame(_THIS)
+{
+	emitDrawList(this);
+	if(!this->hidden->inframe)
+		return;
+	N3DS_TIMED(SDL_N3DS_STAGE_FRAMEEND, C3D_FrameEnd(0));
+	this->hidden->inframe = 0;
+	this->hidden->frameserial++;
+}
+
+/* GPU blits change the combiner and blending; put back what the screens are drawn with */
+static void restoreScreenState(void)
+{
+	C3D_TexEnv* env = C3D_GetTexEnv(0);
+	C3D_TexEnvSrc(env, C3D_Both, GPU_TEXTURE0, 0, 0);
+	C3D_TexEnvOp(env, C3D_Both, 0, 0, 0);
+	C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
+	C3D_AlphaTest(false, GPU_ALWAYS, 0);
+	C3D_AlphaBlend(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_SRC_ALPHA, GPU_ONE_MINUS_SRC_ALPHA, GPU_SRC_ALPHA, GPU_ONE_MINUS_SRC_ALPHA);
+	C3D_DepthTest(false, GPU_ALWAYS, GPU_WRITE_COLOR);
+	C3D_TexBind(0, &spritesheet_tex);
+}
+
+/* The screens showing the surface rows [y, y+h) */
+static unsigned int rowsScreens(_THIS, int y, int h)
 {
-	return;
+	unsigned int screens = 0;
+	if(y < this->hidden->y1 + this->hidden->h1 && y + h > this->hidden->y1)
+		screens |= SDL_TOPSCR;
+	if(y < this->hidden->y2 + this->hidden->h2 && y + h > this->hidden->y2)
+		screens |= SDL_BOTTOMSCR;
+	return(screens & this->hidden->screens);
+}
+
+/* Draw the screens that changed. citro3d only transfers and swaps the
+   render targets drawn in a frame, so the other screen keeps showing
+   its last picture. */
+static void renderScreens(_THIS)
+{
+	unsigned int screens = this->hidden->screendirty & this->hidden->screens;
+
+	if(!this->hidden->pipelined)
+		N3DS_TIMED(SDL_N3DS_STAGE_VBLANK, gspWaitForVBlank());
+	emitDrawList(this);
+	this->hidden->screendirty = 0;
+	if(!screens) {
+		// still submit the GPU blits recorded into the texture
+		flushFrame(this);
+		N3DS_STATS_FRAME();
+		return;
+	}
+	beginFrame(this);
+	if(this->hidden->screentarget)
+		restoreScreenState();
+
+	if (screens & SDL_TOPSCR) {
+		C3D_FrameDrawOn(VideoSurface1);
+		C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &projection);
+		drawTexture((400-this->hidden->w1*this->hidden->scalex)/2,(240-this->hidden->h1*this->hidden->scaley)/2, this->hidden->w1*this->hidden->scalex, this->hidden->h1*this->hidden->scaley, this->hidden->l1, this->hidden->r1, this->hidden->t1, this->hidden->b1);  
+	}
+	if (screens & SDL_BOTTOMSCR) {
+		C3D_FrameDrawOn(VideoSurface2);
+		C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &projection);
+		drawTexture((400-this->hidden->w2*this->hidden->scalex2)/2,(240-this->hidden->h2*this->hidden->scaley2)/2, this->hidden->w2*this->hidden->scalex2, this->hidden->h2*this->hidden->scaley2, this->hidden->l2, this->hidden->r2, this->hidden->t2, this->hidden->b2);  
+	}
+
+	flushFrame(this);
+	N3DS_STATS_FRAME();
+}
+
+/* Transfer the buffer rows [y, y+h) to the texture, or back with readback.
+   y and h must be multiples of TILE_SIZE. The transfer flips vertically,
+   so the band ends up (texture width * (texture height - y - h)) pixels
+   into the tiled data. A
+   tiled band narrower than the texture is packed as whole tile rows of
+   its own width, so it is then moved one tile row at a time, each one
+   landing at the start of its row of tiles. Without sync the transfer
+   is only queued; the next citro3d frame or transfer waits for it. */
+static void transferBand(_THIS, int y, int h, int readback, int sync)
+{
+	int bpp = this->hidden->byteperpixel;
+	int pitch = this->hidden->bufw*bpp;
+	int texpitch = this->hidden->w*bpp;
+	u32 flags = readback ? readbackTranferFlags[this->hidden->mode] : textureTranferFlags[this->hidden->mode];
+	int step = (this->hidden->bufw == this->hidden->w) ? h : TILE_SIZE;
+	int row;
+
+	for(row = y; row < y + h; row += step) {
+		u8 *buf = (u8 *)this->hidden->buffer + row*pitch;
+		u8 *tex = (u8 *)spritesheet_tex.data + (this->hidden->h - row - step)*texpitch;
+		if(readback)
+			N3DS_TIMED(SDL_N3DS_STAGE_TRANSFER, C3D_SafeDisplayTransfer((u32*)tex, GX_BUFFER_DIM(this->hidden->bufw, step), (u32*)buf, GX_BUFFER_DIM(this->hidden->bufw, step), flags));
+		else
+			N3DS_TIMED(SDL_N3DS_STAGE_TRANSFER, C3D_SafeDisplayTransfer((u32*)buf, GX_BUFFER_DIM(this->hidden->bufw, step), (u32*)tex, GX_BUFFER_DIM(this->hidden->bufw, step), flags));
+	}
+	if(sync) N3DS_TIMED(SDL_N3DS_STAGE_PPF, gspWaitForPPF());
+}
+
+/* Flush and tile-convert the buffer rows [y, y+h) into the texture */
+static void uploadBand(_THIS, int y, int h, int sync)
+{
+	int pitch = this->hidden->bufw*this->hidden->byteperpixel;
+
+	if(this->hidden->gpupalette) {
+		N3DS_TIMED(SDL_N3DS_STAGE_PALETTE, swizzleBand(this, y, h));
+		return;
+	}
+
+	N3DS_TIMED(SDL_N3DS_STAGE_FLUSH, GSPGPU_FlushDataCache((u8 *)this->hidden->buffer + y*pitch, h*pitch));
+	transferBand(this, y, h, 0, sync);
 }
 
 static void drawBuffers(_THIS)
 {
 	if(this->hidden->buffer) {
-		GSPGPU_FlushDataCache(this->hidden->buffer, this->hidden->w*this->hidden->h*this->hidden->byteperpixel);
-
 		C3D_TexBind(0, &spritesheet_tex);
-		C3D_SafeDisplayTransfer ((u32*)this->hidden->buffer, GX_BUFFER_DIM(this->hidden->w, this->hidden->h), (u32*)spritesheet_tex.data, GX_BUFFER_DIM(this->hidden->w, this->hidden->h), textureTranferFlags[this->hidden->mode]);
-		gspWaitForPPF();
+		uploadBand(this, 0, this->hidden->bufh, 1);
+		this->hidden->screencpu = 0;
+		renderScreens(this);
+	}
+}
 
-		gspWaitForVBlank();
-		C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
+/* Pipelined present: queue the transfer of the current buffer and give
+   the app the next one. By the time a buffer comes around again its
+   transfer has finished, since C3D_SafeDisplayTransfer and C3D_FrameBegin
+   wait for the previously queued GPU work. */
+static void drawBuffersPipelined(_THIS, SDL_Surface *surface)
+{
+	if(!this->hidden->buffer) return;
 
-		if (this->hidden->screens & SDL_TOPSCR) {
-			C3D_FrameDrawOn(VideoSurface1);
-			C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &projection);
-			drawTexture((400-this->hidden->w1*this->hidden->scalex)/2,(240-this->hidden->h1*this->hidden->scaley)/2, this->hidden->w1*this->hidden->scalex, this->hidden->h1*this->hidden->scaley, this->hidden->l1, this->hidden->r1, this->hidden->t1, this->hidden->b1);  
-		}
-		if (this->hidden->screens & SDL_BOTTOMSCR) {
-			C3D_FrameDrawOn(VideoSurface2);
-			C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &projection);
-			drawTexture((400-this->hidden->w2*this->hidden->scalex2)/2,(240-this->hidden->h2*this->hidden->scaley2)/2, this->hidden->w2*this->hidden->scalex2, this->hidden->h2*this->hidden->scaley2, this->hidden->l2, this->hidden->r2, this->hidden->t2, this->hidden->b2);  
+	C3D_TexBind(0, &spritesheet_tex);
+	uploadBand(this, 0, this->hidden->bufh, 0);
+	renderScreens(this);
+
+	this->hidden->curbuffer = (this->hidden->curbuffer + 1) % this->hidden->numbuffers;
+	this->hidden->buffer = this->hidden->buffers[this->hidden->curbuffer];
+	if(this->hidden->bpp == 8)
+		this->hidden->stale = 1;
+	else
+		surface->pixels = this->hidden->buffer;
+}
+
+/* Upload only the tile rows touched by the rects, merging nearby bands */
+static void drawBuffersRects(_THIS, int numrects, SDL_Rect *rects)
+{
+	Uint8 dirty[MAX_TILE_ROWS];
+	int tilerows, first, last, i;
+
+	if(!this->hidden->buffer) return;
+
+	tilerows = this->hidden->bufh / TILE_SIZE;
+	SDL_memset(dirty, 0, tilerows);
+	first = tilerows;
+	last = -1;
+	for(i=0; i< numrects; i++) {
+		int y0 = rects[i].y;
+		int y1 = rects[i].y + rects[i].h;
+		if(rects[i].w == 0) continue;
+		if(y0 < 0) y0 = 0;
+		if(y1 > this->info.current_h) y1 = this->info.current_h;
+		if(y0 >= y1) continue;
+		this->hidden->screendirty |= rowsScreens(this, y0, y1 - y0);
+		y0 /= TILE_SIZE;
+		y1 = (y1 + TILE_SIZE - 1) / TILE_SIZE;
+		SDL_memset(&dirty[y0], 1, y1 - y0);
+		if(y0 < first) first = y0;
+		if(y1 > last) last = y1;
+	}
+	if(last < 0) return; // nothing visible changed
+
+	C3D_TexBind(0, &spritesheet_tex);
+	while(first < last) {
+		int end = first + 1;
+		int gap = 0;
+		for(i = end; i < last && gap <= BAND_MERGE_GAP; i++) {
+			if(dirty[i]) {
+				end = i + 1;
+				gap = 0;
+			} else {
+				gap++;
+			}
 		}
+		uploadBand(this, first*TILE_SIZE, (end - first)*TILE_SIZE, 1);
+		for(first = end; first < last && !dirty[first]; first++);
+	}
+	renderScreens(this);
+}
+
+/* Expand a run of 8bpp pixels into the staging buffer */
+static void expandRow(_THIS, int x, int y, int cols)
+{
+	Uint8 *src = (Uint8 *)this->hidden->palettedbuffer + x + y*this->info.current_w;
+	Uint8 *dst = (Uint8 *)this->hidden->buffer + (x + y*this->hidden->bufw)*this->hidden->byteperpixel;
+
+	if(this->hidden->byteperpixel == 2)
+		N3DS_ExpandPal8To16((Uint16 *)dst, src, cols, n3ds_palette16);
+	else
+		N3DS_ExpandPal8To32((Uint32 *)dst, src, cols, n3ds_palette);
+}
+
+/* Rotate a rectangle of the screen surface into the framebuffer, which
+   is fbw (the screen height) pixels wide */
+static void rotateRect(_THIS, u8 *fb, int fbw, int x, int y, int w, int h)
+{
+	int bpp = this->hidden->byteperpixel;
+
+	if ( x < 0 ) { w += x; x = 0; }
+	if ( y < 0 ) { h += y; y = 0; }
+	if ( x + w > this->info.current_w ) w = this->info.current_w - x;
+	if ( y + h > this->info.current_h ) h = this->info.current_h - y;
+	if ( w <= 0 || h <= 0 )
+		return;
+
+	if ( this->hidden->bpp == 8 ) {
+		// palette expansion and rotation in one pass
+		if ( bpp == 2 )
+			N3DS_TIMED(SDL_N3DS_STAGE_ROTATE, N3DS_RotatePal8ToFramebuffer16((Uint16 *)fb, fbw,
+				this->hidden->palettedbuffer, this->info.current_w, x, y, w, h, n3ds_palette16));
+		else
+			N3DS_TIMED(SDL_N3DS_STAGE_ROTATE, N3DS_RotatePal8ToFramebuffer32((Uint32 *)fb, fbw,
+				this->hidden->palettedbuffer, this->info.current_w, x, y, w, h, n3ds_palette));
+	} else {
+		N3DS_TIMED(SDL_N3DS_STAGE_ROTATE, N3DS_RotateToFramebuffer(fb, fbw, this->hidden->buffer,
+			this->hidden->bufw * bpp, bpp, x, y, w, h));
+	}
+	// screen columns are framebuffer rows
+	N3DS_TIMED(SDL_N3DS_STAGE_FLUSH, GSPGPU_FlushDataCache(fb + x * fbw * bpp, w * fbw * bpp));
+}
+
+/* Direct present: copy the rects into the back framebuffer and swap. The
+   back buffer misses what the previous present wrote into the other one,
+   so that is copied again as well. */
+static void presentDirect(_THIS, int numrects, SDL_Rect *rects)
+{
+	SDL_Rect *prev = &this->hidden->directprev;
+	int x1 = this->info.current_w, y1 = this->info.current_h, x2 = 0, y2 = 0;
+	u16 fbw, fbh;
+	u8 *fb;
+	int i;
 
-		C3D_FrameEnd(0);
+	fb = gfxGetFramebuffer(this->hidden->directscreen, GFX_LEFT, &fbw, &fbh);
+	if ( this->hidden->directfull ) {
+		this->hidden->directfull--;
+		rotateRect(this, fb, fbw, 0, 0, this->info.current_w, this->info.current_h);
+		prev->w = this->info.current_w;
+		prev->h = this->info.current_h;
+		prev->x = prev->y = 0;
+	} else {
+		if ( prev->w )
+			rotateRect(this, fb, fbw, prev->x, prev->y, prev->w, prev->h);
+		for ( i = 0; i < numrects; i++ ) {
+			SDL_Rect *rect = &rects[i];
+			if ( rect->w == 0 || rect->h == 0 )
+				continue;
+			rotateRect(this, fb, fbw, rect->x, rect->y, rect->w, rect->h);
+			if ( rect->x < x1 ) x1 = rect->x;
+			if ( rect->y < y1 ) y1 = rect->y;
+			if ( rect->x + rect->w > x2 ) x2 = rect->x + rect->w;
+			if ( rect->y + rect->h > y2 ) y2 = rect->y + rect->h;
+		}
+		if ( x1 < x2 ) {
+			prev->x = x1;
+			prev->y = y1;
+			prev->w = x2 - x1;
+			prev->h = y2 - y1;
+		} else {
+			prev->w = prev->h = 0;
+		}
 	}
+
+	gfxSwapBuffers();
+	// the old front buffer is written by the next present, wait until it is not shown
+	N3DS_TIMED(SDL_N3DS_STAGE_VBLANK, gspWaitForVBlank());
+	N3DS_STATS_FRAME();
 }
 
 static void N3DS_UpdateRects(_THIS, int numrects, SDL_Rect *rects)
 {
+	SDL_Rect full;
+
 	if(this->hidden->exiting) return; //Block video output on SDL_QUIT
 
-	if( this->hidden->bpp == 8) {
+	if(this->hidden->direct) {
+		presentDirect(this, numrects, rects);
+		return;
+	}
+
+	if(this->hidden->screengpu && !this->hidden->screencpu) {
+		// only the GPU drew since the last update, the texture is already current
+		int i;
+		for(i=0; i< numrects; i++) {
+			if(rects[i].w && rects[i].h)
+				this->hidden->screendirty |= rowsScreens(this, rects[i].y, rects[i].h);
+		}
+		renderScreens(this);
+		return;
+	}
+
+	if(this->hidden->stale) {
+		// the staging buffer we rotated to is missing the frames drawn since, expand all of it
+		full.x = 0;
+		full.y = 0;
+		full.w = this->info.current_w;
+		full.h = this->info.current_h;
+		numrects = 1;
+		rects = &full;
+		this->hidden->stale = 0;
+	}
+
+	if( this->hidden->bpp == 8 && !this->hidden->gpupalette) {
 
 		int i;
 		for(i=0; i< numrects; i++) {
 			SDL_Rect *rect = &rects[i];
-			Uint8 *src_addr, *dst_addr, *src_baseaddr, *dst_baseaddr;
 			int cols, rows;
-			int x,y;
-			src_baseaddr = this->hidden->palettedbuffer;
-			dst_baseaddr = this->hidden->buffer;
+			int y;
 			cols = (rect->x + rect->w > this->info.current_w) ? this->info.current_w - rect->x : rect->w;
 			rows = (rect->y + rect->h > this->info.current_h) ? this->info.current_h - rect->y : rect->h;
-			for(y=0;y<rows;y++) {
-			  x = 0;
-			  src_addr = src_baseaddr + rect->x + x + (rect->y + y) * this->info.current_w;
-			  dst_addr = dst_baseaddr + (rect->x + x + (rect->y + y) * this->hidden->w) * 4;
-			  for(;x<cols;x++) {
-				*(u32*)dst_addr=n3ds_palette[*(Uint8 *)src_addr];
-				src_addr++;
-				dst_addr += 4;
-			  }
-			}
-		} 
-/*
-		Uint8 *src_addr, *dst_addr, *dst_baseaddr;
-		src_addr = this->hidden->palettedbuffer;
-		dst_baseaddr = this->hidden->buffer;
-		int x,y;
-		for(y=0;y<this->info.current_h;y++) {
-  		  dst_addr = dst_baseaddr + y*this->hidden->w*4;
-		  for(x=0;x<this->info.current_w;x++) {
-			*(u32*)dst_addr=n3ds_palette[*(Uint8 *)src_addr];
-			src_addr++;
-			dst_addr += 4;
-		  }
+			N3DS_TIMED(SDL_N3DS_STAGE_PALETTE,
+				for(y=0;y<rows;y++)
+					expandRow(this, rect->x, rect->y + y, cols));
 		}
-*/	
 	}
 
-	drawBuffers(this);
+	drawBuffersRects(this, numrects, rects);
 }
 
 #define N3DS_MAP_RGB(r, g, b)	((Uint32)r << 24 | (Uint32)g << 16 | (Uint32)b << 8 | 0xff)
+#define N3DS_MAP_RGB565(r, g, b)	((Uint16)(((r) & 0xf8) << 8 | ((g) & 0xfc) << 3 | (b) >> 3))
 
 static int N3DS_SetColors(_THIS, int firstcolor, int ncolors, SDL_Color *colors)
 {
 	int i;
-	for ( i = firstcolor; i < firstcolor + ncolors; ++i )
-		n3ds_palette[i] = N3DS_MAP_RGB(colors[i].r, colors[i].g, colors[i].b);
+	for ( i = 0; i < ncolors; ++i )
+	{
+		n3ds_palette[firstcolor + i] = N3DS_MAP_RGB(colors[i].r, colors[i].g, colors[i].b);
+		n3ds_palette16[firstcolor + i] = N3DS_MAP_RGB565(colors[i].r, colors[i].g, colors[i].b);
+	}
+	if ( this->hidden->gpupalette ) {
+		paletteLoad(firstcolor, ncolors, colors);
+		// the lookup applies to the whole texture
+		this->hidden->screendirty = this->hidden->screens;
+	}
 	return(1);
 }
 
@@ -541,40 +1210,694 @@ static int N3DS_FlipHWSurface (_THIS, SDL_Surface *surface) {
 
 	if(this->hidden->exiting) return (0); //Block video output on SDL_QUIT
 
-	if( this->hidden->bpp == 8) {
-		Uint8 *src_addr, *dst_addr, *dst_baseaddr;
-		src_addr = this->hidden->palettedbuffer;
-		dst_baseaddr = this->hidden->buffer;
-		int x,y;
-		for(y=0;y<this->info.current_h;y++) {
-  		  dst_addr = dst_baseaddr + y*this->hidden->w*4;
-		  for(x=0;x<this->info.current_w;x++) {
-			*(u32*)dst_addr=n3ds_palette[*(Uint8 *)src_addr];
-			src_addr++;
-			dst_addr += 4;
-		  }
-		}
+	if(this->hidden->direct) {
+		SDL_Rect full;
+		full.x = full.y = 0;
+		full.w = this->info.current_w;
+		full.h = this->info.current_h;
+		presentDirect(this, 1, &full);
+		return (0);
 	}
 
-	drawBuffers(this);
+	this->hidden->screendirty = this->hidden->screens;
+	if(this->hidden->screengpu && !this->hidden->screencpu) {
+		renderScreens(this);
+		return (0);
+	}
+
+	if( this->hidden->bpp == 8 && !this->hidden->gpupalette) {
+		int y;
+		N3DS_TIMED(SDL_N3DS_STAGE_PALETTE,
+			for(y=0;y<this->info.current_h;y++)
+				expandRow(this, 0, y, this->info.current_w));
+		this->hidden->stale = 0;
+	}
+
+	if(this->hidden->numbuffers > 1)
+		drawBuffersPipelined(this, surface);
+	else
+		drawBuffers(this);
 
 	return (0);
 }
 
+/* Hardware surfaces */
+
+static const struct N3DS_HWFormat *hwFormat(SDL_PixelFormat *format)
+{
+	int i;
+	for ( i = 0; i < SDL_arraysize(hwformats); i++ ) {
+		if ( format->BitsPerPixel == hwformats[i].bpp &&
+		     format->Rmask == hwformats[i].Rmask &&
+		     format->Gmask == hwformats[i].Gmask &&
+		     format->Bmask == hwformats[i].Bmask )
+			return &hwformats[i];
+	}
+	return NULL;
+}
+
+static int hwTexInit(struct private_hwdata *hwdata, GPU_TEXCOLOR fmt)
+{
+	// VRAM is faster to sample from, linear memory is the fallback
+	if ( C3D_TexInitVRAM(&hwdata->tex, hwdata->tw, hwdata->th, fmt) ||
+	     C3D_TexInit(&hwdata->tex, hwdata->tw, hwdata->th, fmt) ) {
+		C3D_TexSetFilter(&hwdata->tex, GPU_NEAREST, GPU_NEAREST);
+		return(1);
+	}
+	return(0);
+}
+
+static int N3DS_AllocHWSurface(_THIS, SDL_Surface *surface)
+{
+	const struct N3DS_HWFormat *format;
+	struct private_hwdata *hwdata;
+	int size;
+
+	if ( ! this->hidden->hwaccel )
+		return(-1);
+	format = hwFormat(surface->format);
+	if ( ! format || surface->w > TEX_MAX_SIZE || surface->h > TEX_MAX_SIZE )
+		return(-1);
+
+	hwdata = (struct private_hwdata *)SDL_malloc(sizeof *hwdata);
+	if ( ! hwdata ) {
+		SDL_OutOfMemory();
+		return(-1);
+	}
+	SDL_memset(hwdata, 0, sizeof *hwdata);
+	hwdata->format = format;
+	hwdata->tw = next_pow2(surface->w);
+	hwdata->th = next_pow2(surface->h);
+	if ( ! hwTexInit(hwdata, format->texfmt) ) {
+		SDL_free(hwdata);
+		return(-1);
+	}
+
+	// the pitch is the texture width, so the whole surface is uploaded by one transfer
+	size = hwdata->tw * hwdata->th * surface->format->BytesPerPixel;
+	surface->pixels = linearAlloc(size);
+	if ( ! surface->pixels ) {
+		C3D_TexDelete(&hwdata->tex);
+		SDL_free(hwdata);
+		return(-1);
+	}
+	SDL_memset(surface->pixels, 0, size);
+	surface->pitch = hwdata->tw * surface->format->BytesPerPixel;
+	hwdata->dirty = 1;
+	hwdata->usedframe = this->hidden->frameserial - 2;
+	surface->hwdata = hwdata;
+	surface->flags |= SDL_HWSURFACE;
+	return(0);
+}
+
+/* Delete a texture last sampled in frame 'usedframe'. If that frame may
+   still be running, or is still being recorded, it is deleted when the
+   next frame begins, so the frame isn't submitted early. */
+static void freeTexture(_THIS, C3D_Tex *tex, Uint32 usedframe)
+{
+	if ( this->hidden->frameserial - usedframe < 2 ) {
+		if ( this->hidden->numfreedtex == this->hidden->maxfreedtex ) {
+			int max = this->hidden->maxfreedtex ? this->hidden->maxfreedtex * 2 : 16;
+			struct N3DS_FreedTex *freedtex = (struct N3DS_FreedTex *)SDL_realloc(this->hidden->freedtex, max * sizeof(*freedtex));
+			if ( freedtex ) {
+				this->hidden->freedtex = freedtex;
+				this->hidden->maxfreedtex = max;
+			}
+		}
+		if ( this->hidden->numfreedtex < this->hidden->maxfreedtex ) {
+			struct N3DS_FreedTex *freed = &this->hidden->freedtex[this->hidden->numfreedtex++];
+			freed->tex = *tex;
+			freed->usedframe = usedframe;
+			return;
+		}
+		// the list can't grow, wait for the GPU
+		N3DS_ReleaseTexture(this, usedframe);
+	}
+	C3D_TexDelete(tex);
+}
+
+static void N3DS_FreeHWSurface(_THIS, SDL_Surface *surface)
+{
+	struct private_hwdata *hwdata = surface->hwdata;
+
+	if ( ! hwdata )
+		return;
+	// the draw list points at the texture
+	if ( this->hidden->numdrawops && hwdata->usedframe == this->hidden->frameserial )
+		emitDrawList(this);
+	freeTexture(this, &hwdata->tex, hwdata->usedframe);
+	if ( hwdata->keybuf )
+		linearFree(hwdata->keybuf);
+	linearFree(surface->pixels);
+	SDL_free(hwdata);
+	surface->pixels = NULL;
+	surface->hwdata = NULL;
+}
+
+/* Read the GPU drawing back into the screen buffer */
+static void screenToBuffer(_THIS)
+{
+	int size = this->hidden->bufw * this->hidden->bufh * this->hidden->byteperpixel;
+
+	if ( ! this->hidden->screengpu )
+		return;
+	flushFrame(this);
+	transferBand(this, 0, this->hidden->bufh, 1, 1);
+	GSPGPU_InvalidateDataCache(this->hidden->buffer, size);
+	this->hidden->screengpu = 0;
+}
+
+/* Make the screen texture current before the GPU draws into it. Unless
+   the texture is known to be newer, the buffer may have been written
+   without a lock, so it is uploaded. */
+static void screenToTexture(_THIS)
+{
+	if ( this->hidden->screencpu || ! this->hidden->screengpu ) {
+		flushFrame(this);
+		uploadBand(this, 0, this->hidden->bufh, 1);
+		this->hidden->screencpu = 0;
+	}
+	this->hidden->screengpu = 1;
+}
+
+static int N3DS_LockHWSurface(_THIS, SDL_Surface *surface)
+{
+	if ( surface == this->screen && this->hidden->screentarget )
+		screenToBuffer(this);
+	return(0);
+}
+
+static void N3DS_UnlockHWSurface(_THIS, SDL_Surface *surface)
+{
+	if ( surface == this->screen )
+		this->hidden->screencpu = 1;
+	else if ( surface->hwdata )
+		surface->hwdata->dirty = 1;
+}
+
+/* Build the colorkeyed copy of a surface, alpha is 0 where the key is */
+static void applyColorKey(SDL_Surface *surface)
+{
+	struct private_hwdata *hwdata = surface->hwdata;
+	Uint32 rgbmask = ~surface->format->Amask;
+	Uint32 key = surface->format->colorkey & rgbmask;
+	int x, y;
+
+	for ( y = 0; y < surface->h; y++ ) {
+		Uint8 *src = (Uint8 *)surface->pixels + y * surface->pitch;
+		Uint8 *dst = (Uint8 *)hwdata->keybuf + y * hwdata->tw * hwdata->format->keybpp;
+		switch ( hwdata->format->bpp ) {
+			case 32:
+				for ( x = 0; x < surface->w; x++ ) {
+					Uint32 p = ((Uint32 *)src)[x];
+					((Uint32 *)dst)[x] = (p & 0xffffff00) | (((p & rgbmask) == key) ? 0 : 0xff);
+				}
+				break;
+			case 24:
+				for ( x = 0; x < surface->w; x++, src += 3 ) {
+					Uint32 p = src[0] | (src[1] << 8) | (src[2] << 16);
+					((Uint32 *)dst)[x] = (p << 8) | ((p == key) ? 0 : 0xff);
+				}
+				break;
+			default:
+				for ( x = 0; x < surface->w; x++ ) {
+					Uint16 p = ((Uint16 *)src)[x];
+					Uint16 a = ((p & rgbmask) == key) ? 0 : 1;
+					switch ( hwdata->format->texfmt ) {
+						case GPU_RGB565:
+							p = (p & 0xffc0) | ((p & 0x1f) << 1);
+							break;
+						case GPU_RGBA4:
+							p &= 0xfff0;
+							a *= 0xf;
+							break;
+						default:
+							p &= 0xfffe;
+							break;
+					}
+					((Uint16 *)dst)[x] = p | a;
+				}
+				break;
+		}
+	}
+}
+
+/* Refresh the texture of a surface from its pixels */
+static int uploadSurface(_THIS, SDL_Surface *surface)
+{
+	struct private_hwdata *hwdata = surface->hwdata;
+	const struct N3DS_HWFormat *format = hwdata->format;
+	// per-pixel alpha takes over the colorkey, as in the software blitters
+	int keyed = (surface->flags & SDL_SRCCOLORKEY) &&
+	            !((surface->flags & SDL_SRCALPHA) && surface->format->Amask);
+	void *src;
+	int size;
+
+	if ( keyed != hwdata->keyed ) {
+		if ( keyed && ! hwdata->keybuf ) {
+			hwdata->keybuf = linearAlloc(hwdata->tw * hwdata->th * format->keybpp);
+			if ( ! hwdata->keybuf ) {
+				SDL_OutOfMemory();
+				return(-1);
+			}
+			SDL_memset(hwdata->keybuf, 0, hwdata->tw * hwdata->th * format->keybpp);
+		}
+		if ( format->keytexfmt != format->texfmt ) {
+			// a new texture, the frames sampling the old one keep it
+			if ( this->hidden->numdrawops && hwdata->usedframe == this->hidden->frameserial )
+				emitDrawList(this);
+			freeTexture(this, &hwdata->tex, hwdata->usedframe);
+			hwdata->usedframe = this->hidden->frameserial - 2;
+			if ( ! hwTexInit(hwdata, keyed ? format->keytexfmt : format->texfmt) ) {
+				SDL_SetError("Couldn't allocate texture for surface");
+				return(-1);
+			}
+		}
+		hwdata->keyed = keyed;
+		hwdata->dirty = 1;
+	}
+	if ( ! hwdata->dirty )
+		return(0);
+
+	// the open frame may still sample the old texture
+	if ( framePending(this) && hwdata->usedframe == this->hidden->frameserial )
+		flushFrame(this);
+
+	if ( keyed ) {
+		applyColorKey(surface);
+		src = hwdata->keybuf;
+		size = hwdata->tw * hwdata->th * format->keybpp;
+	} else {
+		src = surface->pixels;
+		size = hwdata->tw * hwdata->th * surface->format->BytesPerPixel;
+	}
+	GSPGPU_FlushDataCache(src, size);
+	C3D_SafeDisplayTransfer((u32*)src, GX_BUFFER_DIM(hwdata->tw, hwdata->th),
+		(u32*)hwdata->tex.data, GX_BUFFER_DIM(hwdata->tw, hwdata->th),
+		HWSURFACE_TRANSFER_FLAGS(keyed ? format->keytransferfmt : format->transferfmt));
+	gspWaitForPPF();
+	hwdata->dirty = 0;
+	return(0);
+}
+
+/* Start drawing into the screen texture */
+static void beginScreenDraw(_THIS)
+{
+	beginFrame(this);
+	C3D_FrameDrawOn(this->hidden->screentarget);
+	C3D_FVUnifMtx4x4(GPU_VERTEX_SHADER, uLoc_projection, &texprojection);
+	C3D_DepthTest(false, GPU_ALWAYS, GPU_WRITE_COLOR);
+}
+
+static void setDrawState(const struct N3DS_DrawState *state)
+{
+	C3D_TexEnv* env = C3D_GetTexEnv(0);
+
+	C3D_TexEnvOp(env, C3D_Both, 0, 0, 0);
+	switch ( state->mode ) {
+		case DRAW_FILL:
+			C3D_TexEnvSrc(env, C3D_Both, GPU_CONSTANT, 0, 0);
+			C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
+			C3D_TexEnvColor(env, state->color);
+			C3D_AlphaBlend(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_ONE, GPU_ZERO, GPU_ONE, GPU_ZERO);
+			break;
+		case DRAW_PIXELALPHA:
+			C3D_TexEnvSrc(env, C3D_Both, GPU_TEXTURE0, 0, 0);
+			C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
+			C3D_AlphaBlend(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_SRC_ALPHA, GPU_ONE_MINUS_SRC_ALPHA, GPU_ZERO, GPU_ONE);
+			break;
+		case DRAW_SURFACEALPHA:
+			// per-surface alpha, times the colorkey mask when there is one
+			C3D_TexEnvSrc(env, C3D_RGB, GPU_TEXTURE0, 0, 0);
+			C3D_TexEnvFunc(env, C3D_RGB, GPU_REPLACE);
+			C3D_TexEnvSrc(env, C3D_Alpha, state->keyed ? GPU_TEXTURE0 : GPU_CONSTANT, GPU_CONSTANT, 0);
+			C3D_TexEnvFunc(env, C3D_Alpha, state->keyed ? GPU_MODULATE : GPU_REPLACE);
+			C3D_TexEnvColor(env, state->color);
+			C3D_AlphaBlend(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_SRC_ALPHA, GPU_ONE_MINUS_SRC_ALPHA, GPU_ZERO, GPU_ONE);
+			break;
+		default:
+			// plain copy, alpha included
+			C3D_TexEnvSrc(env, C3D_Both, GPU_TEXTURE0, 0, 0);
+			C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
+			C3D_AlphaBlend(GPU_BLEND_ADD, GPU_BLEND_ADD, GPU_ONE, GPU_ZERO, GPU_ONE, GPU_ZERO);
+			break;
+	}
+	// the colorkey is in the texture alpha, keyed texels are dropped
+	C3D_AlphaTest(state->keyed, GPU_GREATER, 0);
+	if ( state->tex )
+		C3D_TexBind(0, state->tex);
+}
+
+static int sameDrawState(const struct N3DS_DrawState *a, const struct N3DS_DrawState *b)
+{
+	return(a->tex == b->tex && a->mode == b->mode && a->keyed == b->keyed && a->color == b->color);
+}
+
+static int batchOverlaps(const struct N3DS_DrawBatch *batch, int x1, int y1, int x2, int y2)
+{
+	return(x1 < batch->x2 && batch->x1 < x2 && y1 < batch->y2 && batch->y1 < y2);
+}
+
+/* Add a quad to the draw list, returns -1 if the list can't grow */
+static int recordQuad(_THIS, const struct N3DS_DrawState *state, int x, int y, int w, int h,
+                      float left, float right, float top, float bottom)
+{
+	struct N3DS_DrawBatch *batch = NULL;
+	struct N3DS_DrawOp *op;
+	int i;
+
+	// look back for a batch with this state that nothing recorded since overlaps
+	for ( i = this->hidden->numbatches - 1; i >= 0; i-- ) {
+		if ( sameDrawState(&this->hidden->batches[i].state, state) ) {
+			batch = &this->hidden->batches[i];
+			break;
+		}
+		if ( batchOverlaps(&this->hidden->batches[i], x, y, x + w, y + h) )
+			break;
+	}
+
+	if ( this->hidden->numdrawops == this->hidden->maxdrawops ) {
+		int max = this->hidden->maxdrawops ? this->hidden->maxdrawops * 2 : 256;
+		struct N3DS_DrawOp *ops = (struct N3DS_DrawOp *)SDL_realloc(this->hidden->drawops, max * sizeof(*ops));
+		if ( ! ops )
+			return(-1);
+		this->hidden->drawops = ops;
+		this->hidden->maxdrawops = max;
+	}
+	if ( ! batch ) {
+		if ( this->hidden->numbatches == this->hidden->maxbatches ) {
+			int max = this->hidden->maxbatches ? this->hidden->maxbatches * 2 : 32;
+			struct N3DS_DrawBatch *batches = (struct N3DS_DrawBatch *)SDL_realloc(this->hidden->batches, max * sizeof(*batches));
+			if ( ! batches )
+				return(-1);
+			this->hidden->batches = batches;
+			this->hidden->maxbatches = max;
+		}
+		i = this->hidden->numbatches++;
+		batch = &this->hidden->batches[i];
+		batch->state = *state;
+		batch->count = 0;
+		batch->x1 = x;
+		batch->y1 = y;
+		batch->x2 = x + w;
+		batch->y2 = y + h;
+	}
+
+	op = &this->hidden->drawops[this->hidden->numdrawops++];
+	op->batch = i;
+	op->x = x;
+	op->y = y;
+	op->w = w;
+	op->h = h;
+	op->left = left;
+	op->right = right;
+	op->top = top;
+	op->bottom = bottom;
+	batch->count++;
+	if ( x < batch->x1 ) batch->x1 = x;
+	if ( y < batch->y1 ) batch->y1 = y;
+	if ( x + w > batch->x2 ) batch->x2 = x + w;
+	if ( y + h > batch->y2 ) batch->y2 = y + h;
+	return(0);
+}
+
+static void putVertex(struct N3DS_Vertex *v, float x, float y, float u, float t)
+{
+	v->x = x;
+	v->y = y;
+	v->z = 0.5f;
+	v->u = u;
+	v->v = t;
+}
+
+/* Draw the recorded quads: one vertex buffer, one draw call per batch */
+static void emitDrawList(_THIS)
+{
+	struct N3DS_Vertex *vbo;
+	C3D_BufInfo* bufInfo;
+	int size, first, i;
+
+	if ( ! this->hidden->numdrawops )
+		return;
+
+	// C3D_FrameBegin waits for the previous frame, so the vertex buffer is free again
+	beginScreenDraw(this);
+	size = this->hidden->numdrawops * 6 * sizeof(struct N3DS_Vertex);
+	if ( this->hidden->vboused && this->hidden->vboused + size > this->hidden->vbosize ) {
+		// a list emitted earlier in this frame is still read from the buffer:
+		// submit it, C3D_FrameBegin waits for it. The serial isn't advanced,
+		// the textures of this list are used by the frame that follows.
+		N3DS_TIMED(SDL_N3DS_STAGE_FRAMEEND, C3D_FrameEnd(0));
+		this->hidden->inframe = 0;
+		beginScreenDraw(this);
+	}
+	if ( size > this->hidden->vbosize ) {
+		if ( this->hidden->vbo )
+			linearFree(this->hidden->vbo);
+		this->hidden->vbosize = size * 2;
+		this->hidden->vbo = linearAlloc(this->hidden->vbosize);
+		if ( ! this->hidden->vbo )
+			this->hidden->vbosize = 0;
+	}
+	vbo = (struct N3DS_Vertex *)this->hidden->vbo;
+
+	if ( ! vbo ) {
+		// out of linear memory, draw the quads one by one in recorded order
+		for ( i = 0; i < this->hidden->numdrawops; i++ ) {
+			struct N3DS_DrawOp *op = &this->hidden->drawops[i];
+			setDrawState(&this->hidden->batches[op->batch].state);
+			drawTexture(op->x, op->y, op->w, op->h, op->left, op->right, op->top, op->bottom);
+		}
+		this->hidden->numdrawops = 0;
+		this->hidden->numbatches = 0;
+		return;
+	}
+
+	// after the lists emitted earlier in this frame
+	first = this->hidden->vboused / sizeof(struct N3DS_Vertex);
+	for ( i = 0; i < this->hidden->numbatches; i++ ) {
+		this->hidden->batches[i].first = first;
+		first += this->hidden->batches[i].count * 6;
+	}
+	// two triangles per quad, the quads of a batch are contiguous and keep their order
+	for ( i = 0; i < this->hidden->numdrawops; i++ ) {
+		struct N3DS_DrawOp *op = &this->hidden->drawops[i];
+		struct N3DS_DrawBatch *batch = &this->hidden->batches[op->batch];
+		struct N3DS_Vertex *v = vbo + batch->first;
+		batch->first += 6;
+		putVertex(&v[0], op->x, op->y, op->left, op->top);
+		putVertex(&v[1], op->x, op->y + op->h, op->left, op->bottom);
+		putVertex(&v[2], op->x + op->w, op->y, op->right, op->top);
+		v[3] = v[2];
+		v[4] = v[1];
+		putVertex(&v[5], op->x + op->w, op->y + op->h, op->right, op->bottom);
+	}
+	GSPGPU_FlushDataCache((Uint8 *)vbo + this->hidden->vboused, size);
+	this->hidden->vboused += size;
+
+	bufInfo = C3D_GetBufInfo();
+	BufInfo_Init(bufInfo);
+	BufInfo_Add(bufInfo, vbo, sizeof(struct N3DS_Vertex), 2, 0x10);
+	for ( i = 0; i < this->hidden->numbatches; i++ ) {
+		struct N3DS_DrawBatch *batch = &this->hidden->batches[i];
+		setDrawState(&batch->state);
+		C3D_DrawArrays(GPU_TRIANGLES, batch->first - batch->count * 6, batch->count * 6);
+	}
+
+	this->hidden->numdrawops = 0;
+	this->hidden->numbatches = 0;
+}
+
+/* Draw a quad into the screen texture, now or when the frame is presented */
+static void drawScreenQuad(_THIS, const struct N3DS_DrawState *state, int x, int y, int w, int h,
+                           float left, float right, float top, float bottom)
+{
+	// the texture must hold what the CPU drew before this quad
+	screenToTexture(this);
+	if ( this->hidden->batching ) {
+		if ( recordQuad(this, state, x, y, w, h, left, right, top, bottom) == 0 )
+			return;
+		// the list can't grow, draw what it has and this quad right away
+		emitDrawList(this);
+	}
+	beginScreenDraw(this);
+	setDrawState(state);
+	drawTexture(x, y, w, h, left, right, top, bottom);
+}
+
+/* Draw a texture scaled into a rectangle of the screen, for the YUV overlays */
+void N3DS_DrawScreenTexture(_THIS, C3D_Tex *tex, SDL_Rect *dst,
+                            float left, float right, float top, float bottom)
+{
+	struct N3DS_DrawState state;
+
+	state.tex = tex;
+	state.mode = DRAW_COPY;
+	state.keyed = 0;
+	state.color = 0;
+	drawScreenQuad(this, &state, dst->x, dst->y, dst->w, dst->h, left, right, top, bottom);
+}
+
+/* Wait until the GPU is done with a texture last sampled in frame 'usedframe',
+   before it is written by something outside the GX queue or freed */
+void N3DS_ReleaseTexture(_THIS, Uint32 usedframe)
+{
+	if ( framePending(this) && usedframe == this->hidden->frameserial )
+		flushFrame(this);
+	if ( usedframe + 1 == this->hidden->frameserial ) {
+		// the last frame may still be running, C3D_FrameBegin waits for it
+		beginFrame(this);
+	}
+}
+
+static int N3DS_CheckHWBlit(_THIS, SDL_Surface *src, SDL_Surface *dst)
+{
+	// only blits into the screen; the screen can't be sampled while drawn into
+	src->flags &= ~SDL_HWACCEL;
+	if ( ! this->hidden->hwaccel || ! src->hwdata || dst != this->screen )
+		return(0);
+	src->flags |= SDL_HWACCEL;
+	src->map->hw_blit = N3DS_HWAccelBlit;
+	return(1);
+}
+
+static int N3DS_HWAccelBlit(SDL_Surface *src, SDL_Rect *srcrect,
+                            SDL_Surface *dst, SDL_Rect *dstrect)
+{
+	SDL_VideoDevice *this = current_video;
+	struct private_hwdata *hwdata = src->hwdata;
+	struct N3DS_DrawState state;
+	float tw = hwdata->tw, th = hwdata->th;
+
+	if ( this->hidden->exiting )
+		return(0);
+	if ( uploadSurface(this, src) < 0 )
+		return(-1);
+
+	state.tex = &hwdata->tex;
+	state.keyed = hwdata->keyed;
+	state.color = 0;
+	if ( (src->flags & SDL_SRCALPHA) && src->format->Amask ) {
+		state.mode = DRAW_PIXELALPHA;
+	} else if ( src->flags & SDL_SRCALPHA ) {
+		state.mode = DRAW_SURFACEALPHA;
+		state.color = (Uint32)src->format->alpha << 24 | 0xffffff;
+	} else {
+		state.mode = DRAW_COPY;
+	}
+
+	drawScreenQuad(this, &state, dstrect->x, dstrect->y, srcrect->w, srcrect->h,
+		srcrect->x / tw, (srcrect->x + srcrect->w) / tw,
+		srcrect->y / th, (srcrect->y + srcrect->h) / th);
+	hwdata->usedframe = this->hidden->frameserial;
+	return(0);
+}
+
+static int N3DS_FillHWRect(_THIS, SDL_Surface *dst, SDL_Rect *rect, Uint32 color)
+{
+	if ( dst == this->screen ) {
+		struct N3DS_DrawState state;
+		Uint8 r, g, b, a;
+
+		if ( this->hidden->exiting )
+			return(0);
+		SDL_GetRGBA(color, dst->format, &r, &g, &b, &a);
+		state.tex = NULL;
+		state.mode = DRAW_FILL;
+		state.keyed = 0;
+		state.color = (Uint32)a << 24 | (Uint32)b << 16 | (Uint32)g << 8 | r;
+		drawScreenQuad(this, &state, rect->x, rect->y, rect->w, rect->h, 0.0f, 0.0f, 0.0f, 0.0f);
+		return(0);
+	}
+
+	if ( dst->hwdata ) {
+		// offscreen surfaces are filled by the CPU, they are uploaded when blitted
+		int x, y;
+		for ( y = rect->y; y < rect->y + rect->h; y++ ) {
+			Uint8 *row = (Uint8 *)dst->pixels + y * dst->pitch;
+			switch ( dst->format->BytesPerPixel ) {
+				case 4:
+					SDL_memset4(row + rect->x * 4, color, rect->w);
+					break;
+				case 3:
+					for ( x = rect->x; x < rect->x + rect->w; x++ ) {
+						row[x * 3] = (Uint8)color;
+						row[x * 3 + 1] = (Uint8)(color >> 8);
+						row[x * 3 + 2] = (Uint8)(color >> 16);
+					}
+					break;
+				default:
+					for ( x = rect->x; x < rect->x + rect->w; x++ )
+						((Uint16 *)row)[x] = (Uint16)color;
+					break;
+			}
+		}
+		dst->hwdata->dirty = 1;
+		return(0);
+	}
+
+	return(-1);
+}
+
+static int N3DS_SetHWColorKey(_THIS, SDL_Surface *surface, Uint32 key)
+{
+	if ( ! surface->hwdata )
+		return(-1);
+	// rebuilt by the next blit
+	surface->hwdata->dirty = 1;
+	return(0);
+}
+
+static int N3DS_SetHWAlpha(_THIS, SDL_Surface *surface, Uint8 value)
+{
+	// applied by the combiner at blit time
+	return(surface->hwdata ? 0 : -1);
+}
+
 /* Note:  If we are terminated, this could be called in the middle of
    another SDL video routine -- notably UpdateRects.
 */
 void N3DS_VideoQuit(_THIS)
 {
-	if (this->hidden->buffer)
-	{
-		linearFree(this->hidden->buffer);
-		this->hidden->buffer = NULL;
+	N3DS_StopInputThread(this);
+	flushFrame(this);
+	if (this->hidden->numfreedtex) {
+		// beginFrame waits for the last frame and deletes them
+		beginFrame(this);
+		flushFrame(this);
+	}
+	SDL_free(this->hidden->freedtex);
+	this->hidden->freedtex = NULL;
+	this->hidden->maxfreedtex = 0;
+	if (this->hidden->vbo) {
+		linearFree(this->hidden->vbo);
+		this->hidden->vbo = NULL;
+		this->hidden->vbosize = 0;
 	}
+	SDL_free(this->hidden->drawops);
+	this->hidden->drawops = NULL;
+	this->hidden->maxdrawops = 0;
+	SDL_free(this->hidden->batches);
+	this->hidden->batches = NULL;
+	this->hidden->maxbatches = 0;
+	if (this->hidden->screentarget) {
+		C3D_RenderTargetDelete(this->hidden->screentarget);
+		this->hidden->screentarget = NULL;
+	}
+	freeBuffers(this);
 	if (this->hidden->palettedbuffer)
 	{
-		linearFree(this->hidden->palettedbuffer);
+		free(this->hidden->palettedbuffer);
 		this->hidden->palettedbuffer = NULL;
+		this->hidden->palettedsize = 0;
+	}
+	/* The screen pixels were one of the buffers, SDL_VideoQuit mustn't free them again */
+	if (this->screen) {
+		this->screen->pixels = NULL;
+	}
+	if (spritesheet_tex.data) {
+		C3D_TexDelete(&spritesheet_tex);
+		spritesheet_tex.data = NULL;
 	}
 	sceneExit();
 	C3D_Fini();
@@ -584,7 +1907,7 @@ void N3DS_VideoQuit(_THIS)
 
 
 //---------------------------------------------------------------------------------
-static void sceneInit(GSPGPU_FramebufferFormats mode) {
+static void sceneInit(void) {
 //---------------------------------------------------------------------------------
 	// Load the vertex shader, create a shader program and bind it
 	vshader_dvlb = DVLB_ParseFile((u32*)vshader_shbin, vshader_shbin_size);
@@ -611,25 +1934,6 @@ static void sceneInit(GSPGPU_FramebufferFormats mode) {
 	C3D_BufInfo* bufInfo = C3D_GetBufInfo();
 	BufInfo_Init(bufInfo);
 
-	if (mode<=1) {
-		gfxSetScreenFormat(GFX_TOP, GSP_BGR8_OES);
-		gfxSetScreenFormat(GFX_BOTTOM, GSP_BGR8_OES);
-	} else	{
-		gfxSetScreenFormat(GFX_TOP, GSP_RGB565_OES);
-		gfxSetScreenFormat(GFX_BOTTOM, GSP_RGB565_OES);
-	}
-
-
-	// Initialize the top screen render target
-	VideoSurface1 = C3D_RenderTargetCreate(240, 400, mode, GPU_RB_DEPTH24_STENCIL8);
-	C3D_RenderTargetSetClear(VideoSurface1, C3D_CLEAR_ALL, clearcolors[mode], 0);
-	C3D_RenderTargetSetOutput(VideoSurface1, GFX_TOP, GFX_LEFT, displayTranferFlags[mode]);
-
-	// Initialize the bottom screen render target
-	VideoSurface2 = C3D_RenderTargetCreate(240, 320, mode, GPU_RB_DEPTH24_STENCIL8);
-	C3D_RenderTargetSetClear(VideoSurface2, C3D_CLEAR_ALL, clearcolors[mode], 0);
-	C3D_RenderTargetSetOutput(VideoSurface2, GFX_BOTTOM, GFX_LEFT, displayTranferFlags[mode]);
-
 	// Configure the first fragment shading substage to just pass through the texture color
 	// See https://www.opengl.org/sdk/docs/man2/xhtml/glTexEnv.xml for more insight
 	C3D_TexEnv* env = C3D_GetTexEnv(0);
@@ -638,8 +1942,36 @@ static void sceneInit(GSPGPU_FramebufferFormats mode) {
 	C3D_TexEnvOp(env, C3D_Both, 0, 0, 0);
 	C3D_TexEnvFunc(env, C3D_Both, GPU_REPLACE);
 
-	// Configure depth test to overwrite pixels with the same depth (needed to draw overlapping sprites)
-//	C3D_DepthTest(true, GPU_GEQUAL, GPU_WRITE_ALL);
+	// Everything is 2D quads drawn in order, there are no depth buffers
+	C3D_DepthTest(false, GPU_ALWAYS, GPU_WRITE_COLOR);
+}
+
+//---------------------------------------------------------------------------------
+static void sceneSetMode(GSPGPU_FramebufferFormats mode) {
+//---------------------------------------------------------------------------------
+	GSPGPU_FramebufferFormats screenformat = (mode<=1) ? GSP_BGR8_OES : GSP_RGB565_OES;
+
+	// the direct present may have changed the framebuffer formats
+	if (gfxGetScreenFormat(GFX_TOP) != screenformat)
+		gfxSetScreenFormat(GFX_TOP, screenformat);
+	if (gfxGetScreenFormat(GFX_BOTTOM) != screenformat)
+		gfxSetScreenFormat(GFX_BOTTOM, screenformat);
+
+	if (scenemode == (int)mode)
+		return;
+	scenemode = mode;
+	if (VideoSurface1) C3D_RenderTargetDelete(VideoSurface1);
+	if (VideoSurface2) C3D_RenderTargetDelete(VideoSurface2);
+
+	// Initialize the top screen render target
+	VideoSurface1 = C3D_RenderTargetCreate(240, 400, mode, -1);
+	C3D_RenderTargetSetClear(VideoSurface1, C3D_CLEAR_COLOR, clearcolors[mode], 0);
+	C3D_RenderTargetSetOutput(VideoSurface1, GFX_TOP, GFX_LEFT, displayTranferFlags[mode]);
+
+	// Initialize the bottom screen render target
+	VideoSurface2 = C3D_RenderTargetCreate(240, 320, mode, -1);
+	C3D_RenderTargetSetClear(VideoSurface2, C3D_CLEAR_COLOR, clearcolors[mode], 0);
+	C3D_RenderTargetSetOutput(VideoSurface2, GFX_BOTTOM, GFX_LEFT, displayTranferFlags[mode]);
 }
 
 //---------------------------------------------------------------------------------
@@ -648,6 +1980,8 @@ static void sceneExit(void) {
 
 	if(VideoSurface1) C3D_RenderTargetDelete(VideoSurface1);
 	if (VideoSurface2) C3D_RenderTargetDelete(VideoSurface2);
+	VideoSurface1 = VideoSurface2 = NULL;
+	scenemode = -1;
 	// Free the shader program
 	shaderProgramFree(&program);
 	DVLB_Free(vshader_dvlb);
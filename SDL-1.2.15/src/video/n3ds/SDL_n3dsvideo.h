@@ -27,12 +27,15 @@
 #include "../SDL_sysvideo.h"
 
 #include <3ds.h>
+#include <citro3d.h>
 
 
 /* Hidden "this" pointer for the video functions */
 #define _THIS	SDL_VideoDevice *this
 
 
+#define N3DS_MAX_BUFFERS 3 // staging buffers used by the pipelined present
+
 /* Private display data */
 
 struct SDL_PrivateVideoData {
@@ -45,20 +48,72 @@ struct SDL_PrivateVideoData {
 	float scalex2,scaley2; // scaling factors
 
 // framebuffer data
-    int w, h; // width and height of the video buffer
-    void *buffer;
+    int w, h; // width and height of the screen texture (powers of two)
+	int bufw, bufh; // width and height of the staging buffers (the mode, padded to whole tiles)
+    void *buffer; // staging buffer the app is currently drawing into
+	void *buffers[N3DS_MAX_BUFFERS];
+	int buffersizes[N3DS_MAX_BUFFERS]; // allocated sizes, the buffers are kept across modes
+	int numbuffers; // 1 unless the pipelined present rotates buffers on SDL_Flip
+	int curbuffer;
+	int pipelined; // don't wait for VBlank/PPF on present, rely on the citro3d frame fences
+	int stale; // 8bpp: current staging buffer is older than the paletted buffer
+	int gpupalette; // 8bpp: upload the indexes as a L8 texture, the palette is resolved by the GPU
+	int direct; // screen of the size of a display: the buffer is rotated into its framebuffer, no GPU
+	gfxScreen_t directscreen;
+	int directfull; // presents left that must copy the whole screen
+	SDL_Rect directprev; // what the previous present copied, the back framebuffer lacks it
+// hardware surfaces
+	int hwaccel; // blits from hardware surfaces and fills are drawn by the GPU into the screen texture
+	C3D_RenderTarget *screentarget; // the screen texture, as a render target (single buffered RGB modes)
+	int inframe; // a citro3d frame is open, GPU blits are being recorded into it
+	Uint32 frameserial; // incremented each time a frame is submitted, not when the draw list splits one
+	int screengpu; // the screen texture has GPU drawing that is not in the buffer yet
+	int screencpu; // the buffer has CPU drawing that is not in the screen texture yet
+	int batching; // GPU blits go through the draw list
+	struct N3DS_DrawOp *drawops; // draw list, in blit order
+	int numdrawops, maxdrawops;
+	struct N3DS_DrawBatch *batches;
+	int numbatches, maxbatches;
+	void *vbo; // vertex buffer the draw list is emitted into
+	int vbosize;
+	int vboused; // bytes of it the lists emitted in the open frame use
+	struct N3DS_FreedTex *freedtex; // textures to delete when the frames sampling them are done
+	int numfreedtex, maxfreedtex;
 	Uint8 *palettedbuffer;
+	int palettedsize;
 	GSPGPU_FramebufferFormats mode;
 	unsigned int screens; // SDL_TOPSCR, SDL_BOTTOMSCR, SDL_DUALSCR
+	unsigned int screendirty; // screens showing rows that changed since they were last drawn
 	unsigned int console; // SDL_CONSOLETOP, SDL_CONSOLEBOTTOM
 	unsigned int fitscreen; // SDL_TRIMBOTTOMSCR, SDL_FITWIDTH, SDL_FITHEIGHT (SDL_FULLSCREEN sets both SDL_FITWIDTH and SDL_FITHEIGHT)
 	int byteperpixel;
 	int bpp;
 // block video output on SDL_QUIT
 	int exiting;
+// sleep 1ms in each PumpEvents (SDL_N3DS_PUMP_SLEEP=1)
+	int pumpsleep;
 	
 };
 
+/* Hardware surface data: the pixels live in linear memory, the GPU samples
+   a tiled copy of them that is refreshed when the surface is blitted after
+   being changed. */
+struct private_hwdata {
+	const struct N3DS_HWFormat *format;
+	C3D_Tex tex;
+	int tw, th; // texture size
+	void *keybuf; // colorkeyed copy of the pixels, with the key in the alpha channel
+	int keyed; // tex holds keybuf rather than the pixels
+	int dirty; // pixels changed since the last upload
+	Uint32 usedframe; // frameserial of the last frame that sampled tex
+};
+
+/* GPU drawing into the screen texture, for the YUV overlays */
+extern unsigned int next_pow2(unsigned int v);
+extern void N3DS_DrawScreenTexture(_THIS, C3D_Tex *tex, SDL_Rect *dst,
+                                   float left, float right, float top, float bottom);
+extern void N3DS_ReleaseTexture(_THIS, Uint32 usedframe);
+
 #endif /* _SDL_n3dsvideo_h */
 
 /*
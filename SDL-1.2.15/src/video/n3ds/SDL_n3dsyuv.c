@@ -0,0 +1,382 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+/* This is the 3DS implementation of YUV video overlays. The Y2R unit
+   converts the planes into a texture, in the GPU tiled layout, and the
+   GPU scales it onto the screen texture like a hardware blit. */
+
+#include "SDL_video.h"
+#include "SDL_n3dsvideo.h"
+#include "../SDL_yuvfuncs.h"
+#include "SDL_n3dsyuv_c.h"
+
+/* The functions used to manipulate the Y2R video overlays */
+static struct private_yuvhwfuncs n3ds_yuvfuncs = {
+	N3DS_LockYUVOverlay,
+	N3DS_UnlockYUVOverlay,
+	N3DS_DisplayYUVOverlay,
+	N3DS_FreeYUVOverlay
+};
+
+#define Y2R_BLOCK 8 // the Y2R converts blocks of 8x8 pixels
+#define Y2R_MAX_SIZE 1024 // input line width, and largest texture
+#define Y2R_TIMEOUT 100000000LL // ns, a 1024x1024 conversion takes a few ms
+
+struct private_yuvhwdata {
+	Uint8 *pixels; // the planes, in linear memory
+	Uint8 *swapbuf; // UYVY reordered to YUYV, the only packed order the Y2R reads
+	int size;
+
+	/* These are just so we don't have to allocate them separately */
+	Uint16 pitches[3];
+	Uint8 *planes[3];
+
+	int pw, ph; // size padded to the Y2R blocks
+	int tw, th; // texture size
+	Y2RU_OutputFormat outfmt;
+	int outbpp;
+
+	/* Converted frames: the Y2R writes into one texture while the GPU may
+	   still be drawing the other one */
+	C3D_Tex tex[2];
+	Uint32 usedframe[2];
+	int cur; // the last complete conversion
+	int converting; // a conversion into tex[cur ^ 1] is running
+};
+
+static int y2r_refcount = 0;
+static Handle y2r_event;
+static SDL_Overlay *y2r_owner = NULL; // the overlay being converted
+
+static int Y2R_Open(void)
+{
+	if ( y2r_refcount == 0 ) {
+		if ( R_FAILED(y2rInit()) ) {
+			SDL_SetError("Couldn't initialize the Y2R service");
+			return(-1);
+		}
+		Y2RU_SetTransferEndInterrupt(true);
+		Y2RU_GetTransferEndEvent(&y2r_event);
+	}
+	++y2r_refcount;
+	return(0);
+}
+
+static void Y2R_Close(void)
+{
+	if ( --y2r_refcount == 0 )
+		y2rExit();
+}
+
+/* Wait for the running conversion of an overlay, returns -1 if it failed */
+static int Y2R_Finish(SDL_Overlay *overlay)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+
+	if ( ! hwdata->converting )
+		return(0);
+	hwdata->converting = 0;
+	y2r_owner = NULL;
+	if ( svcWaitSynchronization(y2r_event, Y2R_TIMEOUT) != 0 ) {
+		// keep showing the previous frame
+		Y2RU_StopConversion();
+		SDL_SetError("Y2R conversion timed out");
+		return(-1);
+	}
+	hwdata->cur ^= 1;
+	return(0);
+}
+
+/* Start converting the planes into the texture that isn't shown */
+static void Y2R_Start(_THIS, SDL_Overlay *overlay)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+	Y2RU_ConversionParams params;
+	int next = hwdata->cur ^ 1;
+	int pw = hwdata->pw, ph = hwdata->ph;
+
+	// the Y2R converts one picture at a time
+	if ( y2r_owner )
+		Y2R_Finish(y2r_owner);
+	N3DS_ReleaseTexture(this, hwdata->usedframe[next]);
+
+	SDL_memset(&params, 0, sizeof(params));
+	params.input_format = (overlay->planes == 3) ? INPUT_YUV420_INDIV_8 : INPUT_YUV422_BATCH;
+	params.output_format = hwdata->outfmt;
+	params.rotation = ROTATION_NONE;
+	params.block_alignment = BLOCK_8_BY_8;
+	params.input_line_width = pw;
+	params.input_lines = ph;
+	// video is in the TV range (Y 16-235)
+	params.standard_coefficient = COEFFICIENT_ITU_R_BT_601_SCALING;
+	params.alpha = 0xFF;
+	Y2RU_SetConversionParams(&params);
+
+	switch ( overlay->format ) {
+		case SDL_YV12_OVERLAY:
+		case SDL_IYUV_OVERLAY:
+			GSPGPU_FlushDataCache(hwdata->pixels, hwdata->size);
+			Y2RU_SetSendingY(hwdata->planes[0], pw * ph, pw, 0);
+			if ( overlay->format == SDL_YV12_OVERLAY ) {
+				Y2RU_SetSendingU(hwdata->planes[2], pw * ph / 4, pw / 2, 0);
+				Y2RU_SetSendingV(hwdata->planes[1], pw * ph / 4, pw / 2, 0);
+			} else {
+				Y2RU_SetSendingU(hwdata->planes[1], pw * ph / 4, pw / 2, 0);
+				Y2RU_SetSendingV(hwdata->planes[2], pw * ph / 4, pw / 2, 0);
+			}
+			break;
+		case SDL_UYVY_OVERLAY: {
+			// swap the bytes of each 16 bit half, U Y V Y -> Y U Y V
+			const Uint32 *src = (const Uint32 *)hwdata->pixels;
+			Uint32 *dst = (Uint32 *)hwdata->swapbuf;
+			int n = hwdata->size / 4;
+			while ( n-- > 0 ) {
+				Uint32 p = *src++;
+				*dst++ = ((p & 0x00ff00ff) << 8) | ((p >> 8) & 0x00ff00ff);
+			}
+			GSPGPU_FlushDataCache(hwdata->swapbuf, hwdata->size);
+			Y2RU_SetSendingYUYV(hwdata->swapbuf, hwdata->size, pw * 2, 0);
+			break;
+		}
+		default:
+			GSPGPU_FlushDataCache(hwdata->pixels, hwdata->size);
+			Y2RU_SetSendingYUYV(hwdata->pixels, hwdata->size, pw * 2, 0);
+			break;
+	}
+
+	// a row of 8x8 blocks at a time, skipping the texture width past the picture
+	Y2RU_SetReceiving(hwdata->tex[next].data, pw * ph * hwdata->outbpp,
+		pw * Y2R_BLOCK * hwdata->outbpp, (hwdata->tw - pw) * Y2R_BLOCK * hwdata->outbpp);
+	Y2RU_StartConversion();
+	hwdata->converting = 1;
+	y2r_owner = overlay;
+}
+
+SDL_Overlay *N3DS_CreateYUVOverlay(_THIS, int width, int height, Uint32 format, SDL_Surface *display)
+{
+	SDL_Overlay *overlay;
+	struct private_yuvhwdata *hwdata;
+	Y2RU_OutputFormat outfmt;
+	GPU_TEXCOLOR texfmt;
+	int outbpp, pw, ph, i;
+
+	/* The picture is drawn into the screen texture */
+	if ( ! this->hidden->screentarget ) {
+		SDL_SetError("YUV overlays need a single buffered 16, 24 or 32 bit mode");
+		return(NULL);
+	}
+
+	/* Double-check the requested format; YVYU falls back to the software overlay */
+	switch (format) {
+		case SDL_YV12_OVERLAY:
+		case SDL_IYUV_OVERLAY:
+		case SDL_YUY2_OVERLAY:
+		case SDL_UYVY_OVERLAY:
+			break;
+		default:
+			SDL_SetError("Unsupported YUV format");
+			return(NULL);
+	}
+
+	// same depth as the screen: no point converting more than it shows
+	if ( this->hidden->byteperpixel == 2 ) {
+		outfmt = OUTPUT_RGB_16_565;
+		outbpp = 2;
+		texfmt = GPU_RGB565;
+	} else {
+		outfmt = OUTPUT_RGB_32;
+		outbpp = 4;
+		texfmt = GPU_RGBA8;
+	}
+
+	// the transfer unit, a row of blocks, is a signed 16 bit value
+	pw = (width + Y2R_BLOCK - 1) & ~(Y2R_BLOCK - 1);
+	ph = (height + Y2R_BLOCK - 1) & ~(Y2R_BLOCK - 1);
+	if ( pw > Y2R_MAX_SIZE || ph > Y2R_MAX_SIZE || pw * Y2R_BLOCK * outbpp > 0x7fff ) {
+		SDL_SetError("YUV overlay too large for the Y2R");
+		return(NULL);
+	}
+
+	/* Create the overlay structure */
+	overlay = (SDL_Overlay *)SDL_calloc(1, sizeof(SDL_Overlay));
+	if ( overlay == NULL ) {
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+
+	/* Set the basic attributes */
+	overlay->format = format;
+	overlay->w = width;
+	overlay->h = height;
+	overlay->hw_overlay = 1;
+
+	/* Set up the Y2R surface function structure */
+	overlay->hwfuncs = &n3ds_yuvfuncs;
+
+	hwdata = (struct private_yuvhwdata *)SDL_calloc(1, sizeof(struct private_yuvhwdata));
+	if ( hwdata == NULL ) {
+		SDL_free(overlay);
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+	if ( Y2R_Open() < 0 ) {
+		SDL_free(hwdata);
+		SDL_free(overlay);
+		return(NULL);
+	}
+	overlay->hwdata = hwdata;
+
+	hwdata->pw = pw;
+	hwdata->ph = ph;
+	hwdata->tw = next_pow2(pw);
+	hwdata->th = next_pow2(ph);
+	hwdata->outfmt = outfmt;
+	hwdata->outbpp = outbpp;
+	for ( i = 0; i < 2; i++ ) {
+		if ( ! C3D_TexInit(&hwdata->tex[i], hwdata->tw, hwdata->th, texfmt) ) {
+			SDL_FreeYUVOverlay(overlay);
+			SDL_OutOfMemory();
+			return(NULL);
+		}
+		C3D_TexSetFilter(&hwdata->tex[i], GPU_LINEAR, GPU_LINEAR);
+		// no dirty lines of the texture may be written back over the Y2R output
+		GSPGPU_FlushDataCache(hwdata->tex[i].data, hwdata->tw * hwdata->th * hwdata->outbpp);
+		hwdata->usedframe[i] = this->hidden->frameserial - 2;
+	}
+
+	/* Find the pitch and offset values for the overlay */
+	overlay->pitches = hwdata->pitches;
+	overlay->pixels = hwdata->planes;
+	switch (format) {
+		case SDL_YV12_OVERLAY:
+		case SDL_IYUV_OVERLAY:
+			hwdata->size = pw * ph + 2 * (pw / 2) * (ph / 2);
+			hwdata->pixels = (Uint8 *)linearAlloc(hwdata->size);
+			if ( hwdata->pixels == NULL )
+				break;
+			overlay->pitches[0] = pw;
+			overlay->pitches[1] = pw / 2;
+			overlay->pitches[2] = pw / 2;
+			overlay->pixels[0] = hwdata->pixels;
+			overlay->pixels[1] = overlay->pixels[0] + pw * ph;
+			overlay->pixels[2] = overlay->pixels[1] + (pw / 2) * (ph / 2);
+			overlay->planes = 3;
+			// black
+			SDL_memset(overlay->pixels[0], 16, pw * ph);
+			SDL_memset(overlay->pixels[1], 128, 2 * (pw / 2) * (ph / 2));
+			break;
+		default:
+			hwdata->size = pw * 2 * ph;
+			hwdata->pixels = (Uint8 *)linearAlloc(hwdata->size);
+			if ( hwdata->pixels == NULL )
+				break;
+			if ( format == SDL_UYVY_OVERLAY ) {
+				hwdata->swapbuf = (Uint8 *)linearAlloc(hwdata->size);
+				if ( hwdata->swapbuf == NULL )
+					break;
+			}
+			overlay->pitches[0] = pw * 2;
+			overlay->pixels[0] = hwdata->pixels;
+			overlay->planes = 1;
+			SDL_memset4(hwdata->pixels, format == SDL_UYVY_OVERLAY ? 0x10801080 : 0x80108010, hwdata->size / 4);
+			break;
+	}
+	if ( overlay->planes == 0 ) {
+		SDL_FreeYUVOverlay(overlay);
+		SDL_OutOfMemory();
+		return(NULL);
+	}
+
+	/* Convert the black picture, this also checks the Y2R works */
+	Y2R_Start(this, overlay);
+	if ( Y2R_Finish(overlay) < 0 ) {
+		SDL_FreeYUVOverlay(overlay);
+		return(NULL);
+	}
+
+	/* We're all done.. */
+	return(overlay);
+}
+
+int N3DS_LockYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	// the Y2R may still be reading the planes
+	if ( overlay == y2r_owner )
+		Y2R_Finish(overlay);
+	return(0);
+}
+
+void N3DS_UnlockYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	// convert while the app does something else, Display waits for it
+	Y2R_Start(this, overlay);
+}
+
+int N3DS_DisplayYUVOverlay(_THIS, SDL_Overlay *overlay, SDL_Rect *src, SDL_Rect *dst)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+	float tw = hwdata->tw, th = hwdata->th;
+
+	if ( this->hidden->exiting )
+		return(0);
+	if ( ! this->hidden->screentarget ) {
+		SDL_SetError("YUV overlays need a single buffered 16, 24 or 32 bit mode");
+		return(-1);
+	}
+	Y2R_Finish(overlay);
+
+	/* The Y2R writes the blocks top down, the picture is upside down in
+	   the texture compared to what the GPU transfers produce */
+	N3DS_DrawScreenTexture(this, &hwdata->tex[hwdata->cur], dst,
+		src->x / tw, (src->x + src->w) / tw,
+		1.0f - src->y / th, 1.0f - (src->y + src->h) / th);
+	hwdata->usedframe[hwdata->cur] = this->hidden->frameserial;
+
+	SDL_UpdateRects(this->screen, 1, dst);
+	return(0);
+}
+
+void N3DS_FreeYUVOverlay(_THIS, SDL_Overlay *overlay)
+{
+	struct private_yuvhwdata *hwdata = overlay->hwdata;
+	int i;
+
+	if ( hwdata == NULL )
+		return;
+
+	if ( overlay == y2r_owner )
+		Y2R_Finish(overlay);
+	for ( i = 0; i < 2; i++ ) {
+		if ( hwdata->tex[i].data ) {
+			N3DS_ReleaseTexture(this, hwdata->usedframe[i]);
+			C3D_TexDelete(&hwdata->tex[i]);
+		}
+	}
+	if ( hwdata->pixels )
+		linearFree(hwdata->pixels);
+	if ( hwdata->swapbuf )
+		linearFree(hwdata->swapbuf);
+	Y2R_Close();
+	SDL_free(hwdata);
+	overlay->hwdata = NULL;
+}
@@ -0,0 +1,39 @@
+/*
+    SDL - Simple DirectMedia Layer
+    Copyright (C) 1997-2012 Sam Lantinga
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+    Sam Lantinga
+    slouken@libsdl.org
+*/
+#include "SDL_config.h"
+
+#ifndef _SDL_n3dsyuv_c_h
+#define _SDL_n3dsyuv_c_h
+
+/* This is the 3DS implementation of YUV video overlays, converted by the
+   Y2R hardware straight into a texture the GPU scales onto the screen */
+
+#include "SDL_video.h"
+#include "SDL_n3dsvideo.h"
+
+extern SDL_Overlay *N3DS_CreateYUVOverlay(_THIS, int width, int height, Uint32 format, SDL_Surface *display);
+extern int N3DS_LockYUVOverlay(_THIS, SDL_Overlay *overlay);
+extern void N3DS_UnlockYUVOverlay(_THIS, SDL_Overlay *overlay);
+extern int N3DS_DisplayYUVOverlay(_THIS, SDL_Overlay *overlay, SDL_Rect *src, SDL_Rect *dst);
+extern void N3DS_FreeYUVOverlay(_THIS, SDL_Overlay *overlay);
+
+#endif /* _SDL_n3dsyuv_c_h */
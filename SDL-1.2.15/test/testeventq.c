@@ -0,0 +1,214 @@
+/* Test program to check that the event queue neither loses nor reorders
+   events: small queues are filled, with masked peeks and gets in between,
+   and then several threads push into one while the main thread takes.
+   It also checks that a queue holds as many events as it was asked to.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#define NUMTHREADS	4
+#define THREADEVENTS	5000
+
+static int sizes[] = { 1, 2, 3, 4, 8, 16 };
+#define MAXSIZE	128
+
+static int failed[NUMTHREADS];
+
+/* Push 'count' user events of the given type, numbered from 'code' */
+static int PushEvents(Uint8 type, int code, int count)
+{
+	SDL_Event event;
+	int i, pushed = 0;
+
+	for ( i = 0; i < count; ++i ) {
+		event.type = type;
+		event.user.code = code+i;
+		if ( SDL_PushEvent(&event) == 0 ) {
+			++pushed;
+		}
+	}
+	return(pushed);
+}
+
+/* Fill a queue of 'size' events and check what comes back out of it */
+static int TestFill(int size)
+{
+	char env[64];
+	SDL_Event event, peek[4];
+	int pushed, taken = 0, last = -1, status = 0;
+
+	SDL_snprintf(env, sizeof(env), "SDL_EVENT_QUEUE_SIZE=%d", size);
+	SDL_putenv(env);
+	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(-1);
+	}
+
+	/* Fill it, cut events out of the middle with a masked get, refill */
+	pushed = PushEvents(SDL_USEREVENT, 0, 20);
+	pushed += PushEvents(SDL_USEREVENT+1, 20, 20);
+	SDL_PeepEvents(peek, 4, SDL_PEEKEVENT, SDL_EVENTMASK(SDL_USEREVENT));
+	while ( SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_EVENTMASK(SDL_USEREVENT+1)) > 0 ) {
+		if ( event.user.code < 20 || event.user.code <= last ) {
+			status = -1;
+		}
+		last = event.user.code;
+		++taken;
+	}
+	pushed += PushEvents(SDL_USEREVENT, 100, 5);
+
+	last = -1;
+	while ( SDL_PollEvent(&event) ) {
+		if ( event.type < SDL_USEREVENT ) {
+			continue;
+		}
+		/* the events of the masked get must be gone */
+		if ( event.type != SDL_USEREVENT || event.user.code <= last ) {
+			status = -1;
+		}
+		last = event.user.code;
+		++taken;
+	}
+	printf("Queue size %d: pushed %d, taken %d, dropped %u\n",
+	       size, pushed, taken, SDL_GetDroppedEvents());
+	if ( (taken != pushed) || (pushed + SDL_GetDroppedEvents() != 45) ) {
+		status = -1;
+	}
+	if ( status < 0 ) {
+		printf("Queue size %d: events were lost or reordered\n", size);
+	}
+	SDL_Quit();
+	return(status);
+}
+
+/* A queue of 'size' events, that may grow up to 'max', holds that many */
+static int TestCapacity(int size, int max, int expected)
+{
+	char env[64], envmax[64];
+	SDL_Event event;
+	Uint32 dropped;
+	int pushed, status = 0;
+
+	SDL_snprintf(env, sizeof(env), "SDL_EVENT_QUEUE_SIZE=%d", size);
+	SDL_putenv(env);
+	SDL_snprintf(envmax, sizeof(envmax), "SDL_EVENT_QUEUE_MAX=%d", max);
+	SDL_putenv(envmax);
+	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(-1);
+	}
+	while ( SDL_PollEvent(&event) ) {
+		continue;
+	}
+	dropped = SDL_GetDroppedEvents();
+	pushed = PushEvents(SDL_USEREVENT, 0, 2*expected);
+	printf("Queue size %d, max %d: holds %d events\n", size, max, pushed);
+	if ( (pushed != expected) || (SDL_GetDroppedEvents()-dropped != (Uint32)expected) ) {
+		printf("Queue size %d, max %d: should hold %d events\n", size, max, expected);
+		status = -1;
+	}
+	SDL_Quit();
+	SDL_putenv("SDL_EVENT_QUEUE_MAX=0");
+	return(status);
+}
+
+static int SDLCALL Producer(void *data)
+{
+	int id = (int)(size_t)data;
+	SDL_Event event;
+	int i;
+
+	for ( i = 0; i < THREADEVENTS; ++i ) {
+		event.type = SDL_USEREVENT;
+		event.user.code = id;
+		event.user.data1 = (void *)(size_t)i;
+		while ( SDL_PushEvent(&event) < 0 ) {
+			++failed[id];
+			SDL_Delay(0);
+		}
+	}
+	return(0);
+}
+
+/* Several threads push into a queue of 'size' events, while this one takes */
+static int TestThreads(int size)
+{
+	char env[64];
+	SDL_Thread *threads[NUMTHREADS];
+	SDL_Event event;
+	int next[NUMTHREADS];
+	int i, id, taken = 0, status = 0;
+	Uint32 start;
+
+	SDL_snprintf(env, sizeof(env), "SDL_EVENT_QUEUE_SIZE=%d", size);
+	SDL_putenv(env);
+	if ( SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+		fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+		return(-1);
+	}
+	for ( i = 0; i < NUMTHREADS; ++i ) {
+		next[i] = 0;
+		failed[i] = 0;
+		threads[i] = SDL_CreateThread(Producer, (void *)(size_t)i);
+		if ( threads[i] == NULL ) {
+			fprintf(stderr, "Couldn't create thread: %s\n", SDL_GetError());
+			exit(1);
+		}
+	}
+
+	/* the pushes are retried, so every event must come, in order */
+	start = SDL_GetTicks();
+	while ( (taken < NUMTHREADS*THREADEVENTS) && (SDL_GetTicks()-start < 60000) ) {
+		if ( ! SDL_PollEvent(&event) ) {
+			continue;
+		}
+		if ( event.type != SDL_USEREVENT ) {
+			continue;
+		}
+		id = event.user.code;
+		if ( (int)(size_t)event.user.data1 != next[id] ) {
+			status = -1;
+		}
+		next[id] = (int)(size_t)event.user.data1 + 1;
+		++taken;
+	}
+	for ( i = 0; i < NUMTHREADS; ++i ) {
+		SDL_WaitThread(threads[i], NULL);
+	}
+	printf("Queue size %d, %d threads: taken %d of %d\n",
+	       size, NUMTHREADS, taken, NUMTHREADS*THREADEVENTS);
+	if ( taken != NUMTHREADS*THREADEVENTS ) {
+		status = -1;
+	}
+	if ( status < 0 ) {
+		printf("Queue size %d, %d threads: events were lost or reordered\n",
+		       size, NUMTHREADS);
+	}
+	SDL_Quit();
+	return(status);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, status = 0;
+
+	for ( i = 0; i < SDL_arraysize(sizes); ++i ) {
+		if ( TestFill(sizes[i]) < 0 ) {
+			status = 1;
+		}
+	}
+	if ( TestCapacity(MAXSIZE, 0, MAXSIZE) < 0 ||
+	     TestCapacity(100, 0, MAXSIZE) < 0 ||
+	     TestCapacity(1, 0, 8) < 0 ||
+	     TestCapacity(16, 64, 64) < 0 ) {
+		status = 1;
+	}
+	if ( TestThreads(1) < 0 || TestThreads(MAXSIZE) < 0 ) {
+		status = 1;
+	}
+	printf("%s\n", status ? "FAILED" : "All tests passed");
+	return(status);
+}
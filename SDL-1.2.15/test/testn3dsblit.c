@@ -0,0 +1,130 @@
+/* Test program to check the n3ds pixel kernels against their reference
+   versions, for every length and alignment of the source and destination
+   and for every rectangle position in the framebuffer rotations.
+   Build it with the host simulation:  make -f Makefile.n3ds-sim testn3dsblit
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
+#include "../src/video/n3ds/SDL_n3dsblit_c.h"
+
+#define MAXPIXELS	70
+#define GUARD	8
+
+/* The 3DS screen sizes are too big to try every rectangle */
+#define FBW	24
+#define FBH	20
+
+static Uint32 palette32[256];
+static Uint16 palette16[256];
+
+static void Fill(Uint8 *buf, int size)
+{
+	int i;
+
+	for ( i = 0; i < size; ++i ) {
+		buf[i] = (Uint8)rand();
+	}
+}
+
+static int TestExpand(void)
+{
+	Uint8 src[MAXPIXELS+GUARD];
+	Uint8 dst[(MAXPIXELS+GUARD)*4], ref[(MAXPIXELS+GUARD)*4];
+	int n, srcoff, dstoff, status = 0;
+
+	Fill(src, sizeof(src));
+	for ( n = 0; n <= MAXPIXELS; ++n ) {
+		for ( srcoff = 0; srcoff < 4; ++srcoff ) {
+			for ( dstoff = 0; dstoff < 4; dstoff += 2 ) {
+				/* 32 bit pixels are always word aligned in the driver */
+				if ( dstoff == 0 ) {
+					SDL_memset(dst, 0xAA, sizeof(dst));
+					SDL_memset(ref, 0xAA, sizeof(ref));
+					N3DS_ExpandPal8To32((Uint32 *)dst, src+srcoff, n, palette32);
+					N3DS_ExpandPal8To32_C((Uint32 *)ref, src+srcoff, n, palette32);
+					if ( SDL_memcmp(dst, ref, sizeof(dst)) != 0 ) {
+						printf("N3DS_ExpandPal8To32: %d pixels, source offset %d differ\n", n, srcoff);
+						status = -1;
+					}
+				}
+				SDL_memset(dst, 0xAA, sizeof(dst));
+				SDL_memset(ref, 0xAA, sizeof(ref));
+				N3DS_ExpandPal8To16((Uint16 *)(dst+dstoff), src+srcoff, n, palette16);
+				N3DS_ExpandPal8To16_C((Uint16 *)(ref+dstoff), src+srcoff, n, palette16);
+				if ( SDL_memcmp(dst, ref, sizeof(dst)) != 0 ) {
+					printf("N3DS_ExpandPal8To16: %d pixels, source offset %d, destination offset %d differ\n", n, srcoff, dstoff);
+					status = -1;
+				}
+			}
+		}
+	}
+	return(status);
+}
+
+static int TestRotate(void)
+{
+	static Uint8 src[FBW*FBH*4];
+	static Uint8 fb[FBW*FBH*4], ref[FBW*FBH*4];
+	int pitch, bpp, x, y, w, h, status = 0;
+
+	Fill(src, sizeof(src));
+	for ( y = 0; y < FBH; ++y ) {
+		for ( h = 1; y+h <= FBH; ++h ) {
+			for ( x = 0; x < FBW; ++x ) {
+				for ( w = 1; x+w <= FBW; ++w ) {
+					for ( bpp = 2; bpp <= 4; ++bpp ) {
+						pitch = FBW*bpp;
+						SDL_memset(fb, 0xAA, sizeof(fb));
+						SDL_memset(ref, 0xAA, sizeof(ref));
+						N3DS_RotateToFramebuffer(fb, FBH, src, pitch, bpp, x, y, w, h);
+						N3DS_RotateToFramebuffer_C(ref, FBH, src, pitch, bpp, x, y, w, h);
+						if ( SDL_memcmp(fb, ref, sizeof(fb)) != 0 ) {
+							printf("N3DS_RotateToFramebuffer: %d bpp, %dx%d at %d,%d differ\n", bpp*8, w, h, x, y);
+							status = -1;
+						}
+					}
+					pitch = FBW;
+					SDL_memset(fb, 0xAA, sizeof(fb));
+					SDL_memset(ref, 0xAA, sizeof(ref));
+					N3DS_RotatePal8ToFramebuffer32((Uint32 *)fb, FBH, src, pitch, x, y, w, h, palette32);
+					N3DS_RotatePal8ToFramebuffer32_C((Uint32 *)ref, FBH, src, pitch, x, y, w, h, palette32);
+					if ( SDL_memcmp(fb, ref, sizeof(fb)) != 0 ) {
+						printf("N3DS_RotatePal8ToFramebuffer32: %dx%d at %d,%d differ\n", w, h, x, y);
+						status = -1;
+					}
+					SDL_memset(fb, 0xAA, sizeof(fb));
+					SDL_memset(ref, 0xAA, sizeof(ref));
+					N3DS_RotatePal8ToFramebuffer16((Uint16 *)fb, FBH, src, pitch, x, y, w, h, palette16);
+					N3DS_RotatePal8ToFramebuffer16_C((Uint16 *)ref, FBH, src, pitch, x, y, w, h, palette16);
+					if ( SDL_memcmp(fb, ref, sizeof(fb)) != 0 ) {
+						printf("N3DS_RotatePal8ToFramebuffer16: %dx%d at %d,%d differ\n", w, h, x, y);
+						status = -1;
+					}
+				}
+			}
+		}
+	}
+	return(status);
+}
+
+int main(int argc, char *argv[])
+{
+	int i, status = 0;
+
+	srand(1);
+	for ( i = 0; i < 256; ++i ) {
+		palette32[i] = (Uint32)rand() << 16 ^ (Uint32)rand();
+		palette16[i] = (Uint16)rand();
+	}
+	if ( TestExpand() < 0 ) {
+		status = 1;
+	}
+	if ( TestRotate() < 0 ) {
+		status = 1;
+	}
+	printf("%s\n", status ? "FAILED" : "All tests passed");
+	return(status);
+}